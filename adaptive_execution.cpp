@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adaptive_execution.h"
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+// синтетический индекс: слово pK есть в каждом 2^K-м документе, слова m0...m255 - в документе 0
+const int CALIBRATION_DOCUMENT_COUNT = 1 << 15;
+const int CALIBRATION_LEVEL_COUNT = 12;
+const int CALIBRATION_MATCH_WORD_COUNT = 256;
+const int CALIBRATION_REPEAT_COUNT = 3;
+// во сколько раз параллельный путь должен быть быстрее последовательного, чтобы его выбирать
+const double CALIBRATION_MIN_SPEEDUP = 1.1;
+
+// пороги WarmUpAdaptiveExecution, пока замера не было - nullptr
+atomic<const AdaptiveExecutionThresholds*> calibrated_thresholds{ nullptr };
+
+struct CalibrationPoint {
+    size_t work = 0;
+    double sequential_seconds = 0.0;
+    double parallel_seconds = 0.0;
+};
+
+template <typename Function>
+double MeasureBestSeconds(Function function) {
+    double best_seconds = numeric_limits<double>::max();
+    for (int repeat = 0; repeat < CALIBRATION_REPEAT_COUNT; ++repeat) {
+        const auto start = chrono::steady_clock::now();
+        function();
+        best_seconds = min(best_seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best_seconds;
+}
+
+// наименьшая стоимость, начиная с которой параллельный путь выгоден на всех замерах; points - по возрастанию work
+size_t FindMinParallelWork(const vector<CalibrationPoint>& points) {
+    size_t min_work = numeric_limits<size_t>::max();
+    for (auto point = points.rbegin(); point != points.rend(); ++point) {
+        if (point->sequential_seconds < point->parallel_seconds * CALIBRATION_MIN_SPEEDUP) {
+            break;
+        }
+        min_work = point->work;
+    }
+    return min_work;
+}
+
+}  // namespace
+
+const char* GetExecutionPathName(ExecutionPath path) {
+    switch (path) {
+    case ExecutionPath::SEQUENTIAL:
+        return "sequential";
+    case ExecutionPath::PARALLEL_TERMS:
+        return "parallel_terms";
+    case ExecutionPath::PARALLEL_DOCUMENT_RANGES:
+        return "parallel_document_ranges";
+    }
+    return "unknown";
+}
+
+size_t GetHardwareThreadCount() {
+    static const size_t thread_count = max<size_t>(thread::hardware_concurrency(), 1);
+    return thread_count;
+}
+
+void AdaptiveExecutionThresholds::PrintJson(const char* name, ostream& out) const {
+    // порог "никогда" печатается как -1
+    const auto print_threshold = [&out](const char* key, size_t threshold) {
+        out << ",\""s << key << "\":"s;
+        if (threshold == numeric_limits<size_t>::max()) {
+            out << -1;
+        }
+        else {
+            out << threshold;
+        }
+    };
+    out << "{\"benchmark\":\""s << name << "\",\"threads\":"s << GetHardwareThreadCount();
+    print_threshold("parallel_terms_min_postings", parallel_terms_min_postings);
+    print_threshold("document_ranges_min_postings", document_ranges_min_postings);
+    print_threshold("parallel_match_min_words", parallel_match_min_words);
+    out << "}"s << endl;
+}
+
+ExecutionPath ChooseExecutionPath(size_t work, size_t parallel_terms_min_work, size_t document_ranges_min_work,
+    size_t active_count) {
+    if (GetHardwareThreadCount() / max<size_t>(active_count, 1) < 2) {
+        return ExecutionPath::SEQUENTIAL;
+    }
+    if (work >= document_ranges_min_work) {
+        return ExecutionPath::PARALLEL_DOCUMENT_RANGES;
+    }
+    if (work >= parallel_terms_min_work) {
+        return ExecutionPath::PARALLEL_TERMS;
+    }
+    return ExecutionPath::SEQUENTIAL;
+}
+
+AdaptiveExecutionThresholds CalibrateAdaptiveExecution() {
+    AdaptiveExecutionThresholds thresholds;
+    if (GetHardwareThreadCount() < 2) {
+        return thresholds;
+    }
+
+    SearchServer search_server(""s);
+    string text;
+    for (int document_id = 0; document_id < CALIBRATION_DOCUMENT_COUNT; ++document_id) {
+        text = "p0"s;
+        for (int level = 1; level < CALIBRATION_LEVEL_COUNT && document_id % (1 << level) == 0; ++level) {
+            text += " p"s + to_string(level);
+        }
+        for (int word = 0; document_id == 0 && word < CALIBRATION_MATCH_WORD_COUNT; ++word) {
+            text += " m"s + to_string(word);
+        }
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { 1 });
+    }
+
+    // пороги, при которых выбирается только один путь
+    const AdaptiveExecutionThresholds sequential;
+    AdaptiveExecutionThresholds parallel_terms;
+    parallel_terms.parallel_terms_min_postings = 0;
+    parallel_terms.parallel_match_min_words = 0;
+    AdaptiveExecutionThresholds document_ranges;
+    document_ranges.document_ranges_min_postings = 0;
+
+    const auto measure_search = [&search_server](const AdaptiveExecutionThresholds& forced, const string& query) {
+        search_server.SetAdaptiveExecutionThresholds(forced);
+        return MeasureBestSeconds([&] {
+            search_server.FindTopDocuments(adaptive_execution, query);
+        });
+    };
+
+    // запрос "pK pK+1" обходит постинги 1.5 * CALIBRATION_DOCUMENT_COUNT / 2^K документов
+    vector<CalibrationPoint> terms_points;
+    vector<CalibrationPoint> ranges_points;
+    for (int level = CALIBRATION_LEVEL_COUNT - 2; level >= 0; --level) {
+        const string query = "p"s + to_string(level) + " p"s + to_string(level + 1);
+        const size_t work = (CALIBRATION_DOCUMENT_COUNT >> level) + (CALIBRATION_DOCUMENT_COUNT >> (level + 1));
+        const double sequential_seconds = measure_search(sequential, query);
+        terms_points.push_back({ work, sequential_seconds, measure_search(parallel_terms, query) });
+        ranges_points.push_back({ work, sequential_seconds, measure_search(document_ranges, query) });
+    }
+    thresholds.parallel_terms_min_postings = FindMinParallelWork(terms_points);
+    thresholds.document_ranges_min_postings = FindMinParallelWork(ranges_points);
+
+    vector<CalibrationPoint> match_points;
+    for (int word_count = 2; word_count <= CALIBRATION_MATCH_WORD_COUNT; word_count *= 2) {
+        string query = "m0"s;
+        for (int word = 1; word < word_count; ++word) {
+            query += " m"s + to_string(word);
+        }
+        const auto measure_match = [&search_server, &query](const AdaptiveExecutionThresholds& forced) {
+            search_server.SetAdaptiveExecutionThresholds(forced);
+            return MeasureBestSeconds([&] {
+                search_server.MatchDocument(adaptive_execution, query, 0);
+            });
+        };
+        match_points.push_back({ static_cast<size_t>(word_count), measure_match(sequential), measure_match(parallel_terms) });
+    }
+    thresholds.parallel_match_min_words = FindMinParallelWork(match_points);
+    return thresholds;
+}
+
+const AdaptiveExecutionThresholds& WarmUpAdaptiveExecution() {
+    static const AdaptiveExecutionThresholds thresholds = CalibrateAdaptiveExecution();
+    calibrated_thresholds.store(&thresholds, memory_order_release);
+    return thresholds;
+}
+
+const AdaptiveExecutionThresholds& GetDefaultAdaptiveExecution() {
+    static const AdaptiveExecutionThresholds uncalibrated_thresholds = [] {
+        AdaptiveExecutionThresholds thresholds;
+        thresholds.document_ranges_min_postings = UNCALIBRATED_DOCUMENT_RANGES_MIN_POSTINGS;
+        return thresholds;
+    }();
+    const AdaptiveExecutionThresholds* thresholds = calibrated_thresholds.load(memory_order_acquire);
+    return thresholds != nullptr ? *thresholds : uncalibrated_thresholds;
+}
+
+uint64_t AdaptiveExecutionStatistics::GetCount(ExecutionPath path) const {
+    return path_counts[static_cast<size_t>(path)];
+}
+
+void AdaptiveExecutionStatistics::PrintJson(const char* name, ostream& out) const {
+    out << "{\"benchmark\":\""s << name << "\""s;
+    for (int path = 0; path < EXECUTION_PATH_COUNT; ++path) {
+        out << ",\""s << GetExecutionPathName(static_cast<ExecutionPath>(path)) << "\":"s << path_counts[path];
+    }
+    out << "}"s << endl;
+}
+
+AdaptiveExecutionCounters::ActiveCall::ActiveCall(atomic<size_t>& active_count)
+    : active_count_(active_count) {
+    active_count_.fetch_add(1, memory_order_relaxed);
+}
+
+AdaptiveExecutionCounters::ActiveCall::~ActiveCall() {
+    active_count_.fetch_sub(1, memory_order_relaxed);
+}
+
+AdaptiveExecutionCounters::ActiveCall AdaptiveExecutionCounters::StartCall() {
+    return ActiveCall(active_count_);
+}
+
+size_t AdaptiveExecutionCounters::GetActiveCount() const {
+    return active_count_.load(memory_order_relaxed);
+}
+
+void AdaptiveExecutionCounters::Record(ExecutionPath path) {
+    path_counts_[static_cast<size_t>(path)].fetch_add(1, memory_order_relaxed);
+}
+
+AdaptiveExecutionStatistics AdaptiveExecutionCounters::GetStatistics() const {
+    AdaptiveExecutionStatistics statistics;
+    for (int path = 0; path < EXECUTION_PATH_COUNT; ++path) {
+        statistics.path_counts[path] = path_counts_[path].load(memory_order_relaxed);
+    }
+    return statistics;
+}
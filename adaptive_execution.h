@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+/*
+ *
+ * Политика выполнения adaptive_execution: поисковая система сама выбирает для каждого вызова
+ * последовательное или параллельное выполнение по оценке его стоимости (сумме длин постингов
+ * плюс слов запроса, числу слов) и по числу уже выполняющихся вызовов.
+ *
+ */
+
+struct AdaptiveExecutionPolicy {};
+
+inline constexpr AdaptiveExecutionPolicy adaptive_execution{};
+
+enum class ExecutionPath {
+    SEQUENTIAL,                 // в одном потоке
+    PARALLEL_TERMS,             // слова обходятся параллельно (поиск копит счета в ConcurrentMap)
+    PARALLEL_DOCUMENT_RANGES,   // диапазоны id документов обходятся параллельно, у каждого свои счета
+};
+
+const int EXECUTION_PATH_COUNT = 3;
+
+const char* GetExecutionPathName(ExecutionPath path);
+
+// std::thread::hardware_concurrency() (не меньше 1), прочитанное один раз: каждый вызов читает sysfs и стоит микросекунды
+size_t GetHardwareThreadCount();
+
+/*
+ *
+ * Пороги выбора пути. Максимальное значение - путь не выбирается никогда.
+ *
+ */
+
+struct AdaptiveExecutionThresholds {
+    // с какой суммы длин постингов поиск и удаление идут параллельно по словам
+    size_t parallel_terms_min_postings = std::numeric_limits<size_t>::max();
+    // с какой суммы длин постингов поиск идет параллельно по диапазонам документов; важнее порога по словам
+    size_t document_ranges_min_postings = std::numeric_limits<size_t>::max();
+    // с какого числа слов запроса MatchDocument проверяет слова параллельно
+    size_t parallel_match_min_words = std::numeric_limits<size_t>::max();
+
+    // одна строка JSON с именем замера name
+    void PrintJson(const char* name, std::ostream& out) const;
+};
+
+/*
+ *
+ * Путь для вызова стоимостью work (постингов или слов): параллельный, если work не меньше его порога
+ * и вызову достанется хотя бы два потока, когда потоки машины делятся поровну
+ * между active_count выполняющимися вызовами (включая этот).
+ *
+ */
+
+ExecutionPath ChooseExecutionPath(size_t work, size_t parallel_terms_min_work, size_t document_ranges_min_work,
+    size_t active_count);
+
+/*
+ *
+ * Пороги по замерам на синтетическом индексе: каждый путь выполняет запросы с постингами
+ * разной длины (MatchDocument - запросы с разным числом слов), порог - наименьшая стоимость,
+ * начиная с которой путь быстрее последовательного хотя бы на 10% на всех замерах.
+ * На одноядерной машине параллельные пути не выбираются и замер не проводится.
+ *
+ */
+
+AdaptiveExecutionThresholds CalibrateAdaptiveExecution();
+
+/*
+ *
+ * Замер порогов при запуске программы: первый вызов проводит CalibrateAdaptiveExecution
+ * (доли секунды на многоядерной машине), следующие возвращают его результат. Вызывается до первых запросов,
+ * сами запросы замер не запускают.
+ *
+ */
+
+const AdaptiveExecutionThresholds& WarmUpAdaptiveExecution();
+
+/*
+ *
+ * Пороги для поисковых систем без своих порогов: результат WarmUpAdaptiveExecution, а до замера -
+ * осторожные пороги без замера: параллельно, по диапазонам документов, ищутся только запросы
+ * от UNCALIBRATED_DOCUMENT_RANGES_MIN_POSTINGS постингов.
+ *
+ */
+
+const size_t UNCALIBRATED_DOCUMENT_RANGES_MIN_POSTINGS = size_t{ 1 } << 16;
+
+const AdaptiveExecutionThresholds& GetDefaultAdaptiveExecution();
+
+// сколько вызовов с adaptive_execution выполнено каждым путем
+struct AdaptiveExecutionStatistics {
+    std::array<uint64_t, EXECUTION_PATH_COUNT> path_counts{};
+
+    uint64_t GetCount(ExecutionPath path) const;
+
+    void PrintJson(const char* name, std::ostream& out) const;
+};
+
+/*
+ *
+ * Выполняющиеся вызовы и счетчики выбранных путей одной поисковой системы.
+ * Пишутся из константных методов поиска relaxed атомарными операциями.
+ *
+ */
+
+class AdaptiveExecutionCounters {
+public:
+    // вызов считается выполняющимся, пока жив этот объект
+    class ActiveCall {
+    public:
+        explicit ActiveCall(std::atomic<size_t>& active_count);
+
+        ActiveCall(const ActiveCall&) = delete;
+
+        ActiveCall& operator=(const ActiveCall&) = delete;
+
+        ~ActiveCall();
+
+    private:
+        std::atomic<size_t>& active_count_;
+    };
+
+    ActiveCall StartCall();
+
+    size_t GetActiveCount() const;
+
+    void Record(ExecutionPath path);
+
+    AdaptiveExecutionStatistics GetStatistics() const;
+
+private:
+    std::atomic<size_t> active_count_{ 0 };
+    std::array<std::atomic<uint64_t>, EXECUTION_PATH_COUNT> path_counts_{};
+};
@@ -0,0 +1,138 @@
+#include <memory>
+
+#include "async_search_server.h"
+
+using namespace std;
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, chrono::microseconds batch_window, size_t max_batch_size)
+    : search_server_(search_server)
+    , max_batch_size_(max(max_batch_size, size_t{ 1 }))
+    , batch_window_us_(batch_window.count())
+    , batch_thread_([this] { RunBatches(); }) {
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    {
+        lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    request_added_.notify_one();
+    batch_thread_.join();
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocuments(string raw_query) {
+    return FindTopDocuments(move(raw_query), DocumentStatus::ACTUAL);
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocuments(string raw_query, DocumentStatus status) {
+    return FindTopDocuments(move(raw_query), DocumentFilter::ByStatus(status));
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocuments(string raw_query, DocumentFilter filter) {
+    // std::function требует копируемости, поэтому promise хранится в shared_ptr
+    auto promise = make_shared<std::promise<vector<Document>>>();
+    future<vector<Document>> result = promise->get_future();
+    FindTopDocuments(move(raw_query), move(filter), [promise](vector<Document> documents, exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        }
+        else {
+            promise->set_value(move(documents));
+        }
+    });
+    return result;
+}
+
+void AsyncSearchServer::FindTopDocuments(string raw_query, DocumentFilter filter, Completion completion) {
+    {
+        lock_guard lock(mutex_);
+        if (stopping_) {
+            throw logic_error("AsyncSearchServer is stopping"s);
+        }
+        pending_requests_.push_back({ move(raw_query), move(filter), move(completion), Clock::now() });
+    }
+    request_count_.fetch_add(1, memory_order_relaxed);
+    request_added_.notify_one();
+}
+
+void AsyncSearchServer::SetBatchWindow(chrono::microseconds batch_window) {
+    batch_window_us_.store(batch_window.count(), memory_order_relaxed);
+}
+
+AsyncSearchServer::Statistics AsyncSearchServer::GetStatistics() const {
+    return { request_count_.load(memory_order_relaxed), batch_count_.load(memory_order_relaxed),
+        completion_error_count_.load(memory_order_relaxed) };
+}
+
+void AsyncSearchServer::RunBatches() {
+    unique_lock lock(mutex_);
+    while (true) {
+        request_added_.wait(lock, [this] {
+            return stopping_ || !pending_requests_.empty();
+        });
+        if (pending_requests_.empty()) {
+            return;
+        }
+        // ждем остальные запросы пакета не дольше окна от прихода первого
+        const Clock::time_point batch_deadline = pending_requests_.front().submit_time
+            + chrono::microseconds(batch_window_us_.load(memory_order_relaxed));
+        request_added_.wait_until(lock, batch_deadline, [this] {
+            return stopping_ || pending_requests_.size() >= max_batch_size_;
+        });
+
+        vector<Request> batch;
+        if (pending_requests_.size() <= max_batch_size_) {
+            batch.swap(pending_requests_);
+        }
+        else {
+            batch.assign(make_move_iterator(pending_requests_.begin()), make_move_iterator(pending_requests_.begin() + max_batch_size_));
+            pending_requests_.erase(pending_requests_.begin(), pending_requests_.begin() + max_batch_size_);
+        }
+        lock.unlock();
+        ProcessBatch(batch);
+        batch_count_.fetch_add(1, memory_order_relaxed);
+        lock.lock();
+    }
+}
+
+void AsyncSearchServer::ProcessBatch(vector<Request>& batch) {
+    vector<string_view> raw_queries;
+    vector<DocumentFilter> filters;
+    for (const Request& request : batch) {
+        raw_queries.push_back(request.raw_query);
+        filters.push_back(request.filter);
+    }
+
+    vector<vector<Document>> results;
+    try {
+        results = search_server_.FindTopDocumentsBatch(raw_queries, filters);
+    }
+    catch (...) {
+        // ошибка одного запроса не должна достаться остальным: ищем по одному
+        for (Request& request : batch) {
+            vector<Document> documents;
+            exception_ptr error;
+            try {
+                documents = search_server_.FindTopDocuments(request.raw_query, request.filter);
+            }
+            catch (...) {
+                error = current_exception();
+            }
+            Complete(request, move(documents), error);
+        }
+        return;
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Complete(batch[i], move(results[i]), nullptr);
+    }
+}
+
+void AsyncSearchServer::Complete(Request& request, vector<Document> documents, exception_ptr error) {
+    try {
+        request.completion(move(documents), error);
+    }
+    catch (...) {
+        // исключение из функции завершения некому передать, а поток пакетов должен обслуживать остальные запросы
+        completion_error_count_.fetch_add(1, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+/*
+ *
+ * Асинхронный поиск поверх SearchServer. Запросы из разных потоков копятся в очереди,
+ * собственный поток забирает их пакетами и ищет через FindTopDocumentsBatch: постинги общих
+ * слов обходятся один раз на пакет. Каждый вызывающий получает свой результат через future
+ * или функцию завершения - на нее удобно повесить возобновление корутины.
+ *
+ * Окно пакета - сколько поток ждет после первого запроса пакета, пока подтянутся следующие:
+ * больше окно - больше запросов делят обход постингов, но дольше ждет каждый запрос.
+ * Индекс нельзя менять, пока есть незавершенные запросы.
+ *
+ */
+
+class AsyncSearchServer {
+public:
+    using Completion = std::function<void(std::vector<Document> documents, std::exception_ptr error)>;
+
+    struct Statistics {
+        uint64_t request_count = 0;
+        uint64_t batch_count = 0;
+        // функции завершения, выбросившие исключение: оно отбрасывается, поток пакетов продолжает работу
+        uint64_t completion_error_count = 0;
+    };
+
+    AsyncSearchServer(const SearchServer& search_server, std::chrono::microseconds batch_window, size_t max_batch_size = 256);
+
+    // дожидается завершения всех принятых запросов
+    ~AsyncSearchServer();
+
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query);
+
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query, DocumentStatus status);
+
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query, DocumentFilter filter);
+
+    // completion вызывается в потоке пакетов ровно один раз, поэтому должна быть короткой
+    void FindTopDocuments(std::string raw_query, DocumentFilter filter, Completion completion);
+
+    void SetBatchWindow(std::chrono::microseconds batch_window);
+
+    Statistics GetStatistics() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        std::string raw_query;
+        DocumentFilter filter;
+        Completion completion;
+        Clock::time_point submit_time;
+    };
+
+    const SearchServer& search_server_;
+    const size_t max_batch_size_;
+    std::atomic<int64_t> batch_window_us_;
+    std::atomic<uint64_t> request_count_{ 0 };
+    std::atomic<uint64_t> batch_count_{ 0 };
+    std::atomic<uint64_t> completion_error_count_{ 0 };
+
+    std::mutex mutex_;
+    std::condition_variable request_added_;
+    std::vector<Request> pending_requests_;
+    bool stopping_ = false;
+
+    // создается последним, когда остальные поля уже готовы
+    std::thread batch_thread_;
+
+    void RunBatches();
+
+    void ProcessBatch(std::vector<Request>& batch);
+
+    // вызывает функцию завершения запроса, не выпуская из нее исключения
+    void Complete(Request& request, std::vector<Document> documents, std::exception_ptr error);
+};
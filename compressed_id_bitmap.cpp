@@ -0,0 +1,159 @@
+﻿#include <algorithm>
+
+#include "compressed_id_bitmap.h"
+
+using namespace std;
+
+namespace {
+
+// блок с большим числом id выгоднее хранить битовой картой: 4096 * 2 байта = 8 КБ
+const size_t MAX_ARRAY_CONTAINER_SIZE = 4096;
+const size_t BITMAP_CONTAINER_WORDS = 65536 / 64;
+
+uint32_t HighBits(int document_id) {
+    return static_cast<uint32_t>(document_id) >> 16;
+}
+
+uint16_t LowBits(int document_id) {
+    return static_cast<uint16_t>(document_id & 0xFFFF);
+}
+
+}  // namespace
+
+bool CompressedIdBitmap::Container::IsBitmap() const {
+    return !bits.empty();
+}
+
+void CompressedIdBitmap::Insert(int document_id) {
+    auto container = FindContainer(HighBits(document_id));
+    if (container == containers_.end() || container->high_bits != HighBits(document_id)) {
+        container = containers_.insert(container, Container{ HighBits(document_id), {}, {}, 0 });
+    }
+    const uint16_t low_bits = LowBits(document_id);
+    if (container->IsBitmap()) {
+        uint64_t& word = container->bits[low_bits / 64];
+        const uint64_t bit = uint64_t{ 1 } << (low_bits % 64);
+        if ((word & bit) != 0) {
+            return;
+        }
+        word |= bit;
+    }
+    else {
+        vector<uint16_t>& values = container->values;
+        const auto it = lower_bound(values.begin(), values.end(), low_bits);
+        if (it != values.end() && *it == low_bits) {
+            return;
+        }
+        values.insert(it, low_bits);
+        if (values.size() > MAX_ARRAY_CONTAINER_SIZE) {
+            container->bits.assign(BITMAP_CONTAINER_WORDS, 0);
+            for (const uint16_t value : values) {
+                container->bits[value / 64] |= uint64_t{ 1 } << (value % 64);
+            }
+            values.clear();
+            values.shrink_to_fit();
+        }
+    }
+    ++container->size;
+    ++size_;
+}
+
+bool CompressedIdBitmap::Erase(int document_id) {
+    const auto container = FindContainer(HighBits(document_id));
+    if (container == containers_.end() || container->high_bits != HighBits(document_id)) {
+        return false;
+    }
+    const uint16_t low_bits = LowBits(document_id);
+    if (container->IsBitmap()) {
+        uint64_t& word = container->bits[low_bits / 64];
+        const uint64_t bit = uint64_t{ 1 } << (low_bits % 64);
+        if ((word & bit) == 0) {
+            return false;
+        }
+        word &= ~bit;
+        if (container->size - 1 <= MAX_ARRAY_CONTAINER_SIZE) {
+            for (size_t word_index = 0; word_index < BITMAP_CONTAINER_WORDS; ++word_index) {
+                for (uint64_t bits = container->bits[word_index]; bits != 0; bits &= bits - 1) {
+                    container->values.push_back(static_cast<uint16_t>(word_index * 64 + __builtin_ctzll(bits)));
+                }
+            }
+            container->bits.clear();
+            container->bits.shrink_to_fit();
+        }
+    }
+    else {
+        vector<uint16_t>& values = container->values;
+        const auto it = lower_bound(values.begin(), values.end(), low_bits);
+        if (it == values.end() || *it != low_bits) {
+            return false;
+        }
+        values.erase(it);
+    }
+    --size_;
+    if (--container->size == 0) {
+        containers_.erase(container);
+    }
+    return true;
+}
+
+bool CompressedIdBitmap::Contains(int document_id) const {
+    if (document_id < 0) {
+        return false;
+    }
+    const auto container = FindContainer(HighBits(document_id));
+    if (container == containers_.end() || container->high_bits != HighBits(document_id)) {
+        return false;
+    }
+    const uint16_t low_bits = LowBits(document_id);
+    if (container->IsBitmap()) {
+        return (container->bits[low_bits / 64] >> (low_bits % 64) & 1) != 0;
+    }
+    return binary_search(container->values.begin(), container->values.end(), low_bits);
+}
+
+size_t CompressedIdBitmap::Size() const {
+    return size_;
+}
+
+size_t CompressedIdBitmap::GetByteSize() const {
+    size_t byte_size = containers_.capacity() * sizeof(Container);
+    for (const Container& container : containers_) {
+        byte_size += container.values.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return byte_size;
+}
+
+MemoryUsage CompressedIdBitmap::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.AddVector(containers_);
+    for (const Container& container : containers_) {
+        usage.AddVector(container.values);
+        usage.AddVector(container.bits);
+    }
+    return usage;
+}
+
+void CompressedIdBitmap::UnionInto(DocumentIdBitmap& bitmap) const {
+    for (const Container& container : containers_) {
+        const int base_id = static_cast<int>(container.high_bits << 16);
+        if (container.IsBitmap()) {
+            bitmap.UnionBlocks(base_id / 64, container.bits.data(), container.bits.size());
+            continue;
+        }
+        for (const uint16_t low_bits : container.values) {
+            bitmap.Insert(base_id + low_bits);
+        }
+    }
+}
+
+vector<CompressedIdBitmap::Container>::iterator CompressedIdBitmap::FindContainer(uint32_t high_bits) {
+    return lower_bound(containers_.begin(), containers_.end(), high_bits, [](const Container& container, uint32_t high_bits) {
+        return container.high_bits < high_bits;
+    });
+}
+
+vector<CompressedIdBitmap::Container>::const_iterator CompressedIdBitmap::FindContainer(uint32_t high_bits) const {
+    return lower_bound(containers_.begin(), containers_.end(), high_bits, [](const Container& container, uint32_t high_bits) {
+        return container.high_bits < high_bits;
+    });
+}
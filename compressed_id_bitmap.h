@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "document_filter.h"
+#include "memory_usage.h"
+
+/*
+ *
+ * Сжатая битовая карта id документов в духе Roaring: id делятся на блоки по 65536
+ * по старшим битам, в блоке хранятся либо отсортированные младшие 16 бит (пока их не больше 4096),
+ * либо битовая карта на 65536 бит. Редкое слово занимает 2 байта на документ,
+ * частое - не больше бита на каждый id своих блоков.
+ *
+ */
+
+class CompressedIdBitmap {
+public:
+    void Insert(int document_id);
+
+    // возвращает false, если id в карте не было
+    bool Erase(int document_id);
+
+    bool Contains(int document_id) const;
+
+    size_t Size() const;
+
+    size_t GetByteSize() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+    // добавляет все id карты в плотную карту bitmap, блоки-битовые карты - пословным OR
+    void UnionInto(DocumentIdBitmap& bitmap) const;
+
+private:
+    struct Container {
+        uint32_t high_bits;
+        // младшие 16 бит id по возрастанию, пока блок не стал битовой картой
+        std::vector<uint16_t> values;
+        // 1024 слова по 64 бита или пусто
+        std::vector<uint64_t> bits;
+        size_t size = 0;
+
+        bool IsBitmap() const;
+    };
+
+    // блоки по возрастанию старших бит
+    std::vector<Container> containers_;
+    size_t size_ = 0;
+
+    std::vector<Container>::iterator FindContainer(uint32_t high_bits);
+
+    std::vector<Container>::const_iterator FindContainer(uint32_t high_bits) const;
+};
@@ -4,6 +4,15 @@
 #include <string>
 #include <vector>
 
+enum class DocumentStatus {
+    ACTUAL,
+    IRRELEVANT,
+    BANNED,
+    REMOVED
+};
+
+const int DOCUMENT_STATUS_COUNT = 4;
+
 struct Document {
     Document();
 
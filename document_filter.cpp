@@ -0,0 +1,152 @@
+﻿#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "document_filter.h"
+
+using namespace std;
+
+namespace {
+
+// карта до стольких слов (1024 id) всегда плотная
+const size_t DENSE_MIN_BLOCK_COUNT = 16;
+
+}  // namespace
+
+void DocumentIdBitmap::Insert(int document_id) {
+    if (document_id < 0) {
+        throw invalid_argument("Negative document id in bitmap"s);
+    }
+    const size_t block_index = static_cast<size_t>(document_id) / 64;
+    if (dense_ && block_index >= blocks_.size() && !IsDenseEnough(block_index + 1, size_ + 1)) {
+        ConvertToSparse();
+    }
+    if (!dense_) {
+        const auto position = lower_bound(sparse_ids_.begin(), sparse_ids_.end(), document_id);
+        if (position != sparse_ids_.end() && *position == document_id) {
+            return;
+        }
+        sparse_ids_.insert(position, document_id);
+        ++size_;
+        if (IsDenseEnough(static_cast<size_t>(sparse_ids_.back()) / 64 + 1, size_)) {
+            ConvertToDense();
+        }
+        return;
+    }
+    if (block_index >= blocks_.size()) {
+        blocks_.resize(block_index + 1, 0);
+    }
+    const uint64_t bit = uint64_t{ 1 } << (document_id % 64);
+    if ((blocks_[block_index] & bit) == 0) {
+        blocks_[block_index] |= bit;
+        ++size_;
+    }
+}
+
+bool DocumentIdBitmap::Contains(int document_id) const {
+    if (!dense_) {
+        return binary_search(sparse_ids_.begin(), sparse_ids_.end(), document_id);
+    }
+    const size_t block_index = static_cast<size_t>(document_id) / 64;
+    return document_id >= 0 && block_index < blocks_.size()
+        && (blocks_[block_index] >> (document_id % 64) & 1) != 0;
+}
+
+size_t DocumentIdBitmap::Size() const {
+    return size_;
+}
+
+void DocumentIdBitmap::UnionBlocks(size_t first_block, const uint64_t* blocks, size_t count) {
+    if (dense_ && first_block + count > blocks_.size()) {
+        size_t added_count = 0;
+        for (size_t i = 0; i < count; ++i) {
+            added_count += __builtin_popcountll(blocks[i]);
+        }
+        if (!IsDenseEnough(first_block + count, size_ + added_count)) {
+            ConvertToSparse();
+        }
+    }
+    if (!dense_) {
+        vector<int> added_ids;
+        for (size_t i = 0; i < count; ++i) {
+            for (uint64_t block = blocks[i]; block != 0; block &= block - 1) {
+                added_ids.push_back(static_cast<int>((first_block + i) * 64 + __builtin_ctzll(block)));
+            }
+        }
+        vector<int> merged_ids;
+        merged_ids.reserve(sparse_ids_.size() + added_ids.size());
+        set_union(sparse_ids_.begin(), sparse_ids_.end(), added_ids.begin(), added_ids.end(), back_inserter(merged_ids));
+        sparse_ids_ = move(merged_ids);
+        size_ = sparse_ids_.size();
+        if (!sparse_ids_.empty() && IsDenseEnough(static_cast<size_t>(sparse_ids_.back()) / 64 + 1, size_)) {
+            ConvertToDense();
+        }
+        return;
+    }
+    if (first_block + count > blocks_.size()) {
+        blocks_.resize(first_block + count, 0);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t& block = blocks_[first_block + i];
+        size_ += __builtin_popcountll(blocks[i] & ~block);
+        block |= blocks[i];
+    }
+}
+
+bool DocumentIdBitmap::IsDense() const {
+    return dense_;
+}
+
+const vector<uint64_t>& DocumentIdBitmap::GetBlocks() const {
+    return blocks_;
+}
+
+const vector<int>& DocumentIdBitmap::GetSparseIds() const {
+    return sparse_ids_;
+}
+
+bool DocumentIdBitmap::IsDenseEnough(size_t block_count, size_t size) {
+    // слово карты - 8 байт, id в списке - 4: плотная карта не больше чем вдвое тяжелее списка
+    return block_count <= max(size, DENSE_MIN_BLOCK_COUNT);
+}
+
+void DocumentIdBitmap::ConvertToDense() {
+    blocks_.assign(sparse_ids_.empty() ? 0 : static_cast<size_t>(sparse_ids_.back()) / 64 + 1, 0);
+    for (const int document_id : sparse_ids_) {
+        blocks_[document_id / 64] |= uint64_t{ 1 } << (document_id % 64);
+    }
+    vector<int>().swap(sparse_ids_);
+    dense_ = true;
+}
+
+void DocumentIdBitmap::ConvertToSparse() {
+    sparse_ids_.reserve(size_);
+    ForEach([this](int document_id) {
+        sparse_ids_.push_back(document_id);
+    });
+    vector<uint64_t>().swap(blocks_);
+    dense_ = false;
+}
+
+DocumentFilter DocumentFilter::ByStatus(DocumentStatus status) {
+    DocumentFilter filter;
+    filter.statuses.reset();
+    filter.statuses.set(static_cast<size_t>(status));
+    return filter;
+}
+
+bool DocumentFilter::HasRatingRange() const {
+    return min_rating.has_value() || max_rating.has_value();
+}
+
+bool DocumentFilter::HasAttributeConditions() const {
+    return HasRatingRange() || allowed_ids.has_value() || denied_ids.Size() > 0;
+}
+
+bool DocumentFilter::Accepts(int document_id, DocumentStatus status, int rating) const {
+    return statuses.test(static_cast<size_t>(status))
+        && (!min_rating || rating >= *min_rating)
+        && (!max_rating || rating <= *max_rating)
+        && (!allowed_ids || allowed_ids->Contains(document_id))
+        && !denied_ids.Contains(document_id);
+}
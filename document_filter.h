@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+
+using DocumentStatusSet = std::bitset<DOCUMENT_STATUS_COUNT>;
+
+/*
+ *
+ * Множество id документов. Пока id плотные, это битовая карта с проверкой за O(1);
+ * если слов карты понадобилось бы больше, чем id в множестве (редкие или большие id,
+ * например INT_MAX), id хранятся отсортированным списком с проверкой за O(log n).
+ * Так память не больше 8 байт на id при любом разбросе id.
+ *
+ */
+
+class DocumentIdBitmap {
+public:
+    DocumentIdBitmap() = default;
+
+    template <typename IdContainer>
+    explicit DocumentIdBitmap(const IdContainer& ids);
+
+    void Insert(int document_id);
+
+    bool Contains(int document_id) const;
+
+    // количество id в карте
+    size_t Size() const;
+
+    // OR с count словами по 64 id, начиная со слова first_block
+    void UnionBlocks(size_t first_block, const uint64_t* blocks, size_t count);
+
+    // хранятся ли id битовой картой
+    bool IsDense() const;
+
+    // слова карты: бит i слова k - id 64 * k + i; пусто, если id хранятся списком
+    const std::vector<uint64_t>& GetBlocks() const;
+
+    // id по возрастанию, если карта хранится списком, иначе пусто
+    const std::vector<int>& GetSparseIds() const;
+
+    // обход id в порядке возрастания
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    std::vector<uint64_t> blocks_;
+    std::vector<int> sparse_ids_;
+    size_t size_ = 0;
+    bool dense_ = true;
+
+    // выгодна ли битовая карта из block_count слов для size id
+    static bool IsDenseEnough(size_t block_count, size_t size);
+
+    void ConvertToDense();
+
+    void ConvertToSparse();
+};
+
+/*
+ *
+ * Структурированный фильтр документов для FindTopDocuments.
+ * В отличие от произвольного предиката, проверяется поисковой системой
+ * прямо во время обхода постингов, а узкие фильтры (мало разрешенных id
+ * или узкий диапазон рейтинга) сами задают список кандидатов.
+ *
+ */
+
+struct DocumentFilter {
+    DocumentStatusSet statuses = DocumentStatusSet().set();
+    std::optional<int> min_rating;
+    std::optional<int> max_rating;
+    std::optional<DocumentIdBitmap> allowed_ids;
+    DocumentIdBitmap denied_ids;
+
+    static DocumentFilter ByStatus(DocumentStatus status);
+
+    bool HasRatingRange() const;
+
+    // есть ли условия помимо статуса
+    bool HasAttributeConditions() const;
+
+    bool Accepts(int document_id, DocumentStatus status, int rating) const;
+};
+
+template <typename IdContainer>
+DocumentIdBitmap::DocumentIdBitmap(const IdContainer& ids) {
+    for (const int document_id : ids) {
+        Insert(document_id);
+    }
+}
+
+template <typename Function>
+void DocumentIdBitmap::ForEach(Function function) const {
+    for (const int document_id : sparse_ids_) {
+        function(document_id);
+    }
+    for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+        for (uint64_t block = blocks_[block_index]; block != 0; block &= block - 1) {
+            function(static_cast<int>(block_index * 64 + __builtin_ctzll(block)));
+        }
+    }
+}
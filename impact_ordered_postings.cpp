@@ -0,0 +1,68 @@
+﻿#include <algorithm>
+#include <array>
+
+#include "impact_ordered_postings.h"
+
+using namespace std;
+
+ImpactOrderedPostings::ImpactOrderedPostings(const PostingList& postings) {
+    array<vector<int>, 256> document_ids_by_impact;
+    for (const auto [document_id, term_freq] : postings) {
+        document_ids_by_impact[PostingList::QuantizeTermFreq(term_freq)].push_back(document_id);
+    }
+    for (int impact = 255; impact > 0; --impact) {
+        if (!document_ids_by_impact[impact].empty()) {
+            segments_.push_back({ static_cast<uint8_t>(impact), move(document_ids_by_impact[impact]) });
+        }
+    }
+    size_ = postings.size();
+}
+
+void ImpactOrderedPostings::Add(int document_id, uint8_t impact) {
+    auto segment = lower_bound(segments_.begin(), segments_.end(), impact, [](const Segment& lhs, uint8_t impact) {
+        return lhs.impact > impact;
+    });
+    if (segment == segments_.end() || segment->impact != impact) {
+        segment = segments_.insert(segment, { impact, {} });
+    }
+    vector<int>& document_ids = segment->document_ids;
+    document_ids.insert(lower_bound(document_ids.begin(), document_ids.end(), document_id), document_id);
+    ++size_;
+}
+
+bool ImpactOrderedPostings::Erase(int document_id, uint8_t impact) {
+    const auto segment = lower_bound(segments_.begin(), segments_.end(), impact, [](const Segment& lhs, uint8_t impact) {
+        return lhs.impact > impact;
+    });
+    if (segment == segments_.end() || segment->impact != impact) {
+        return false;
+    }
+    vector<int>& document_ids = segment->document_ids;
+    const auto it = lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (it == document_ids.end() || *it != document_id) {
+        return false;
+    }
+    document_ids.erase(it);
+    if (document_ids.empty()) {
+        segments_.erase(segment);
+    }
+    --size_;
+    return true;
+}
+
+const vector<ImpactOrderedPostings::Segment>& ImpactOrderedPostings::GetSegments() const {
+    return segments_;
+}
+
+size_t ImpactOrderedPostings::size() const {
+    return size_;
+}
+
+MemoryUsage ImpactOrderedPostings::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.AddVector(segments_);
+    for (const Segment& segment : segments_) {
+        usage.AddVector(segment.document_ids);
+    }
+    return usage;
+}
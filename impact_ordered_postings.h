@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "posting_list.h"
+
+/*
+ *
+ * Постинги слова, упорядоченные по убыванию квантованной частоты (impact):
+ * документы с одинаковой частотой лежат в одном сегменте, внутри сегмента - по возрастанию id.
+ * Для частых слов позволяет обходить сначала документы с наибольшим вкладом
+ * и останавливаться, когда топ уже не может измениться.
+ *
+ */
+
+class ImpactOrderedPostings {
+public:
+    struct Segment {
+        uint8_t impact;
+        std::vector<int> document_ids;
+    };
+
+    ImpactOrderedPostings() = default;
+
+    explicit ImpactOrderedPostings(const PostingList& postings);
+
+    void Add(int document_id, uint8_t impact);
+
+    // возвращает false, если документа с такой частотой не было
+    bool Erase(int document_id, uint8_t impact);
+
+    // сегменты по убыванию impact, пустых сегментов нет
+    const std::vector<Segment>& GetSegments() const;
+
+    size_t size() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    std::vector<Segment> segments_;
+    size_t size_ = 0;
+};
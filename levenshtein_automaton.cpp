@@ -0,0 +1,115 @@
+﻿#include <algorithm>
+
+#include "levenshtein_automaton.h"
+
+using namespace std;
+
+namespace {
+
+const char32_t MAX_CODE_POINT = 0x10FFFF;
+const char32_t FIRST_SURROGATE = 0xD800;
+const char32_t LAST_SURROGATE = 0xDFFF;
+// некорректный байт b читается символом INVALID_BYTE_BASE + b
+const char32_t INVALID_BYTE_BASE = 0xDC00;
+
+bool IsContinuationByte(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+}  // namespace
+
+LevenshteinAutomaton::LevenshteinAutomaton(string_view word, int max_distance)
+    : max_distance_(max_distance) {
+    for (size_t position = 0; position < word.size();) {
+        word_ += DecodeUtf8(word, position);
+    }
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Start() const {
+    State state(word_.size() + 1);
+    for (size_t i = 0; i < state.size(); ++i) {
+        state[i] = min(static_cast<int>(i), max_distance_ + 1);
+    }
+    return state;
+}
+
+size_t LevenshteinAutomaton::Step(const State& state, string_view text, size_t position, State& next) const {
+    const char32_t c = DecodeUtf8(text, position);
+    next.resize(state.size());
+    next[0] = min(state[0] + 1, max_distance_ + 1);
+    for (size_t i = 1; i < state.size(); ++i) {
+        const int replace_cost = state[i - 1] + (word_[i - 1] == c ? 0 : 1);
+        next[i] = min({ replace_cost, state[i] + 1, next[i - 1] + 1, max_distance_ + 1 });
+    }
+    return position;
+}
+
+bool LevenshteinAutomaton::IsMatch(const State& state) const {
+    return state.back() <= max_distance_;
+}
+
+bool LevenshteinAutomaton::CanMatch(const State& state) const {
+    return *min_element(state.begin(), state.end()) <= max_distance_;
+}
+
+int LevenshteinAutomaton::GetDistance(const State& state) const {
+    return state.back();
+}
+
+int LevenshteinAutomaton::GetMaxDistance() const {
+    return max_distance_;
+}
+
+char32_t DecodeUtf8(string_view text, size_t& position) {
+    const unsigned char lead = static_cast<unsigned char>(text[position]);
+    if (lead < 0x80) {
+        ++position;
+        return lead;
+    }
+    const size_t length = lead >= 0xC2 && lead < 0xE0 ? 2 : lead >= 0xE0 && lead < 0xF0 ? 3 : lead >= 0xF0 && lead < 0xF5 ? 4 : 0;
+    bool valid = length != 0 && position + length <= text.size();
+    char32_t code_point = lead & (0x7F >> length);
+    for (size_t i = 1; valid && i < length; ++i) {
+        valid = IsContinuationByte(text[position + i]);
+        code_point = code_point << 6 | (static_cast<unsigned char>(text[position + i]) & 0x3F);
+    }
+    // слишком длинные записи, суррогаты и значения за MAX_CODE_POINT - не UTF-8
+    valid = valid && !(length == 3 && code_point < 0x800) && !(length == 4 && code_point < 0x10000)
+        && code_point <= MAX_CODE_POINT && (code_point < FIRST_SURROGATE || code_point > LAST_SURROGATE);
+    if (!valid) {
+        ++position;
+        return INVALID_BYTE_BASE + lead;
+    }
+    position += length;
+    return code_point;
+}
+
+size_t CountUtf8Characters(string_view text) {
+    size_t count = 0;
+    for (size_t position = 0; position < text.size(); ++count) {
+        DecodeUtf8(text, position);
+    }
+    return count;
+}
+
+optional<string> GetPrefixSuccessor(string_view prefix) {
+    if (prefix.empty()) {
+        return string();
+    }
+    // последний символ начинается не раньше чем за 3 байта продолжения до конца
+    size_t start = prefix.size() - 1;
+    while (start > 0 && prefix.size() - start < 4 && IsContinuationByte(prefix[start])) {
+        --start;
+    }
+    size_t end = start;
+    const char32_t code_point = DecodeUtf8(prefix, end);
+    if (end != prefix.size() || (code_point >= FIRST_SURROGATE && code_point <= LAST_SURROGATE)) {
+        return nullopt;
+    }
+    // последний байт корректного символа меньше 0xC0: за всеми его продолжениями идет символ
+    // с тем же началом и следующим последним байтом. Это еще не всегда корректный UTF-8
+    // (за "п" - D0 C0, а не "р"), зато не пропускаются слова с некорректными байтами между ними
+    string successor(prefix);
+    successor.back() = static_cast<char>(static_cast<unsigned char>(successor.back()) + 1);
+    return successor;
+}
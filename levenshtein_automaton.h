@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ *
+ * Автомат Левенштейна для слова word: принимает строки, отличающиеся от word
+ * не больше чем на max_distance вставок, удалений и замен символов.
+ * Символ - кодовая точка UTF-8 (см. DecodeUtf8), поэтому замена кириллической буквы - одна правка.
+ * Состояние - строка таблицы расстояний для прочитанного префикса, значения ограничены max_distance + 1.
+ * Если из состояния уже нельзя прийти в принимающее (CanMatch() == false),
+ * все строки с прочитанным префиксом можно пропустить - так автомат пересекается
+ * с отсортированным словарем без перебора всех слов.
+ *
+ */
+
+class LevenshteinAutomaton {
+public:
+    using State = std::vector<int>;
+
+    LevenshteinAutomaton(std::string_view word, int max_distance);
+
+    State Start() const;
+
+    // переход по символу, начинающемуся в text[position]; возвращает позицию за символом.
+    // next переиспользует уже выделенную память
+    size_t Step(const State& state, std::string_view text, size_t position, State& next) const;
+
+    bool IsMatch(const State& state) const;
+
+    bool CanMatch(const State& state) const;
+
+    // расстояние до word для принятой строки
+    int GetDistance(const State& state) const;
+
+    int GetMaxDistance() const;
+
+private:
+    std::u32string word_;
+    int max_distance_;
+};
+
+/*
+ *
+ * Декодирует символ UTF-8, начинающийся в text[position], и сдвигает position за него.
+ * Байт, не начинающий корректную последовательность, читается отдельным символом 0xDC00 + байт
+ * (суррогаты не бывают кодовыми точками UTF-8, так что с настоящими символами он не совпадет).
+ *
+ */
+
+char32_t DecodeUtf8(std::string_view text, size_t& position);
+
+// число символов UTF-8 в text
+size_t CountUtf8Characters(std::string_view text);
+
+/*
+ *
+ * Наименьшая строка, большая всех строк, которые начинаются символами prefix; пустая, если prefix пуст.
+ * Последний символ prefix должен быть целым: строки, начинающиеся с него, идут в словаре подряд.
+ * Если последний символ - некорректный байт, строки с такими же байтами могут читаться
+ * другими символами (байт 0xD0 - начало буквы "а"), поэтому пропускать нечего - nullopt.
+ *
+ */
+
+std::optional<std::string> GetPrefixSuccessor(std::string_view prefix);
@@ -1,10 +1,21 @@
-﻿#include <iostream>
+﻿#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <future>
+#include <iostream>
 #include <stdexcept>
+#include <thread>
 
 #include "request_queue.h"
+#include "async_search_server.h"
 #include "log_duration.h"
 #include "remove_duplicates.h"
 #include "process_queries.h"
+#include "search_benchmark.h"
+#include "query_replay.h"
+#include "query_client.h"
+#include "query_server.h"
+#include "sharded_search_server.h"
 
 using namespace std;
 
@@ -91,14 +102,76 @@ void TestGetDocumentId(const SearchServer& search_server, int id) {
     }
 }
 
-int main() {
+// те же документы в том же порядке и с той же релевантностью
+bool IsSameTop(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs_document, const Document& rhs_document) {
+        return lhs_document.id == rhs_document.id && abs(lhs_document.relevance - rhs_document.relevance) < 1e-6;
+    });
+}
+
+void Check(bool condition, string_view name) {
+    cout << name << ": "s << (condition ? "ok"s : "FAILED"s) << endl;
+    assert(condition);
+}
+
+int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "Russian");
 
+    /* Запуск бенчмарка вместо тестов: search_server --benchmark docs=100000 queries=1000 ... */
+    if (argc > 1 && argv[1] == "--benchmark"s) {
+        RunSearchBenchmark(ParseBenchmarkConfig(vector<string>(argv + 2, argv + argc)), cout);
+        return 0;
+    }
+
+    /* Память индекса на корпусах разного размера: search_server --memory docs=100000 ... */
+    if (argc > 1 && argv[1] == "--memory"s) {
+        RunMemoryBenchmark(ParseBenchmarkConfig(vector<string>(argv + 2, argv + argc)), cout);
+        return 0;
+    }
+
+    /* Воспроизведение лога запросов с постоянной частотой: search_server --replay log=queries.jsonl rate=2000 threads=8 */
+    if (argc > 1 && argv[1] == "--replay"s) {
+        RunQueryReplayTool(vector<string>(argv + 2, argv + argc), cout);
+        return 0;
+    }
+
+    /* Сетевой сервер запросов с пустым индексом: search_server --serve port=8090 address=0.0.0.0 stop_words="и в на" */
+    if (argc > 1 && argv[1] == "--serve"s) {
+        uint16_t port = 8090;
+        string address = "127.0.0.1"s;
+        string stop_words;
+        for (int i = 2; i < argc; ++i) {
+            const string_view arg = argv[i];
+            const size_t separator = arg.find('=');
+            const string_view key = arg.substr(0, separator);
+            const string value(separator == string_view::npos ? ""sv : arg.substr(separator + 1));
+            if (key == "port"sv) {
+                port = static_cast<uint16_t>(stoi(value));
+            }
+            else if (key == "address"sv) {
+                address = value;
+            }
+            else if (key == "stop_words"sv) {
+                stop_words = value;
+            }
+            else {
+                cout << "Unknown server option "s << arg << endl;
+                return 1;
+            }
+        }
+        SearchServer search_server(stop_words);
+        QueryServer query_server(search_server, port, address);
+        cout << "Listening on "s << address << ':' << query_server.GetPort() << endl;
+        query_server.Run();
+        return 0;
+    }
+
     /* Добавление слов/предлогов через конструктор, которые не нужно учитывать */
     SearchServer search_server("и в на"s);
 
-    /* Cколько за последние сутки было запросов? */
-    RequestQueue request_queue(search_server);
+    /* Cколько за последние сутки было запросов? Время моделируется: запросы идут раз в минуту */
+    RequestQueue::Clock::time_point simulated_time;
+    RequestQueue request_queue(search_server, 24h, 1min, [&simulated_time] { return simulated_time; });
 
     /* Добавление текста в документы */
     search_server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
@@ -129,13 +202,17 @@ int main() {
     /* Cколько за последние сутки было запросов? */
     // 1439 запросов с нулевым результатом
     for (int i = 0; i < 1439; ++i) {
+        simulated_time += 1min;
         request_queue.AddFindRequest("пустой запрос"s);
     }
     // все еще 1439 запросов с нулевым результатом
+    simulated_time += 1min;
     request_queue.AddFindRequest("пушистый пёс"s);
     // новые сутки, первый запрос удален, 1438 запросов с нулевым результатом
+    simulated_time += 1min;
     request_queue.AddFindRequest("большой ошейник"s);
     // первый запрос удален, 1437 запросов с нулевым результатом
+    simulated_time += 1min;
     request_queue.AddFindRequest("скворец"s);
     cout << "Запросов, по которым ничего не нашлось "s << request_queue.GetNoResultRequests() << endl;
     cout << endl;
@@ -427,6 +504,14 @@ int main() {
             cout << words.size() << " words for document 3"s << endl;
             // 0 words for document 3
         }
+
+        {
+            LOG_DURATION_STREAM("Operation time", cout);
+            for (const auto& [words, status] : search_server.MatchDocuments(execution::par, query, { 1, 2, 3 })) {
+                cout << words.size() << " words"s << endl;
+            }
+            // 1, 2, 0 words for documents 1, 2, 3
+        }
     }
     cout << endl;
 
@@ -456,10 +541,475 @@ int main() {
         PrintDocument(document);
     }
 
+    cout << "All words required:"s << endl;
+    for (const Document& document : search_server_par.FindTopDocuments(execution::par, "+curly +cat"s)) {
+        PrintDocument(document);
+    }
+
+    cout << "Phrase and NEAR:"s << endl;
+    search_server_par.EnablePositionalIndex();
+    for (const Document& document : search_server_par.FindTopDocuments(execution::par, "\"nasty dog\" -cat"s)) {
+        PrintDocument(document);
+    }
+    for (const Document& document : search_server_par.FindTopDocuments("curly NEAR/2 tail"s)) {
+        PrintDocument(document);
+    }
+
+    cout << "BM25:"s << endl;
+    for (const Document& document : search_server_par.FindTopDocuments(execution::par, "curly nasty cat"s, DocumentFilter(), Bm25Ranking())) {
+        PrintDocument(document);
+    }
+
+    cout << "Fuzzy:"s << endl;
+    search_server_par.SetFuzzyMatching(1);
+    for (const Document& document : search_server_par.FindTopDocuments("curli cot"s)) {
+        PrintDocument(document);
+    }
+    search_server_par.SetFuzzyMatching(0);
+    // правки считаются в символах: пропущенная или лишняя кириллическая буква - одна правка, а не две (байта)
+    search_server.SetFuzzyMatching(1);
+    for (const string& query : { "пушистй"s, "пушистыйй"s, "скворц"s }) {
+        cout << query << ":"s << endl;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            PrintDocument(document);
+        }
+    }
+    search_server.SetFuzzyMatching(0);
+
     cout << "Even ids:"s << endl;
     for (const Document& document : search_server_par.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
         PrintDocument(document);
     }
 
+    /* Тест структурированного фильтра документов */
+    {
+        cout << "Тест DocumentFilter:"s << endl;
+        SearchServer search_server_filter("and with"s);
+
+        search_server_filter.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1 });
+        search_server_filter.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 5 });
+        search_server_filter.AddDocument(3, "nasty dog with big eyes"s, DocumentStatus::BANNED, { 7 });
+        search_server_filter.AddDocument(4, "nasty pigeon john"s, DocumentStatus::ACTUAL, { 9 });
+
+        DocumentFilter filter;
+        filter.min_rating = 2;
+        filter.denied_ids.Insert(4);
+        cout << "Rating >= 2, id != 4:"s << endl;
+        for (const Document& document : search_server_filter.FindTopDocuments("curly nasty cat"s, filter)) {
+            PrintDocument(document);
+        }
+
+        DocumentFilter tenant_filter = DocumentFilter::ByStatus(DocumentStatus::ACTUAL);
+        tenant_filter.allowed_ids = DocumentIdBitmap(vector<int>{ 1, 3 });
+        cout << "ACTUAL, id in {1, 3}:"s << endl;
+        for (const Document& document : search_server_filter.FindTopDocuments(execution::par, "curly nasty cat"s, tenant_filter)) {
+            PrintDocument(document);
+        }
+    }
+
+    /* Проверки согласованности: особые пути поиска сравниваются с обычным FindTopDocuments */
+    {
+        cout << "Проверки согласованности:"s << endl;
+        const vector<string> words = { "white"s, "cat"s, "curly"s, "tail"s, "nasty"s, "dog"s, "pigeon"s, "hat"s, "eyes"s, "john"s };
+        // у слова "cat" больше постингов, чем в одном блоке бюджета; рейтинги разные, чтобы порядок выдачи был однозначным
+        const int document_count = 600;
+        const auto make_text = [&words](int i) {
+            return words[i % 10] + " "s + words[i / 10 % 10] + " "s + words[(i * 7 + 3) % 10] + " and cat"s;
+        };
+        const auto make_status = [](int i) {
+            return i % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        };
+        const vector<string> queries = { "curly tail"s, "nasty dog -white"s, "+hat eyes"s, "pigeon john cat"s };
+        // корпус после правок: каждый третий документ получает текст следующего, каждый пятый - статус BANNED
+        const auto add_documents = [&](auto& server, int count) {
+            for (int i = 0; i < count; ++i) {
+                const DocumentStatus status = i % 5 == 0 ? DocumentStatus::BANNED : make_status(i);
+                server.AddDocument(i, make_text(i % 3 == 0 ? i + 1 : i), status, { i });
+            }
+        };
+
+        {
+            SearchServer updated_server("and with"s);
+            SearchServer rebuilt_server("and with"s);
+            for (int i = 0; i < document_count; ++i) {
+                updated_server.AddDocument(i, make_text(i), make_status(i), { i });
+            }
+            for (int i = 0; i < document_count; ++i) {
+                if (i % 3 == 0) {
+                    updated_server.UpdateDocument(i, make_text(i + 1), make_status(i), { i });
+                }
+                if (i % 5 == 0) {
+                    updated_server.SetDocumentStatus(i, DocumentStatus::BANNED);
+                }
+            }
+            add_documents(rebuilt_server, document_count);
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                return IsSameTop(updated_server.FindTopDocuments(query), rebuilt_server.FindTopDocuments(query))
+                    && IsSameTop(updated_server.FindTopDocuments(query, DocumentStatus::BANNED), rebuilt_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            }), "UpdateDocument и SetDocumentStatus = индекс, построенный заново"s);
+        }
+
+        // после удаления документа с наибольшим id его постинги остаются в списках удаленными
+        // и не должны попасть в массив квантованных счетов
+        {
+            SearchServer mutated_server("and with"s);
+            SearchServer rebuilt_server("and with"s);
+            add_documents(mutated_server, document_count);
+            add_documents(rebuilt_server, document_count - 1);
+            mutated_server.RemoveDocument(document_count - 1);
+            mutated_server.SetQuantizedScoring(true);
+            rebuilt_server.SetQuantizedScoring(true);
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                return IsSameTop(mutated_server.FindTopDocuments(query), rebuilt_server.FindTopDocuments(query));
+            }) && IsSameTop(mutated_server.FindTopDocuments("+curly +tail cat"s), rebuilt_server.FindTopDocuments("+curly +tail cat"s)),
+                "RemoveDocument с наибольшим id = индекс без него (квантованный поиск)"s);
+        }
+
+        // квантованные счета: те же документы, что у точного TF-IDF, релевантность отличается на доли процента
+        {
+            SearchServer exact_server("and with"s);
+            SearchServer quantized_server("and with"s);
+            add_documents(exact_server, document_count);
+            add_documents(quantized_server, document_count);
+            quantized_server.SetQuantizedScoring(true);
+            const auto by_id = [](vector<Document> documents) {
+                sort(documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs) {
+                    return lhs.id < rhs.id;
+                });
+                return documents;
+            };
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                const vector<Document> exact_documents = by_id(exact_server.FindTopDocumentsPage(query, DocumentFilter(), nullopt, document_count).documents);
+                const vector<Document> quantized_documents = by_id(quantized_server.FindTopDocumentsPage(query, DocumentFilter(), nullopt, document_count).documents);
+                return equal(exact_documents.begin(), exact_documents.end(), quantized_documents.begin(), quantized_documents.end(),
+                    [](const Document& exact_document, const Document& quantized_document) {
+                        return exact_document.id == quantized_document.id
+                            && abs(exact_document.relevance - quantized_document.relevance) <= 0.01 * exact_document.relevance + 1e-3;
+                    });
+            }), "квантованный поиск = точный TF-IDF с точностью квантования"s);
+        }
+
+        // ошибка в запросе - ответ ERROR, соединение и сервер продолжают работать
+        {
+            SearchServer search_server("and with"s);
+            QueryServer query_server(search_server, 0);
+            thread server_thread([&query_server] { query_server.Run(); });
+            QueryClient client("127.0.0.1"s, query_server.GetPort());
+            const auto is_rejected = [&client] {
+                try {
+                    client.ReceiveAcknowledgement();
+                    return false;
+                }
+                catch (const runtime_error&) {
+                    return true;
+                }
+            };
+            client.SendAddDocument(1, "curly cat"s, static_cast<DocumentStatus>(DOCUMENT_STATUS_COUNT), { 1 });
+            const bool unknown_status_rejected = is_rejected();
+            client.SendAddDocument(1, "curly dog"s, DocumentStatus::ACTUAL, {});
+            client.SendAddDocument(1, "curly dog"s, DocumentStatus::ACTUAL, { 5 });
+            const bool empty_ratings_accepted = !is_rejected();
+            const bool duplicate_rejected = is_rejected();
+            const vector<Document> documents = client.FindTopDocuments("curly"s);
+            query_server.Stop();
+            server_thread.join();
+            Check(unknown_status_rejected && empty_ratings_accepted && duplicate_rejected
+                && documents.size() == 1 && documents.front().id == 1 && documents.front().rating == 0,
+                "QueryServer: ошибка запроса - ответ ERROR, без рейтингов - рейтинг 0"s);
+        }
+
+        // страницы по 3 документа подряд - вся выдача, первые из них - обычный топ
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            const string query = "curly tail cat"s;
+            vector<Document> paged_documents;
+            optional<SearchCursor> cursor;
+            do {
+                const SearchPage page = search_server.FindTopDocumentsPage(query, DocumentFilter(), cursor, 3);
+                paged_documents.insert(paged_documents.end(), page.documents.begin(), page.documents.end());
+                cursor = page.next_cursor;
+            } while (cursor);
+            const SearchPage all_documents = search_server.FindTopDocumentsPage(query, DocumentFilter(), nullopt, document_count);
+            const vector<Document> top_documents = search_server.FindTopDocuments(query, DocumentFilter());
+            Check(IsSameTop(paged_documents, all_documents.documents) && !all_documents.next_cursor
+                && IsSameTop(top_documents, vector<Document>(paged_documents.begin(), paged_documents.begin() + min(top_documents.size(), paged_documents.size()))),
+                "страницы FindTopDocumentsPage = вся выдача"s);
+        }
+
+        // бюджет без ограничений не меняет выдачу, урезанный - отмечен частичным и не завышает релевантность
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            const string query = "curly tail cat"s;
+            const vector<Document> all_documents = search_server.FindTopDocumentsPage(query, DocumentFilter(), nullopt, document_count).documents;
+            const SearchResult complete_result = search_server.FindTopDocuments(query, DocumentFilter(), SearchBudget());
+            const SearchResult partial_result = search_server.FindTopDocuments(query, DocumentFilter(), SearchBudget::WithPostings(1));
+            Check(!complete_result.is_partial && IsSameTop(complete_result.documents, search_server.FindTopDocuments(query, DocumentFilter()))
+                && partial_result.is_partial && partial_result.documents.size() <= MAX_RESULT_DOCUMENT_COUNT
+                && all_of(partial_result.documents.begin(), partial_result.documents.end(), [&all_documents](const Document& document) {
+                    const auto it = find_if(all_documents.begin(), all_documents.end(), [&document](const Document& complete_document) {
+                        return complete_document.id == document.id;
+                    });
+                    return it != all_documents.end() && document.relevance <= it->relevance + 1e-6;
+                }), "SearchBudget: полный поиск = обычный, урезанный - частичный"s);
+        }
+
+        // шарды раскрывают "prefix*" и слова с опечатками по словарю всего корпуса
+        {
+            SearchServer search_server("and with"s);
+            ShardedSearchServer sharded_server(vector<string>{ "and"s, "with"s }, 3);
+            add_documents(search_server, document_count);
+            add_documents(sharded_server, document_count);
+            search_server.SetFuzzyMatching(1);
+            sharded_server.SetFuzzyMatching(1);
+            vector<string> sharded_queries = queries;
+            sharded_queries.insert(sharded_queries.end(), { "cur* -dog"s, "curli nasty dgo"s, "pigen -whte ey* \"curly tail\""s });
+            Check(all_of(sharded_queries.begin(), sharded_queries.end(), [&](const string& query) {
+                return IsSameTop(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query));
+            }), "ShardedSearchServer = один индекс"s);
+        }
+
+        // обход по убыванию вклада без бюджета останавливается, только когда топ уже не изменится
+        {
+            SearchServer quantized_server("and with"s);
+            SearchServer impact_server("and with"s);
+            add_documents(quantized_server, document_count);
+            add_documents(impact_server, document_count);
+            quantized_server.SetQuantizedScoring(true);
+            impact_server.SetImpactOrderedPostings(1);
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                return IsSameTop(impact_server.FindTopDocuments(query), quantized_server.FindTopDocuments(query))
+                    && IsSameTop(impact_server.FindTopDocuments(query, DocumentStatus::BANNED), quantized_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            }), "SetImpactOrderedPostings без бюджета = полный квантованный поиск"s);
+        }
+
+        // "dog" есть больше чем в DENSE_TERM_MIN_DOCUMENT_COUNT документах - минус слово вычитается картой документов
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            vector<Document> expected_documents = search_server.FindTopDocumentsPage("curly tail"s, DocumentFilter(), nullopt, document_count).documents;
+            expected_documents.erase(remove_if(expected_documents.begin(), expected_documents.end(), [&search_server](const Document& document) {
+                return search_server.GetWordFrequencies(document.id).count("dog"sv) > 0;
+            }), expected_documents.end());
+            Check(IsSameTop(search_server.FindTopDocumentsPage("curly tail -dog"s, DocumentFilter(), nullopt, document_count).documents, expected_documents),
+                "минус слово картой документов = исключение по постингам"s);
+        }
+
+        // "c*" раскрывается в "cat" и "curly", "-n*" - в "nasty"
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            Check(IsSameTop(search_server.FindTopDocumentsPage("c* -n*"s, DocumentFilter(), nullopt, document_count).documents,
+                search_server.FindTopDocumentsPage("cat curly -nasty"s, DocumentFilter(), nullopt, document_count).documents),
+                "\"prefix*\" = перечисление слов с этим префиксом"s);
+        }
+
+        // фраза находит ровно документы, где слова идут подряд; с позиционным индексом и без него - одна выдача
+        {
+            SearchServer positional_server("and with"s);
+            SearchServer text_server("and with"s);
+            add_documents(positional_server, document_count);
+            add_documents(text_server, document_count);
+            positional_server.EnablePositionalIndex();
+            vector<int> phrase_ids;
+            for (const Document& document : positional_server.FindTopDocumentsPage("\"curly tail\""s, DocumentFilter(), nullopt, document_count).documents) {
+                phrase_ids.push_back(document.id);
+            }
+            sort(phrase_ids.begin(), phrase_ids.end());
+            vector<int> expected_ids;
+            for (int i = 0; i < document_count; ++i) {
+                if (make_text(i % 3 == 0 ? i + 1 : i).find("curly tail"s) != string::npos) {
+                    expected_ids.push_back(i);
+                }
+            }
+            const vector<string> positional_queries = { "\"curly tail\""s, "\"tail curly\" dog"s, "curly NEAR/1 tail"s, "dog NEAR/2 hat -eyes"s };
+            Check(!expected_ids.empty() && phrase_ids == expected_ids
+                && all_of(positional_queries.begin(), positional_queries.end(), [&](const string& query) {
+                    return IsSameTop(positional_server.FindTopDocumentsPage(query, DocumentFilter(), nullopt, document_count).documents,
+                        text_server.FindTopDocumentsPage(query, DocumentFilter(), nullopt, document_count).documents);
+                }), "фразы и NEAR учитывают позиции, с позиционным индексом и без"s);
+        }
+
+        // запросы, отправленные разом, уходят общими пакетами; результат каждого - как у синхронного поиска
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            AsyncSearchServer async_server(search_server, 1ms, 3);
+            vector<future<vector<Document>>> actual_documents;
+            vector<future<vector<Document>>> banned_documents;
+            for (const string& query : queries) {
+                actual_documents.push_back(async_server.FindTopDocuments(query));
+                banned_documents.push_back(async_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            }
+            future<vector<Document>> invalid_documents = async_server.FindTopDocuments("curly --tail"s);
+            bool same_documents = true;
+            for (size_t i = 0; i < queries.size(); ++i) {
+                same_documents = IsSameTop(actual_documents[i].get(), search_server.FindTopDocuments(queries[i])) && same_documents;
+                same_documents = IsSameTop(banned_documents[i].get(), search_server.FindTopDocuments(queries[i], DocumentStatus::BANNED)) && same_documents;
+            }
+            bool invalid_rejected = false;
+            try {
+                invalid_documents.get();
+            }
+            catch (const invalid_argument&) {
+                invalid_rejected = true;
+            }
+            Check(same_documents && invalid_rejected, "AsyncSearchServer = синхронный FindTopDocuments"s);
+        }
+
+        // запросы из нескольких потоков в одну минуту модельного времени считаются все, через 2 часа окно пусто
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            RequestQueue::Clock::time_point simulated_time;
+            RequestQueue request_queue(search_server, 1h, 1min, [&simulated_time] { return simulated_time; });
+            const int thread_count = 4;
+            const int requests_per_thread = 50;
+            vector<thread> threads;
+            for (int i = 0; i < thread_count; ++i) {
+                threads.emplace_back([&request_queue, requests_per_thread] {
+                    for (int j = 0; j < requests_per_thread; ++j) {
+                        request_queue.AddFindRequest(j % 2 == 0 ? "pigeon"s : "unknown"s);
+                    }
+                });
+            }
+            for (thread& request_thread : threads) {
+                request_thread.join();
+            }
+            const RequestStatistics::Snapshot statistics = request_queue.GetStatistics();
+            const int no_result_requests = request_queue.GetNoResultRequests();
+            simulated_time += 2h;
+            request_queue.AddFindRequest("unknown"s);
+            Check(statistics.request_count == thread_count * requests_per_thread
+                && no_result_requests == thread_count * requests_per_thread / 2
+                && request_queue.GetNoResultRequests() == 1 && request_queue.GetStatistics().request_count == 1,
+                "RequestQueue: запросы всех потоков в окне, старые уходят из окна"s);
+        }
+
+        // итог отчета - сумма структур, корзины постингов покрывают все слова, позиции появляются только с индексом
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            const auto find_structure = [](const IndexMemoryReport& report, const string& name) {
+                return find_if(report.structures.begin(), report.structures.end(), [&name](const auto& structure) {
+                    return structure.first == name;
+                })->second.GetTotalBytes();
+            };
+            const auto is_consistent = [](const IndexMemoryReport& report) {
+                size_t structure_bytes = 0;
+                for (const auto& [name, usage] : report.structures) {
+                    structure_bytes += usage.GetTotalBytes();
+                }
+                size_t bucket_term_count = 0;
+                for (const PostingSizeBucket& bucket : report.posting_sizes) {
+                    bucket_term_count += bucket.term_count;
+                }
+                return report.GetTotal().GetTotalBytes() == structure_bytes && bucket_term_count == report.term_count;
+            };
+            const IndexMemoryReport full_report = search_server.GetMemoryReport();
+            search_server.EnablePositionalIndex();
+            const IndexMemoryReport positional_report = search_server.GetMemoryReport();
+            for (int i = document_count / 2; i < document_count; ++i) {
+                search_server.RemoveDocument(i);
+            }
+            const IndexMemoryReport half_report = search_server.GetMemoryReport();
+            Check(is_consistent(full_report) && is_consistent(positional_report) && is_consistent(half_report)
+                && full_report.document_count == static_cast<size_t>(document_count) && full_report.term_count == words.size()
+                && find_structure(full_report, "positional_index"s) == 0 && find_structure(positional_report, "positional_index"s) > 0
+                && half_report.document_count == static_cast<size_t>(document_count / 2)
+                && find_structure(half_report, "documents_data"s) < find_structure(positional_report, "documents_data"s),
+                "GetMemoryReport: итог = сумма структур"s);
+        }
+
+        // узлы из пула: с самого начала и с переносом уже добавленных - тот же индекс, что на malloc
+        {
+            SearchServer heap_server("and with"s);
+            SearchServer pool_server("and with"s);
+            SearchServer moved_server("and with"s);
+            pool_server.SetNodeAllocation(NodeAllocation::POOL);
+            add_documents(heap_server, document_count);
+            add_documents(pool_server, document_count);
+            add_documents(moved_server, document_count);
+            moved_server.SetNodeAllocation(NodeAllocation::POOL);
+            for (SearchServer* server : { &heap_server, &pool_server, &moved_server }) {
+                for (int i = 0; i < document_count; i += 4) {
+                    server->UpdateDocument(i, make_text(i + 2), DocumentStatus::ACTUAL, { i });
+                    server->RemoveDocument(i + 1);
+                }
+            }
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                const vector<Document> heap_documents = heap_server.FindTopDocuments(query);
+                return IsSameTop(pool_server.FindTopDocuments(query), heap_documents) && IsSameTop(moved_server.FindTopDocuments(query), heap_documents);
+            }) && all_of(heap_server.begin(), heap_server.end(), [&](int document_id) {
+                return pool_server.GetWordFrequencies(document_id) == heap_server.GetWordFrequencies(document_id)
+                    && moved_server.GetWordFrequencies(document_id) == heap_server.GetWordFrequencies(document_id);
+            }) && pool_server.GetNodePoolStatistics().arena_count > 0 && moved_server.GetNodePoolStatistics().arena_count > 0,
+                "SetNodeAllocation(POOL) = узлы из malloc"s);
+        }
+
+        // поиск с предикатом принимает и adaptive_execution
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            const auto is_even_rating = [](int, DocumentStatus, int rating) {
+                return rating % 2 == 0;
+            };
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                return IsSameTop(search_server.FindTopDocuments(adaptive_execution, query, is_even_rating),
+                    search_server.FindTopDocuments(execution::seq, query, is_even_rating));
+            }), "FindTopDocuments(adaptive_execution, запрос, предикат) = последовательный"s);
+        }
+
+        // с нулевыми порогами adaptive_execution на многоядерной машине идет параллельными путями, выдача - как у seq
+        {
+            SearchServer ranges_server("and with"s);
+            SearchServer terms_server("and with"s);
+            add_documents(ranges_server, document_count);
+            add_documents(terms_server, document_count);
+            AdaptiveExecutionThresholds thresholds;
+            thresholds.parallel_terms_min_postings = 0;
+            thresholds.parallel_match_min_words = 0;
+            terms_server.SetAdaptiveExecutionThresholds(thresholds);
+            thresholds.document_ranges_min_postings = 0;
+            ranges_server.SetAdaptiveExecutionThresholds(thresholds);
+            const vector<SearchServer*> adaptive_servers = { &ranges_server, &terms_server };
+            for (SearchServer* server : adaptive_servers) {
+                for (int i = 0; i < document_count; i += 9) {
+                    server->RemoveDocument(adaptive_execution, i);
+                }
+            }
+            SearchServer removed_server("and with"s);
+            add_documents(removed_server, document_count);
+            for (int i = 0; i < document_count; i += 9) {
+                removed_server.RemoveDocument(execution::seq, i);
+            }
+            Check(all_of(queries.begin(), queries.end(), [&](const string& query) {
+                return all_of(adaptive_servers.begin(), adaptive_servers.end(), [&](const SearchServer* server) {
+                    return IsSameTop(server->FindTopDocuments(adaptive_execution, query), removed_server.FindTopDocuments(execution::seq, query))
+                        && IsSameTop(server->FindTopDocuments(adaptive_execution, query, DocumentFilter(), Bm25Ranking()),
+                            removed_server.FindTopDocuments(execution::seq, query, DocumentFilter(), Bm25Ranking()))
+                        && server->MatchDocument(adaptive_execution, query, 10) == removed_server.MatchDocument(execution::seq, query, 10);
+                });
+            }), "adaptive_execution = execution::seq"s);
+        }
+
+        // пакет из нескольких групп: общие слова обходятся раз на группу, выдача каждого запроса - как по одному
+        {
+            SearchServer search_server("and with"s);
+            add_documents(search_server, document_count);
+            vector<string> batch_queries;
+            for (int i = 0; i < 600; ++i) {
+                batch_queries.push_back(words[i % 10] + " "s + words[i / 10 % 10] + (i % 3 == 0 ? " -"s + words[i * 3 % 10] : ""s));
+            }
+            const vector<vector<Document>> shared_documents = ProcessQueries(search_server, batch_queries, QueryBatchMode::SHARED_TERMS);
+            bool same_documents = shared_documents.size() == batch_queries.size();
+            for (size_t i = 0; same_documents && i < batch_queries.size(); ++i) {
+                same_documents = IsSameTop(shared_documents[i], search_server.FindTopDocuments(batch_queries[i]));
+            }
+            Check(same_documents, "ProcessQueries(SHARED_TERMS) = FindTopDocuments по одному запросу"s);
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+﻿#include <algorithm>
+
+#include "memory_usage.h"
+
+using namespace std;
+
+size_t MemoryUsage::GetTotalBytes() const {
+    return payload_bytes + overhead_bytes;
+}
+
+void MemoryUsage::AddAllocation(size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    payload_bytes += bytes;
+    overhead_bytes += GetMallocBlockSize(bytes) - bytes;
+    ++allocation_count;
+}
+
+void MemoryUsage::AddString(const string& str) {
+    const char* object_begin = reinterpret_cast<const char*>(&str);
+    if (str.data() >= object_begin && str.data() < object_begin + sizeof(str)) {
+        return;
+    }
+    AddAllocation(str.capacity() + 1);
+}
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) {
+    payload_bytes += other.payload_bytes;
+    overhead_bytes += other.overhead_bytes;
+    allocation_count += other.allocation_count;
+    return *this;
+}
+
+size_t GetMallocBlockSize(size_t bytes) {
+    const size_t MALLOC_HEADER_SIZE = 8;
+    const size_t MALLOC_ALIGNMENT = 16;
+    const size_t MIN_MALLOC_BLOCK_SIZE = 32;
+    const size_t block_size = (bytes + MALLOC_HEADER_SIZE + MALLOC_ALIGNMENT - 1) & ~(MALLOC_ALIGNMENT - 1);
+    return max(block_size, MIN_MALLOC_BLOCK_SIZE);
+}
+
+void MemoryCounter::Allocate(size_t bytes, size_t block_bytes) {
+    payload_bytes_.fetch_add(bytes, memory_order_relaxed);
+    block_bytes_.fetch_add(block_bytes, memory_order_relaxed);
+    allocation_count_.fetch_add(1, memory_order_relaxed);
+}
+
+void MemoryCounter::Deallocate(size_t bytes, size_t block_bytes) {
+    payload_bytes_.fetch_sub(bytes, memory_order_relaxed);
+    block_bytes_.fetch_sub(block_bytes, memory_order_relaxed);
+    allocation_count_.fetch_sub(1, memory_order_relaxed);
+}
+
+MemoryUsage MemoryCounter::GetUsage() const {
+    MemoryUsage usage;
+    usage.payload_bytes = payload_bytes_.load(memory_order_relaxed);
+    usage.overhead_bytes = block_bytes_.load(memory_order_relaxed) - usage.payload_bytes;
+    usage.allocation_count = allocation_count_.load(memory_order_relaxed);
+    return usage;
+}
+
+MemoryUsage GetNodesMemoryUsage(size_t node_count, size_t node_size) {
+    MemoryUsage usage;
+    usage.payload_bytes = node_count * node_size;
+    usage.overhead_bytes = node_count * (GetMallocBlockSize(node_size) - node_size);
+    usage.allocation_count = node_count;
+    return usage;
+}
+
+MemoryUsage IndexMemoryReport::GetTotal() const {
+    MemoryUsage total;
+    for (const auto& [name, usage] : structures) {
+        total += usage;
+    }
+    return total;
+}
+
+double IndexMemoryReport::GetBytesPerDocument() const {
+    return document_count == 0 ? 0.0 : static_cast<double>(GetTotal().GetTotalBytes()) / document_count;
+}
+
+void IndexMemoryReport::AddPostings(size_t document_count, size_t bytes) {
+    size_t bucket = 0;
+    while ((size_t{ 2 } << bucket) <= document_count) {
+        ++bucket;
+    }
+    if (bucket >= posting_sizes.size()) {
+        const size_t old_size = posting_sizes.size();
+        posting_sizes.resize(bucket + 1);
+        for (size_t i = old_size; i < posting_sizes.size(); ++i) {
+            posting_sizes[i].min_document_count = size_t{ 1 } << i;
+        }
+    }
+    ++posting_sizes[bucket].term_count;
+    posting_sizes[bucket].bytes += bytes;
+}
+
+void IndexMemoryReport::PrintJson(const string& name, ostream& out) const {
+    const MemoryUsage total = GetTotal();
+    out << "{\"benchmark\":\""s << name << "\",\"docs\":"s << document_count
+        << ",\"terms\":"s << term_count
+        << ",\"total_bytes\":"s << total.GetTotalBytes()
+        << ",\"overhead_bytes\":"s << total.overhead_bytes
+        << ",\"bytes_per_document\":"s << GetBytesPerDocument()
+        << ",\"structures\":{"s;
+    bool is_first = true;
+    for (const auto& [name, usage] : structures) {
+        out << (is_first ? ""s : ","s) << "\""s << name << "\":{\"payload_bytes\":"s << usage.payload_bytes
+            << ",\"overhead_bytes\":"s << usage.overhead_bytes
+            << ",\"allocations\":"s << usage.allocation_count << "}"s;
+        is_first = false;
+    }
+    out << "},\"posting_sizes\":["s;
+    is_first = true;
+    for (const PostingSizeBucket& bucket : posting_sizes) {
+        if (bucket.term_count == 0) {
+            continue;
+        }
+        out << (is_first ? ""s : ","s) << "{\"min_docs\":"s << bucket.min_document_count
+            << ",\"terms\":"s << bucket.term_count
+            << ",\"bytes\":"s << bucket.bytes << "}"s;
+        is_first = false;
+    }
+    out << "]}"s << endl;
+}
@@ -0,0 +1,218 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "node_pool.h"
+
+/*
+ *
+ * Память, занятая структурой: payload - байты, запрошенные у аллокатора,
+ * overhead - заголовки и выравнивание блоков malloc сверх запрошенного (оценка, см. GetMallocBlockSize).
+ *
+ */
+
+struct MemoryUsage {
+    size_t payload_bytes = 0;
+    size_t overhead_bytes = 0;
+    size_t allocation_count = 0;
+
+    size_t GetTotalBytes() const;
+
+    // один блок из bytes байт, пустой блок не выделяется
+    void AddAllocation(size_t bytes);
+
+    template <typename Value>
+    void AddVector(const std::vector<Value>& values) {
+        AddAllocation(values.capacity() * sizeof(Value));
+    }
+
+    // короткие строки хранятся внутри объекта и памяти не выделяют
+    void AddString(const std::string& str);
+
+    MemoryUsage& operator+=(const MemoryUsage& other);
+};
+
+// размер блока glibc malloc на 64-битной платформе: 8 байт заголовка, выравнивание 16, не меньше 32 байт
+size_t GetMallocBlockSize(size_t bytes);
+
+/*
+ *
+ * Счетчик живых выделений одного контейнера. Обновляется атомарно,
+ * так что контейнеры разных потоков могут делить один счетчик.
+ *
+ */
+
+class MemoryCounter {
+public:
+    // block_bytes - сколько на самом деле занял блок вместе с накладными расходами
+    void Allocate(size_t bytes, size_t block_bytes);
+
+    void Deallocate(size_t bytes, size_t block_bytes);
+
+    MemoryUsage GetUsage() const;
+
+private:
+    std::atomic<size_t> payload_bytes_{ 0 };
+    std::atomic<size_t> block_bytes_{ 0 };
+    std::atomic<size_t> allocation_count_{ 0 };
+};
+
+/*
+ *
+ * Аллокатор, считающий выделения контейнера. Контейнер, созданный по умолчанию, получает свой счетчик,
+ * его узлы и копии аллокатора пишут в тот же счетчик. Копия контейнера получает новый счетчик.
+ * Аллокатор, созданный с пулом, берет блоки из NodePool, иначе - через std::allocator.
+ *
+ */
+
+template <typename Value>
+class CountingAllocator {
+public:
+    using value_type = Value;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    CountingAllocator()
+        : counter_(std::make_shared<MemoryCounter>()) {}
+
+    explicit CountingAllocator(std::shared_ptr<NodePool> pool)
+        : counter_(std::make_shared<MemoryCounter>())
+        , pool_(std::move(pool)) {}
+
+    // перемещение тоже копирует: перемещенный контейнер должен оставаться пригодным для вставки
+    CountingAllocator(const CountingAllocator& other) noexcept = default;
+
+    template <typename Other>
+    CountingAllocator(const CountingAllocator<Other>& other) noexcept
+        : counter_(other.GetCounter())
+        , pool_(other.GetPool()) {}
+
+    Value* allocate(size_t count) {
+        const size_t bytes = count * sizeof(Value);
+        if (IsPooled()) {
+            Value* values = static_cast<Value*>(pool_->Allocate(bytes));
+            counter_->Allocate(bytes, NodePool::GetBlockSize(bytes));
+            return values;
+        }
+        Value* values = std::allocator<Value>().allocate(count);
+        counter_->Allocate(bytes, GetMallocBlockSize(bytes));
+        return values;
+    }
+
+    void deallocate(Value* values, size_t count) noexcept {
+        const size_t bytes = count * sizeof(Value);
+        if (IsPooled()) {
+            counter_->Deallocate(bytes, NodePool::GetBlockSize(bytes));
+            pool_->Deallocate(values, bytes);
+            return;
+        }
+        counter_->Deallocate(bytes, GetMallocBlockSize(bytes));
+        std::allocator<Value>().deallocate(values, count);
+    }
+
+    CountingAllocator select_on_container_copy_construction() const {
+        return pool_ ? CountingAllocator(pool_) : CountingAllocator();
+    }
+
+    const std::shared_ptr<MemoryCounter>& GetCounter() const {
+        return counter_;
+    }
+
+    const std::shared_ptr<NodePool>& GetPool() const {
+        return pool_;
+    }
+
+    MemoryUsage GetUsage() const {
+        return counter_->GetUsage();
+    }
+
+    template <typename Other>
+    bool operator==(const CountingAllocator<Other>& other) const {
+        return counter_ == other.GetCounter();
+    }
+
+    template <typename Other>
+    bool operator!=(const CountingAllocator<Other>& other) const {
+        return counter_ != other.GetCounter();
+    }
+
+private:
+    std::shared_ptr<MemoryCounter> counter_;
+    std::shared_ptr<NodePool> pool_;
+
+    bool IsPooled() const {
+        return pool_ && alignof(Value) <= NodePool::BLOCK_ALIGNMENT;
+    }
+};
+
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+using CountedMap = std::map<Key, Value, Compare, CountingAllocator<std::pair<const Key, Value>>>;
+
+template <typename Key, typename Compare = std::less<Key>>
+using CountedSet = std::set<Key, Compare, CountingAllocator<Key>>;
+
+/*
+ *
+ * Размер узла std::set<Value> / std::map с value_type Value: для контейнеров, тип которых
+ * виден снаружи и не может получить CountingAllocator. Узел один раз выделяется через счетчик.
+ *
+ */
+
+template <typename Value>
+size_t GetTreeNodeSize() {
+    static const size_t node_size = [] {
+        struct AnyOrder {
+            bool operator()(const Value&, const Value&) const {
+                return false;
+            }
+        };
+        std::set<Value, AnyOrder, CountingAllocator<Value>> nodes;
+        nodes.emplace();
+        return nodes.get_allocator().GetUsage().payload_bytes;
+    }();
+    return node_size;
+}
+
+// payload и overhead для node_count узлов по node_size байт
+MemoryUsage GetNodesMemoryUsage(size_t node_count, size_t node_size);
+
+/*
+ *
+ * Распределение размеров постингов: слова, встречающиеся в [min_document_count, 2 * min_document_count) документах,
+ * и память их постингов
+ *
+ */
+
+struct PostingSizeBucket {
+    size_t min_document_count = 0;
+    size_t term_count = 0;
+    size_t bytes = 0;
+};
+
+struct IndexMemoryReport {
+    size_t document_count = 0;
+    size_t term_count = 0;
+    // память по структурам индекса в порядке их перечисления в отчете
+    std::vector<std::pair<std::string, MemoryUsage>> structures;
+    std::vector<PostingSizeBucket> posting_sizes;
+
+    MemoryUsage GetTotal() const;
+
+    double GetBytesPerDocument() const;
+
+    // добавляет слово с document_count документами и bytes байт постингов в posting_sizes
+    void AddPostings(size_t document_count, size_t bytes);
+
+    // одна строка JSON с именем замера name
+    void PrintJson(const std::string& name, std::ostream& out) const;
+};
@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+#include "memory_usage.h"
+#include "node_pool.h"
+
+using namespace std;
+
+namespace {
+
+void* MapAnonymous(size_t size, int extra_flags) {
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    return data == MAP_FAILED ? nullptr : data;
+}
+
+}  // namespace
+
+NodePool::NodePool(NodeAllocation allocation)
+    : allocation_(allocation) {
+    if (allocation == NodeAllocation::HEAP) {
+        throw invalid_argument("Node pool needs a pool allocation mode"s);
+    }
+}
+
+NodePool::~NodePool() {
+    for (const Arena& arena : arenas_) {
+        munmap(arena.data, arena.size);
+    }
+}
+
+void* NodePool::Allocate(size_t bytes) {
+    if (bytes > MAX_POOLED_BLOCK_SIZE) {
+        return ::operator new(bytes);
+    }
+    const size_t block_size = GetBlockSize(bytes);
+    FreeBlock*& free_block = free_blocks_[block_size / BLOCK_ALIGNMENT - 1];
+    used_bytes_ += block_size;
+    if (free_block != nullptr) {
+        FreeBlock* block = free_block;
+        free_block = block->next;
+        return block;
+    }
+    if (static_cast<size_t>(arena_end_ - arena_position_) < block_size) {
+        AddArena();
+    }
+    void* block = arena_position_;
+    arena_position_ += block_size;
+    return block;
+}
+
+void NodePool::Deallocate(void* block, size_t bytes) {
+    if (bytes > MAX_POOLED_BLOCK_SIZE) {
+        ::operator delete(block);
+        return;
+    }
+    const size_t block_size = GetBlockSize(bytes);
+    FreeBlock*& free_block = free_blocks_[block_size / BLOCK_ALIGNMENT - 1];
+    used_bytes_ -= block_size;
+    free_block = new (block) FreeBlock{ free_block };
+}
+
+size_t NodePool::GetBlockSize(size_t bytes) {
+    if (bytes > MAX_POOLED_BLOCK_SIZE) {
+        return GetMallocBlockSize(bytes);
+    }
+    return bytes == 0 ? BLOCK_ALIGNMENT : (bytes + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+NodePoolStatistics NodePool::GetStatistics() const {
+    NodePoolStatistics statistics;
+    statistics.arena_count = arenas_.size();
+    statistics.hugetlb_arena_count = hugetlb_arena_count_;
+    statistics.arena_bytes = arenas_.size() * ARENA_SIZE;
+    statistics.used_bytes = used_bytes_;
+    return statistics;
+}
+
+void NodePool::AddArena() {
+    void* data = nullptr;
+#ifdef MAP_HUGETLB
+    if (allocation_ == NodeAllocation::POOL_HUGETLB) {
+        data = MapAnonymous(ARENA_SIZE, MAP_HUGETLB);
+        if (data != nullptr) {
+            ++hugetlb_arena_count_;
+        }
+    }
+#endif
+    if (data == nullptr && allocation_ == NodeAllocation::POOL) {
+        data = MapAnonymous(ARENA_SIZE, 0);
+    }
+    else if (data == nullptr) {
+        // прозрачные огромные страницы выдаются только выровненным по ARENA_SIZE участкам
+        char* region = static_cast<char*>(MapAnonymous(2 * ARENA_SIZE, 0));
+        if (region != nullptr) {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(region);
+            char* aligned = region + (ARENA_SIZE - address % ARENA_SIZE) % ARENA_SIZE;
+            if (aligned > region) {
+                munmap(region, aligned - region);
+            }
+            munmap(aligned + ARENA_SIZE, region + 2 * ARENA_SIZE - (aligned + ARENA_SIZE));
+            data = aligned;
+#ifdef MADV_HUGEPAGE
+            madvise(data, ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+        }
+    }
+    if (data == nullptr) {
+        throw bad_alloc();
+    }
+    arenas_.push_back({ data, ARENA_SIZE });
+    arena_position_ = static_cast<char*>(data);
+    arena_end_ = arena_position_ + ARENA_SIZE;
+}
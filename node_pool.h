@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/*
+ *
+ * Чем выделяется память узлов контейнеров индекса: обычным malloc или пулом NodePool,
+ * арены которого лежат на обычных страницах, на прозрачных огромных страницах (madvise MADV_HUGEPAGE)
+ * или на явных огромных страницах (MAP_HUGETLB, нужны страницы, зарезервированные в vm.nr_hugepages)
+ *
+ */
+
+enum class NodeAllocation {
+    HEAP,
+    POOL,
+    POOL_TRANSPARENT_HUGE_PAGES,
+    POOL_HUGETLB,
+};
+
+struct NodePoolStatistics {
+    size_t arena_count = 0;
+    // арены, получившие огромные страницы MAP_HUGETLB
+    size_t hugetlb_arena_count = 0;
+    size_t arena_bytes = 0;
+    // занято живыми блоками с округлением до класса размера
+    size_t used_bytes = 0;
+};
+
+/*
+ *
+ * Пул узлов контейнеров. Блоки до MAX_POOLED_BLOCK_SIZE байт округляются до класса, кратного BLOCK_ALIGNMENT,
+ * нарезаются подряд из арен по ARENA_SIZE байт и после освобождения попадают в список свободных блоков своего класса.
+ * Узлы индекса лежат плотно на небольшом числе страниц и не тратят память на заголовки malloc.
+ * Большие блоки выделяются через operator new. Арены возвращаются системе только при уничтожении пула.
+ *
+ * Пул не потокобезопасен: узлы выделяются и освобождаются только изменяющими методами SearchServer,
+ * которые и так нельзя вызывать параллельно.
+ *
+ */
+
+class NodePool {
+public:
+    static const size_t ARENA_SIZE = size_t{ 2 } << 20;
+    // узлам деревьев хватает выравнивания 8: блок 56 байт у malloc занимает 64, в пуле - 56
+    static const size_t BLOCK_ALIGNMENT = 8;
+    static const size_t MAX_POOLED_BLOCK_SIZE = 256;
+
+    // allocation - любой режим, кроме HEAP. Если MAP_HUGETLB недоступен, арены берутся на прозрачных огромных страницах
+    explicit NodePool(NodeAllocation allocation);
+
+    NodePool(const NodePool&) = delete;
+
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool();
+
+    void* Allocate(size_t bytes);
+
+    void Deallocate(void* block, size_t bytes);
+
+    // сколько байт пул отводит под блок из bytes байт
+    static size_t GetBlockSize(size_t bytes);
+
+    NodePoolStatistics GetStatistics() const;
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Arena {
+        void* data;
+        size_t size;
+    };
+
+    NodeAllocation allocation_;
+    std::vector<Arena> arenas_;
+    size_t hugetlb_arena_count_ = 0;
+    char* arena_position_ = nullptr;
+    char* arena_end_ = nullptr;
+    std::array<FreeBlock*, MAX_POOLED_BLOCK_SIZE / BLOCK_ALIGNMENT> free_blocks_{};
+    size_t used_bytes_ = 0;
+
+    void AddArena();
+};
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "memory_usage.h"
+
+/*
+ *
+ * Колонка значений, индексированная id документа.
+ * Память выделяется страницами по мере появления id, поэтому редкие большие id
+ * не раздувают колонку, а чтение значения остается O(1).
+ *
+ */
+
+template <typename Value, size_t PageSize = 4096>
+class PagedColumn {
+public:
+    void Set(int id, Value value) {
+        const size_t page_index = static_cast<size_t>(id) / PageSize;
+        if (page_index >= pages_.size()) {
+            pages_.resize(page_index + 1);
+        }
+        if (!pages_[page_index]) {
+            pages_[page_index] = std::make_unique<Page>();
+        }
+        (*pages_[page_index])[static_cast<size_t>(id) % PageSize] = value;
+    }
+
+    // значение для id должно быть предварительно записано через Set
+    const Value& Get(int id) const {
+        return (*pages_[static_cast<size_t>(id) / PageSize])[static_cast<size_t>(id) % PageSize];
+    }
+
+    MemoryUsage GetMemoryUsage() const {
+        MemoryUsage usage;
+        usage.AddVector(pages_);
+        for (const auto& page : pages_) {
+            if (page) {
+                usage.AddAllocation(sizeof(Page));
+            }
+        }
+        return usage;
+    }
+
+private:
+    using Page = std::array<Value, PageSize>;
+
+    std::vector<std::unique_ptr<Page>> pages_;
+};
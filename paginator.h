@@ -1,8 +1,10 @@
 ﻿#pragma once
 
-#include <iostream>
-#include <vector>
 #include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 template <typename Iterator>
 class IteratorRange {
@@ -18,7 +20,7 @@ public:
     Iterator end() const {
         return last_;
     }
-    Iterator size() const {
+    size_t size() const {
         return size_;
     }
 
@@ -35,46 +37,105 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
     return out;
 }
 
+/*
+ *
+ * Разбиение диапазона на страницы по page_size элементов. Страницы не хранятся: границы страницы
+ * вычисляются при обращении к ней, для итераторов произвольного доступа - за O(1),
+ * так что создание Paginator ничего не копирует и не зависит от размера диапазона.
+ *
+ */
+
 template <typename Iterator>
 class Paginator {
 public:
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
+
+        PageIterator(const Paginator* paginator, size_t page)
+            : paginator_(paginator)
+            , page_(page) {}
+
+        IteratorRange<Iterator> operator*() const {
+            return (*paginator_)[page_];
+        }
+
+        PageIterator& operator++() {
+            ++page_;
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator old = *this;
+            ++page_;
+            return old;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_ == other.page_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return page_ != other.page_;
+        }
+
+    private:
+        const Paginator* paginator_;
+        size_t page_;
+    };
+
     Paginator(Iterator begin, Iterator end, size_t page_size);
 
-    auto begin() const;
+    PageIterator begin() const;
 
-    auto end() const;
+    PageIterator end() const;
 
     size_t size() const;
 
+    // страница с номером page, считая с 0
+    IteratorRange<Iterator> operator[](size_t page) const;
+
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_;
+    size_t item_count_;
+    size_t page_size_;
 };
 
 template <typename Iterator>
-Paginator<Iterator>::Paginator(Iterator begin, Iterator end, size_t page_size) {
-    for (size_t step = distance(begin, end); step > 0;) {
-        const size_t current_page_size = std::min(page_size, step);
-        const Iterator current_page_end = std::next(begin, current_page_size);
-        pages_.push_back({ begin, current_page_end });
-
-        step -= current_page_size;
-        begin = current_page_end;
+Paginator<Iterator>::Paginator(Iterator begin, Iterator end, size_t page_size)
+    : begin_(begin)
+    , item_count_(std::distance(begin, end))
+    , page_size_(page_size) {
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive");
     }
 }
 
 template <typename Iterator>
-auto Paginator<Iterator>::begin() const {
-    return pages_.begin();
+typename Paginator<Iterator>::PageIterator Paginator<Iterator>::begin() const {
+    return { this, 0 };
 }
 
 template <typename Iterator>
-auto Paginator<Iterator>::end() const {
-    return pages_.end();
+typename Paginator<Iterator>::PageIterator Paginator<Iterator>::end() const {
+    return { this, size() };
 }
 
 template <typename Iterator>
 size_t Paginator<Iterator>::size() const {
-    return pages_.size();
+    return (item_count_ + page_size_ - 1) / page_size_;
+}
+
+template <typename Iterator>
+IteratorRange<Iterator> Paginator<Iterator>::operator[](size_t page) const {
+    const size_t first = std::min(page * page_size_, item_count_);
+    const size_t last = std::min(first + page_size_, item_count_);
+    const Iterator page_begin = std::next(begin_, first);
+    return { page_begin, std::next(page_begin, last - first) };
 }
 
 template <typename Container>
@@ -0,0 +1,87 @@
+﻿#include <algorithm>
+#include <cstdlib>
+
+#include "positional_index.h"
+
+using namespace std;
+
+DocumentPositions::DocumentPositions(const vector<vector<int>>& term_positions) {
+    offsets_.reserve(term_positions.size() + 1);
+    for (const vector<int>& positions : term_positions) {
+        offsets_.push_back(static_cast<uint32_t>(data_.size()));
+        int previous = 0;
+        for (const int position : positions) {
+            uint32_t delta = static_cast<uint32_t>(position - previous);
+            previous = position;
+            while (delta >= 0x80) {
+                data_.push_back(static_cast<uint8_t>(delta | 0x80));
+                delta >>= 7;
+            }
+            data_.push_back(static_cast<uint8_t>(delta));
+        }
+    }
+    offsets_.push_back(static_cast<uint32_t>(data_.size()));
+}
+
+vector<int> DocumentPositions::Get(size_t term_index) const {
+    vector<int> positions;
+    int position = 0;
+    for (uint32_t i = offsets_[term_index]; i < offsets_[term_index + 1];) {
+        uint32_t delta = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = data_[i++];
+            delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        position += static_cast<int>(delta);
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+size_t DocumentPositions::GetByteSize() const {
+    return offsets_.size() * sizeof(uint32_t) + data_.size();
+}
+
+MemoryUsage DocumentPositions::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.AddVector(offsets_);
+    usage.AddVector(data_);
+    return usage;
+}
+
+bool HasPhrase(const vector<vector<int>>& term_positions, const vector<int>& offsets) {
+    if (term_positions.empty()) {
+        return false;
+    }
+    for (const int first_position : term_positions[0]) {
+        const int start = first_position - offsets[0];
+        bool matched = true;
+        for (size_t i = 1; i < term_positions.size() && matched; ++i) {
+            matched = binary_search(term_positions[i].begin(), term_positions[i].end(), start + offsets[i]);
+        }
+        if (matched) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HasNear(const vector<int>& lhs, const vector<int>& rhs, int max_distance) {
+    size_t lhs_index = 0;
+    size_t rhs_index = 0;
+    while (lhs_index < lhs.size() && rhs_index < rhs.size()) {
+        if (abs(lhs[lhs_index] - rhs[rhs_index]) <= max_distance) {
+            return true;
+        }
+        if (lhs[lhs_index] < rhs[rhs_index]) {
+            ++lhs_index;
+        }
+        else {
+            ++rhs_index;
+        }
+    }
+    return false;
+}
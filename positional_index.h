@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "memory_usage.h"
+
+/*
+ *
+ * Позиции слов одного документа. Позиции каждого слова хранятся разностями,
+ * закодированными varint, поэтому частые близкие позиции занимают по байту.
+ * i-й список соответствует i-му id в отсортированном массиве id слов документа.
+ *
+ */
+
+class DocumentPositions {
+public:
+    DocumentPositions() = default;
+
+    explicit DocumentPositions(const std::vector<std::vector<int>>& term_positions);
+
+    std::vector<int> Get(size_t term_index) const;
+
+    // сколько байт занимают позиции
+    size_t GetByteSize() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    // начало позиций i-го слова в data_, последний элемент - размер data_
+    std::vector<uint32_t> offsets_;
+    std::vector<uint8_t> data_;
+};
+
+/*
+ *
+ * Есть ли позиция p, для которой i-е слово стоит на позиции p + offsets[i] при всех i
+ *
+ */
+
+bool HasPhrase(const std::vector<std::vector<int>>& term_positions, const std::vector<int>& offsets);
+
+/*
+ *
+ * Есть ли в отсортированных списках позиций пара на расстоянии не больше max_distance
+ *
+ */
+
+bool HasNear(const std::vector<int>& lhs, const std::vector<int>& rhs, int max_distance);
@@ -0,0 +1,333 @@
+﻿#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "posting_list.h"
+
+using namespace std;
+
+namespace {
+
+// во сколько раз больший массив должен превосходить меньший, чтобы выгоднее был галоп
+const size_t GALLOP_SIZE_RATIO = 32;
+// список уплотняется, когда удаленные постинги составляют больше 1/TOMBSTONE_COMPACTION_RATIO его массивов
+const size_t TOMBSTONE_COMPACTION_RATIO = 4;
+
+// совпадение с rhs[rhs_index] не считается, если это удаленный постинг rhs_postings (nullptr - удаленных нет)
+bool IsLiveMatch(const PostingList* rhs_postings, size_t rhs_index) {
+    return rhs_postings == nullptr || !rhs_postings->IsRemoved(rhs_index);
+}
+
+void IntersectScalar(const vector<int>& lhs, size_t lhs_index, const vector<int>& rhs, size_t rhs_index,
+    const PostingList* rhs_postings, vector<int>& result) {
+    while (lhs_index < lhs.size() && rhs_index < rhs.size()) {
+        if (lhs[lhs_index] < rhs[rhs_index]) {
+            ++lhs_index;
+        }
+        else if (rhs[rhs_index] < lhs[lhs_index]) {
+            ++rhs_index;
+        }
+        else {
+            if (IsLiveMatch(rhs_postings, rhs_index)) {
+                result.push_back(lhs[lhs_index]);
+            }
+            ++lhs_index;
+            ++rhs_index;
+        }
+    }
+}
+
+vector<int> IntersectGallop(const vector<int>& small, const vector<int>& large, const PostingList* large_postings) {
+    vector<int> result;
+    size_t position = 0;
+    for (const int document_id : small) {
+        position = GallopLowerBound(large, position, document_id);
+        if (position == large.size()) {
+            break;
+        }
+        if (large[position] == document_id && IsLiveMatch(large_postings, position)) {
+            result.push_back(document_id);
+        }
+    }
+    return result;
+}
+
+vector<int> IntersectMerge(const vector<int>& lhs, const vector<int>& rhs, const PostingList* rhs_postings) {
+    vector<int> result;
+    size_t lhs_index = 0;
+    size_t rhs_index = 0;
+#ifdef __SSE2__
+    // сравниваем блок lhs со всеми циклическими сдвигами блока rhs
+    while (lhs_index + 4 <= lhs.size() && rhs_index + 4 <= rhs.size()) {
+        const __m128i lhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs.data() + lhs_index));
+        const __m128i rhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs.data() + rhs_index));
+        const __m128i equal = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi32(lhs_block, rhs_block),
+                _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(
+                _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(1, 0, 3, 2))),
+                _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(2, 1, 0, 3)))));
+        for (int mask = _mm_movemask_ps(_mm_castsi128_ps(equal)); mask != 0; mask &= mask - 1) {
+            const int document_id = lhs[lhs_index + __builtin_ctz(mask)];
+            if (rhs_postings != nullptr) {
+                // позиция совпадения в блоке rhs нужна только для проверки удаленного постинга
+                size_t match_index = rhs_index;
+                while (rhs[match_index] != document_id) {
+                    ++match_index;
+                }
+                if (rhs_postings->IsRemoved(match_index)) {
+                    continue;
+                }
+            }
+            result.push_back(document_id);
+        }
+
+        const int lhs_max = lhs[lhs_index + 3];
+        const int rhs_max = rhs[rhs_index + 3];
+        if (lhs_max <= rhs_max) {
+            lhs_index += 4;
+        }
+        if (rhs_max <= lhs_max) {
+            rhs_index += 4;
+        }
+    }
+#endif
+    IntersectScalar(lhs, lhs_index, rhs, rhs_index, rhs_postings, result);
+    return result;
+}
+
+// id из ids, у которых есть живой постинг в postings; ids не длиннее живых постингов, поэтому галоп - только по postings
+vector<int> IntersectLivePostings(const vector<int>& ids, const PostingList& postings) {
+    const vector<int>& posting_ids = postings.GetDocumentIds();
+    const PostingList* removed_postings = postings.HasRemoved() ? &postings : nullptr;
+    if (ids.size() * GALLOP_SIZE_RATIO < posting_ids.size()) {
+        return IntersectGallop(ids, posting_ids, removed_postings);
+    }
+    return IntersectMerge(ids, posting_ids, removed_postings);
+}
+
+}  // namespace
+
+void PostingList::Add(int document_id, double term_freq) {
+    if (document_ids_.empty() || document_ids_.back() < document_id) {
+        document_ids_.push_back(document_id);
+        term_freqs_.push_back(term_freq);
+        if (has_impacts_) {
+            impacts_.push_back(QuantizeTermFreq(term_freq));
+        }
+        return;
+    }
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const size_t index = it - document_ids_.begin();
+    if (*it == document_id) {
+        if (IsRemoved(index)) {
+            --removed_count_;
+        }
+        SetPosting(index, document_id, term_freqs_[index] + term_freq);
+        return;
+    }
+    // место удаленного соседа слева занимаем без сдвига
+    if (index > 0 && IsRemoved(index - 1)) {
+        --removed_count_;
+        SetPosting(index - 1, document_id, term_freq);
+        return;
+    }
+    // без удаленных постингов сдвиг хвоста - обычная вставка в vector
+    if (removed_count_ == 0) {
+        document_ids_.insert(it, document_id);
+        term_freqs_.insert(term_freqs_.begin() + index, term_freq);
+        if (has_impacts_) {
+            impacts_.insert(impacts_.begin() + index, QuantizeTermFreq(term_freq));
+        }
+        return;
+    }
+    // иначе сдвигаем постинги вправо только до ближайшего удаленного
+    size_t free_index = index;
+    while (free_index < document_ids_.size() && !IsRemoved(free_index)) {
+        ++free_index;
+    }
+    if (free_index == document_ids_.size()) {
+        document_ids_.push_back(0);
+        term_freqs_.push_back(0.0);
+        if (has_impacts_) {
+            impacts_.push_back(0);
+        }
+    }
+    else {
+        --removed_count_;
+    }
+    move_backward(document_ids_.begin() + index, document_ids_.begin() + free_index, document_ids_.begin() + free_index + 1);
+    move_backward(term_freqs_.begin() + index, term_freqs_.begin() + free_index, term_freqs_.begin() + free_index + 1);
+    if (has_impacts_) {
+        move_backward(impacts_.begin() + index, impacts_.begin() + free_index, impacts_.begin() + free_index + 1);
+    }
+    SetPosting(index, document_id, term_freq);
+}
+
+bool PostingList::Erase(int document_id) {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return false;
+    }
+    const size_t index = it - document_ids_.begin();
+    if (IsRemoved(index)) {
+        return false;
+    }
+    SetPosting(index, document_id, 0.0);
+    ++removed_count_;
+    if (removed_count_ * TOMBSTONE_COMPACTION_RATIO > document_ids_.size()) {
+        Compact();
+    }
+    return true;
+}
+
+bool PostingList::Contains(int document_id) const {
+    return Find(document_id) != nullptr;
+}
+
+const double* PostingList::Find(int document_id) const {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return nullptr;
+    }
+    const size_t index = it - document_ids_.begin();
+    return IsRemoved(index) ? nullptr : &term_freqs_[index];
+}
+
+size_t PostingList::size() const {
+    return document_ids_.size() - removed_count_;
+}
+
+MemoryUsage PostingList::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.AddVector(document_ids_);
+    usage.AddVector(term_freqs_);
+    usage.AddVector(impacts_);
+    return usage;
+}
+
+bool PostingList::empty() const {
+    return size() == 0;
+}
+
+PostingList::Iterator PostingList::begin() const {
+    return { *this, 0 };
+}
+
+PostingList::Iterator PostingList::end() const {
+    return { *this, document_ids_.size() };
+}
+
+const vector<int>& PostingList::GetDocumentIds() const {
+    return document_ids_;
+}
+
+bool PostingList::IsRemoved(size_t index) const {
+    return term_freqs_[index] == 0.0;
+}
+
+bool PostingList::HasRemoved() const {
+    return removed_count_ > 0;
+}
+
+void PostingList::EnableImpacts() {
+    impacts_.resize(term_freqs_.size());
+    transform(term_freqs_.begin(), term_freqs_.end(), impacts_.begin(), [](double term_freq) {
+        return term_freq == 0.0 ? uint8_t{ 0 } : QuantizeTermFreq(term_freq);
+    });
+    has_impacts_ = true;
+}
+
+void PostingList::DisableImpacts() {
+    impacts_.clear();
+    impacts_.shrink_to_fit();
+    has_impacts_ = false;
+}
+
+const uint8_t* PostingList::GetImpacts() const {
+    return has_impacts_ ? impacts_.data() : nullptr;
+}
+
+uint8_t PostingList::QuantizeTermFreq(double term_freq) {
+    return static_cast<uint8_t>(clamp(lround(term_freq * 255.0), 1L, 255L));
+}
+
+void PostingList::SetPosting(size_t index, int document_id, double term_freq) {
+    document_ids_[index] = document_id;
+    term_freqs_[index] = term_freq;
+    if (has_impacts_) {
+        impacts_[index] = term_freq == 0.0 ? 0 : QuantizeTermFreq(term_freq);
+    }
+}
+
+void PostingList::Compact() {
+    size_t size = 0;
+    for (size_t index = 0; index < document_ids_.size(); ++index) {
+        if (IsRemoved(index)) {
+            continue;
+        }
+        document_ids_[size] = document_ids_[index];
+        term_freqs_[size] = term_freqs_[index];
+        if (has_impacts_) {
+            impacts_[size] = impacts_[index];
+        }
+        ++size;
+    }
+    document_ids_.resize(size);
+    term_freqs_.resize(size);
+    if (has_impacts_) {
+        impacts_.resize(size);
+    }
+    removed_count_ = 0;
+}
+
+size_t GallopLowerBound(const vector<int>& ids, size_t from, int target) {
+    size_t step = 1;
+    size_t bound = from;
+    while (bound < ids.size() && ids[bound] < target) {
+        from = bound + 1;
+        bound += step;
+        step *= 2;
+    }
+    const auto last = ids.begin() + min(bound, ids.size());
+    return lower_bound(ids.begin() + from, last, target) - ids.begin();
+}
+
+vector<int> IntersectSortedIds(const vector<int>& lhs, const vector<int>& rhs) {
+    const vector<int>& small = lhs.size() <= rhs.size() ? lhs : rhs;
+    const vector<int>& large = lhs.size() <= rhs.size() ? rhs : lhs;
+    if (small.size() * GALLOP_SIZE_RATIO < large.size()) {
+        return IntersectGallop(small, large, nullptr);
+    }
+    return IntersectMerge(small, large, nullptr);
+}
+
+vector<int> IntersectPostings(vector<const PostingList*> postings) {
+    if (postings.empty()) {
+        return {};
+    }
+    sort(postings.begin(), postings.end(), [](const PostingList* lhs, const PostingList* rhs) {
+        return lhs->size() < rhs->size();
+    });
+
+    // промежуточный результат - только живые id, удаленные постинги следующих списков пропускаются при пересечении
+    const PostingList& first = *postings.front();
+    vector<int> result;
+    if (first.HasRemoved()) {
+        result.reserve(first.size());
+        for (const auto [document_id, term_freq] : first) {
+            result.push_back(document_id);
+        }
+    }
+    else {
+        result = first.GetDocumentIds();
+    }
+    for (size_t i = 1; i < postings.size() && !result.empty(); ++i) {
+        result = IntersectLivePostings(result, *postings[i]);
+    }
+    return result;
+}
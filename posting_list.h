@@ -0,0 +1,157 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+
+/*
+ *
+ * Список постингов слова: id документов по возрастанию и частоты слова в них.
+ * Хранится двумя массивами, чтобы id можно было пересекать поиском
+ * с галопом и SIMD сравнением блоков, не задевая частоты.
+ * Удаленный постинг остается в массивах с частотой 0 (и квантованной частотой 0), пока удаленных
+ * не станет больше 1/TOMBSTONE_COMPACTION_RATIO списка - тогда список уплотняется. Так удаление
+ * и смена статуса стоят O(log n) амортизированно, а вставка не по порядку сдвигает постинги
+ * только до ближайшего удаленного. Итераторы, Find, Contains и size удаленные постинги пропускают.
+ *
+ */
+
+class PostingList {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<int, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        // с первого неудаленного постинга, начиная с index
+        Iterator(const PostingList& postings, size_t index)
+            : postings_(&postings)
+            , index_(index) {
+            SkipRemoved();
+        }
+
+        value_type operator*() const {
+            return { postings_->document_ids_[index_], postings_->term_freqs_[index_] };
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            SkipRemoved();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const PostingList* postings_;
+        size_t index_;
+
+        void SkipRemoved() {
+            while (index_ < postings_->term_freqs_.size() && postings_->term_freqs_[index_] == 0.0) {
+                ++index_;
+            }
+        }
+    };
+
+    // добавляет term_freq к частоте слова в документе document_id
+    void Add(int document_id, double term_freq);
+
+    // помечает постинг удаленным; возвращает false, если документа в списке не было
+    bool Erase(int document_id);
+
+    bool Contains(int document_id) const;
+
+    // частота слова в документе или nullptr, если документа в списке нет
+    const double* Find(int document_id) const;
+
+    // число неудаленных постингов
+    size_t size() const;
+
+    bool empty() const;
+
+    // память id, частот и квантованных частот
+    MemoryUsage GetMemoryUsage() const;
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    // id всех постингов массива, в том числе удаленных (их частота 0, см. IsRemoved)
+    const std::vector<int>& GetDocumentIds() const;
+
+    // удален ли постинг с индексом index в GetDocumentIds
+    bool IsRemoved(size_t index) const;
+
+    // есть ли в массивах удаленные постинги
+    bool HasRemoved() const;
+
+    /*
+     *
+     * Квантованные частоты для целочисленного ранжирования: tf * 255 с округлением, не меньше 1,
+     * по байту на постинг. Пока они включены, Add и Erase поддерживают их вместе с частотами.
+     *
+     */
+
+    void EnableImpacts();
+
+    void DisableImpacts();
+
+    // nullptr, если квантованные частоты выключены; у удаленных постингов - 0
+    const uint8_t* GetImpacts() const;
+
+    static uint8_t QuantizeTermFreq(double term_freq);
+
+private:
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+    bool has_impacts_ = false;
+    std::vector<uint8_t> impacts_;
+    size_t removed_count_ = 0;
+
+    void SetPosting(size_t index, int document_id, double term_freq);
+
+    // удаляет из массивов помеченные постинги
+    void Compact();
+};
+
+/*
+ *
+ * Позиция первого id >= target в отсортированном массиве ids, начиная с from:
+ * шаги удваиваются, пока не перескочат target, затем бинарный поиск.
+ *
+ */
+
+size_t GallopLowerBound(const std::vector<int>& ids, size_t from, int target);
+
+/*
+ *
+ * Пересечение отсортированных массивов id. Если размеры сильно отличаются,
+ * элементы меньшего ищутся в большем галопом, иначе массивы сливаются блоками
+ * по 4 id с SIMD сравнением (SSE2), хвосты - скалярно.
+ *
+ */
+
+std::vector<int> IntersectSortedIds(const std::vector<int>& lhs, const std::vector<int>& rhs);
+
+/*
+ *
+ * AND пересечение списков постингов: начиная с самого короткого,
+ * чтобы промежуточный результат был как можно меньше. Удаленные постинги отбрасываются
+ * при самом пересечении: совпадение с удаленным постингом не попадает в результат.
+ *
+ */
+
+std::vector<int> IntersectPostings(std::vector<const PostingList*> postings);
@@ -1,10 +1,40 @@
+#include <algorithm>
 #include <execution>
+#include <numeric>
 
 #include "process_queries.h"
 
 using namespace std;
 
-vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<std::string>& queries) {
+namespace {
+
+vector<vector<Document>> ProcessQueriesSharedTerms(const SearchServer& search_server, const vector<string>& queries) {
+    vector<vector<Document>> process_queries(queries.size());
+    const size_t group_count = (queries.size() + PROCESS_QUERIES_GROUP_SIZE - 1) / PROCESS_QUERIES_GROUP_SIZE;
+    // поток worker ищет группы worker, worker + workers.size(), ...
+    vector<size_t> workers(min({ PROCESS_QUERIES_MAX_PARALLEL_GROUPS, GetHardwareThreadCount(), group_count }));
+    iota(workers.begin(), workers.end(), size_t{ 0 });
+
+    for_each(execution::par, workers.begin(), workers.end(), [&](size_t worker) {
+        for (size_t group = worker; group < group_count; group += workers.size()) {
+            const size_t begin = group * PROCESS_QUERIES_GROUP_SIZE;
+            const size_t end = min(begin + PROCESS_QUERIES_GROUP_SIZE, queries.size());
+            const vector<string_view> group_queries(queries.begin() + begin, queries.begin() + end);
+            const vector<DocumentFilter> filters(group_queries.size(), DocumentFilter::ByStatus(DocumentStatus::ACTUAL));
+            vector<vector<Document>> group_documents = search_server.FindTopDocumentsBatch(group_queries, filters);
+            move(group_documents.begin(), group_documents.end(), process_queries.begin() + begin);
+        }
+    });
+
+    return process_queries;
+}
+
+}  // namespace
+
+vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<std::string>& queries, QueryBatchMode mode) {
+    if (mode == QueryBatchMode::SHARED_TERMS) {
+        return ProcessQueriesSharedTerms(search_server, queries);
+    }
     vector<vector<Document>> process_queries(queries.size());
 
     transform(execution::par, queries.begin(), queries.end(), process_queries.begin(),
@@ -13,9 +43,9 @@ vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const
     return process_queries;
 }
 
-vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries) {
+vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries, QueryBatchMode mode) {
     vector<Document> documents;
-    for (const auto& local_documents : ProcessQueries(search_server, queries)) {
+    for (const auto& local_documents : ProcessQueries(search_server, queries, mode)) {
         documents.insert(documents.end(), local_documents.begin(), local_documents.end());
     }
     return documents;
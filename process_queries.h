@@ -2,7 +2,22 @@
 
 #include "search_server.h"
 
+// как ProcessQueries ищет запросы пакета
+enum class QueryBatchMode {
+    PER_QUERY,      // каждый запрос отдельно, запросы параллельно
+    SHARED_TERMS,   // группами через FindTopDocumentsBatch: постинги общего слова обходятся раз на группу
+};
+
+// в режиме SHARED_TERMS запросы делятся на группы такого размера, накопители каждой группы ограничены
+// BATCH_DENSE_SCORES_MAX_BYTES
+const size_t PROCESS_QUERIES_GROUP_SIZE = 256;
+// группы ищут параллельно не больше стольких потоков, каждый свои группы по очереди: накопители всех групп
+// вместе занимают не больше PROCESS_QUERIES_MAX_PARALLEL_GROUPS * BATCH_DENSE_SCORES_MAX_BYTES
+const size_t PROCESS_QUERIES_MAX_PARALLEL_GROUPS = 4;
+
 //функция ProcessQueries, распараллеливающая обработку нескольких запросов к поисковой системе
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries,
+    QueryBatchMode mode = QueryBatchMode::PER_QUERY);
 
-std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries,
+    QueryBatchMode mode = QueryBatchMode::PER_QUERY);
\ No newline at end of file
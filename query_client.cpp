@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "query_client.h"
+#include "query_protocol.h"
+
+using namespace std;
+
+namespace {
+
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+}  // namespace
+
+QueryClient::QueryClient(const string& address, uint16_t port) {
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+        throw invalid_argument("Invalid server address "s + address);
+    }
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        ThrowSystemError("socket"s);
+    }
+    if (connect(fd_, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) < 0) {
+        const int error = errno;
+        close(fd_);
+        throw system_error(error, generic_category(), "connect"s);
+    }
+    const int no_delay = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+void QueryClient::SendFindTopDocuments(string_view raw_query, DocumentStatus status) {
+    QueryWriter writer(output_);
+    writer.BeginFrame();
+    writer.WriteUint8(static_cast<uint8_t>(QueryOperation::FIND_TOP_DOCUMENTS));
+    writer.WriteUint8(static_cast<uint8_t>(status));
+    writer.WriteString(raw_query);
+    writer.EndFrame();
+}
+
+void QueryClient::SendMatchDocument(string_view raw_query, int document_id) {
+    QueryWriter writer(output_);
+    writer.BeginFrame();
+    writer.WriteUint8(static_cast<uint8_t>(QueryOperation::MATCH_DOCUMENT));
+    writer.WriteInt32(document_id);
+    writer.WriteString(raw_query);
+    writer.EndFrame();
+}
+
+void QueryClient::SendAddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    QueryWriter writer(output_);
+    writer.BeginFrame();
+    writer.WriteUint8(static_cast<uint8_t>(QueryOperation::ADD_DOCUMENT));
+    writer.WriteInt32(document_id);
+    writer.WriteUint8(static_cast<uint8_t>(status));
+    writer.WriteUint32(static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        writer.WriteInt32(rating);
+    }
+    writer.WriteString(document);
+    writer.EndFrame();
+}
+
+void QueryClient::SendRemoveDocument(int document_id) {
+    QueryWriter writer(output_);
+    writer.BeginFrame();
+    writer.WriteUint8(static_cast<uint8_t>(QueryOperation::REMOVE_DOCUMENT));
+    writer.WriteInt32(document_id);
+    writer.EndFrame();
+}
+
+void QueryClient::Flush() {
+    size_t offset = 0;
+    while (offset < output_.size()) {
+        const ssize_t write_size = send(fd_, output_.data() + offset, output_.size() - offset, MSG_NOSIGNAL);
+        if (write_size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("send"s);
+        }
+        offset += write_size;
+    }
+    output_.clear();
+}
+
+vector<Document> QueryClient::ReceiveDocuments() {
+    QueryReader reader(ReceiveResponse());
+    return reader.ReadDocuments();
+}
+
+tuple<vector<string>, DocumentStatus> QueryClient::ReceiveMatch() {
+    QueryReader reader(ReceiveResponse());
+    const auto status = static_cast<DocumentStatus>(reader.ReadUint8());
+    vector<string> words(reader.ReadUint32());
+    for (string& word : words) {
+        word = string(reader.ReadString());
+    }
+    return { move(words), status };
+}
+
+void QueryClient::ReceiveAcknowledgement() {
+    ReceiveResponse();
+}
+
+vector<Document> QueryClient::FindTopDocuments(string_view raw_query, DocumentStatus status) {
+    SendFindTopDocuments(raw_query, status);
+    return ReceiveDocuments();
+}
+
+string_view QueryClient::ReceiveResponse() {
+    Flush();
+    // прочитанные ответы выбрасываются перед чтением следующего
+    input_.erase(0, input_offset_);
+    input_offset_ = 0;
+    uint32_t frame_size = 0;
+    while (!ReadFrameSize(input_, frame_size)) {
+        const size_t old_size = input_.size();
+        input_.resize(old_size + READ_CHUNK_SIZE);
+        const ssize_t read_size = recv(fd_, input_.data() + old_size, READ_CHUNK_SIZE, 0);
+        input_.resize(old_size + max<ssize_t>(read_size, 0));
+        if (read_size == 0) {
+            throw runtime_error("Query server closed the connection"s);
+        }
+        if (read_size < 0 && errno != EINTR) {
+            ThrowSystemError("recv"s);
+        }
+    }
+    input_offset_ = QUERY_FRAME_HEADER_SIZE + frame_size;
+    QueryReader reader(string_view(input_).substr(QUERY_FRAME_HEADER_SIZE, frame_size));
+    if (static_cast<QueryResult>(reader.ReadUint8()) != QueryResult::OK) {
+        throw runtime_error("Query server error: "s + string(reader.ReadString()));
+    }
+    return string_view(input_).substr(QUERY_FRAME_HEADER_SIZE + 1, frame_size - 1);
+}
+
+QueryLoadResult RunQueryLoad(const QueryLoadConfig& config, const vector<string>& queries) {
+    using Clock = chrono::steady_clock;
+
+    QueryLoadResult result;
+    if (queries.empty() || config.connection_count == 0 || config.request_count == 0) {
+        return result;
+    }
+    const size_t pipeline_depth = max<size_t>(config.pipeline_depth, 1);
+    vector<vector<uint64_t>> latencies(config.connection_count);
+    vector<size_t> results(config.connection_count);
+    vector<exception_ptr> errors(config.connection_count);
+
+    const auto start_time = Clock::now();
+    vector<thread> threads;
+    for (size_t connection = 0; connection < config.connection_count; ++connection) {
+        threads.emplace_back([&, connection] {
+            try {
+                // запросы делятся между соединениями поровну, соединение i берет запросы i, i + n, ...
+                vector<uint64_t>& connection_latencies = latencies[connection];
+                QueryClient client(config.address, config.port);
+                deque<Clock::time_point> send_times;
+                size_t next_request = connection;
+                while (next_request < config.request_count || !send_times.empty()) {
+                    while (next_request < config.request_count && send_times.size() < pipeline_depth) {
+                        client.SendFindTopDocuments(queries[next_request % queries.size()]);
+                        send_times.push_back(Clock::now());
+                        next_request += config.connection_count;
+                    }
+                    results[connection] += client.ReceiveDocuments().size();
+                    connection_latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - send_times.front()).count());
+                    send_times.pop_front();
+                }
+            }
+            catch (...) {
+                errors[connection] = current_exception();
+            }
+        });
+    }
+    for (thread& connection_thread : threads) {
+        connection_thread.join();
+    }
+    result.seconds = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start_time).count() / 1e9;
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    vector<uint64_t> all_latencies;
+    for (size_t connection = 0; connection < config.connection_count; ++connection) {
+        all_latencies.insert(all_latencies.end(), latencies[connection].begin(), latencies[connection].end());
+        result.results += results[connection];
+    }
+    result.requests = all_latencies.size();
+    if (!all_latencies.empty()) {
+        sort(all_latencies.begin(), all_latencies.end());
+        result.p50_ns = all_latencies[(all_latencies.size() - 1) / 2];
+        result.p99_ns = all_latencies[(all_latencies.size() - 1) * 99 / 100];
+    }
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+
+/*
+ *
+ * Блокирующий клиент сервера запросов. Send* только дописывают запрос в буфер, поэтому
+ * несколько запросов можно отправить конвейером: буфер уходит при Flush или перед чтением ответа.
+ * Ответы читаются Receive* в порядке запросов. Ответ сервера об ошибке - исключение runtime_error,
+ * ошибки сокета - system_error.
+ *
+ */
+
+class QueryClient {
+public:
+    QueryClient(const std::string& address, uint16_t port);
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    ~QueryClient();
+
+    void SendFindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    void SendMatchDocument(std::string_view raw_query, int document_id);
+
+    void SendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void SendRemoveDocument(int document_id);
+
+    void Flush();
+
+    std::vector<Document> ReceiveDocuments();
+
+    std::tuple<std::vector<std::string>, DocumentStatus> ReceiveMatch();
+
+    // ответ на AddDocument или RemoveDocument
+    void ReceiveAcknowledgement();
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+private:
+    int fd_ = -1;
+    std::string output_;
+    std::string input_;
+    // начало непрочитанных данных в input_
+    size_t input_offset_ = 0;
+
+    // тело следующего ответа после байта результата OK; string_view действителен до следующего чтения
+    std::string_view ReceiveResponse();
+};
+
+/*
+ *
+ * Нагрузка на сервер запросов: connection_count соединений в своих потоках, в каждом
+ * до pipeline_depth запросов FindTopDocuments в полете. Запросы берутся из queries по кругу,
+ * всего request_count запросов. Задержка запроса - от отправки до получения ответа.
+ *
+ */
+
+struct QueryLoadConfig {
+    std::string address = "127.0.0.1";
+    uint16_t port = 0;
+    size_t connection_count = 4;
+    size_t pipeline_depth = 1;
+    size_t request_count = 1000;
+};
+
+struct QueryLoadResult {
+    size_t requests = 0;
+    // сумма числа найденных документов
+    size_t results = 0;
+    double seconds = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+};
+
+QueryLoadResult RunQueryLoad(const QueryLoadConfig& config, const std::vector<std::string>& queries);
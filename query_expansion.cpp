@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <tuple>
+
+#include "query_expansion.h"
+#include "string_processing.h"
+
+using namespace std;
+
+vector<string_view> QueryExpansion::GetPrefixWords(string_view prefix) const {
+    const auto it = prefix_words.find(prefix);
+    return it != prefix_words.end() ? it->second : vector<string_view>();
+}
+
+vector<pair<string_view, int>> QueryExpansion::GetFuzzyWords(string_view word) const {
+    const auto it = fuzzy_words.find(word);
+    return it != fuzzy_words.end() ? it->second : vector<pair<string_view, int>>();
+}
+
+int GetFuzzyMaxDistance(string_view word, int max_distance) {
+    // длина - в символах, не в байтах
+    const size_t length = CountUtf8Characters(word);
+    return min(max_distance, length < 3 ? 0 : length < 6 ? 1 : 2);
+}
+
+vector<string_view> SelectPrefixExpansion(vector<ExpansionCandidate> candidates) {
+    // слова удаленных документов остаются в словаре, но документов у них уже нет
+    candidates.erase(remove_if(candidates.begin(), candidates.end(), [](const ExpansionCandidate& candidate) {
+        return candidate.document_freq == 0;
+        }), candidates.end());
+    if (candidates.size() > MAX_PREFIX_EXPANSION) {
+        nth_element(candidates.begin(), candidates.begin() + MAX_PREFIX_EXPANSION, candidates.end(),
+            [](const ExpansionCandidate& lhs, const ExpansionCandidate& rhs) {
+                return tie(rhs.document_freq, lhs.word) < tie(lhs.document_freq, rhs.word);
+            });
+        candidates.resize(MAX_PREFIX_EXPANSION);
+    }
+
+    vector<string_view> words;
+    for (const ExpansionCandidate& candidate : candidates) {
+        words.push_back(candidate.word);
+    }
+    return words;
+}
+
+vector<pair<string_view, int>> SelectFuzzyExpansion(vector<ExpansionCandidate> candidates) {
+    candidates.erase(remove_if(candidates.begin(), candidates.end(), [](const ExpansionCandidate& candidate) {
+        return candidate.document_freq == 0;
+        }), candidates.end());
+    sort(candidates.begin(), candidates.end(), [](const ExpansionCandidate& lhs, const ExpansionCandidate& rhs) {
+        return tie(lhs.distance, rhs.document_freq, lhs.word) < tie(rhs.distance, lhs.document_freq, rhs.word);
+        });
+    if (candidates.size() > MAX_FUZZY_EXPANSION) {
+        candidates.resize(MAX_FUZZY_EXPANSION);
+    }
+
+    vector<pair<string_view, int>> words;
+    for (const ExpansionCandidate& candidate : candidates) {
+        words.push_back({ candidate.word, candidate.distance });
+    }
+    return words;
+}
+
+QueryExpansion ExpandQuery(string_view raw_query, int fuzzy_max_distance, const ExpansionDictionary& dictionary) {
+    QueryExpansion expansion;
+    for (string_view word : SplitIntoWords(raw_query)) {
+        // слова фраз разбор запроса не раскрывает
+        if (word.find('"') != word.npos) {
+            continue;
+        }
+        const bool is_plus = !word.empty() && word[0] != '-' && word[0] != '+';
+        if (!word.empty() && !is_plus) {
+            word.remove_prefix(1);
+        }
+        const bool is_prefix = !word.empty() && word.back() == '*';
+        if (is_prefix) {
+            word.remove_suffix(1);
+        }
+        if (word.empty()) {
+            continue;
+        }
+        if (is_prefix) {
+            if (expansion.prefix_words.count(word) == 0) {
+                expansion.prefix_words.emplace(word, SelectPrefixExpansion(dictionary.FindByPrefix(word)));
+            }
+            continue;
+        }
+        if (!is_plus || fuzzy_max_distance <= 0 || expansion.fuzzy_words.count(word) > 0
+            || dictionary.IsStopWord(word) || dictionary.HasWord(word)) {
+            continue;
+        }
+        // короткое слово без похожих слов все равно раскрыто - в пустой список
+        const int max_distance = GetFuzzyMaxDistance(word, fuzzy_max_distance);
+        expansion.fuzzy_words.emplace(word, max_distance == 0 ? vector<pair<string_view, int>>()
+            : SelectFuzzyExpansion(dictionary.FindWithinDistance(LevenshteinAutomaton(word, max_distance))));
+    }
+    return expansion;
+}
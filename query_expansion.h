@@ -0,0 +1,116 @@
+#pragma once
+
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "levenshtein_automaton.h"
+
+// на сколько слов самое большее раскрывается "prefix*" в запросе
+const int MAX_PREFIX_EXPANSION = 64;
+// на сколько похожих слов самое большее заменяется слово с опечаткой
+const int MAX_FUZZY_EXPANSION = 16;
+
+/*
+ *
+ * Раскрытие слов запроса, найденное заранее по словарю: слова для каждого "prefix*"
+ * и похожие слова (с расстояниями) для плюс слов, которых в словаре нет.
+ * ShardedSearchServer раскрывает запрос один раз по словарю всего корпуса и отдает раскрытие всем шардам,
+ * чтобы шарды не раскрывали слова по своим словарям и искали те же слова, что один индекс.
+ *
+ */
+
+struct QueryExpansion {
+    std::map<std::string_view, std::vector<std::string_view>> prefix_words;
+    std::map<std::string_view, std::vector<std::pair<std::string_view, int>>> fuzzy_words;
+
+    // пусто, если слова нет в раскрытии
+    std::vector<std::string_view> GetPrefixWords(std::string_view prefix) const;
+
+    std::vector<std::pair<std::string_view, int>> GetFuzzyWords(std::string_view word) const;
+};
+
+// слово словаря, подходящее для раскрытия: в скольких документах оно есть и расстояние до слова запроса
+struct ExpansionCandidate {
+    std::string_view word;
+    size_t document_freq = 0;
+    int distance = 0;
+};
+
+// расстояние нечеткого поиска для слова: у коротких слов на расстоянии 2 оказывается заметная часть словаря
+int GetFuzzyMaxDistance(std::string_view word, int max_distance);
+
+/*
+ *
+ * Отбор раскрытия из кандидатов: слова без документов отбрасываются, для "prefix*" остаются
+ * MAX_PREFIX_EXPANSION слов с наибольшим числом документов, для слова с опечаткой -
+ * MAX_FUZZY_EXPANSION ближайших, при равном расстоянии - с большим числом документов.
+ * При равенстве выигрывает меньшее слово, поэтому отбор не зависит от порядка кандидатов.
+ *
+ */
+
+std::vector<std::string_view> SelectPrefixExpansion(std::vector<ExpansionCandidate> candidates);
+
+std::vector<std::pair<std::string_view, int>> SelectFuzzyExpansion(std::vector<ExpansionCandidate> candidates);
+
+// словарь, по которому раскрывается запрос: у SearchServer - слова своего индекса, у ShardedSearchServer - всего корпуса
+class ExpansionDictionary {
+public:
+    virtual ~ExpansionDictionary() = default;
+
+    virtual bool IsStopWord(std::string_view word) const = 0;
+
+    // слово есть в словаре, даже если документов с ним уже нет
+    virtual bool HasWord(std::string_view word) const = 0;
+
+    virtual std::vector<ExpansionCandidate> FindByPrefix(std::string_view prefix) const = 0;
+
+    virtual std::vector<ExpansionCandidate> FindWithinDistance(const LevenshteinAutomaton& automaton) const = 0;
+};
+
+/*
+ *
+ * Раскрытие всех слов запроса, которые может раскрыть разбор запроса: "prefix*" (и плюс, и минус)
+ * и плюс слова без "+", которых нет в словаре, если fuzzy_max_distance > 0. Слова фраз не раскрываются.
+ * SearchServer и ShardedSearchServer раскрывают запросы только этой функцией, поэтому
+ * раскрытие по словарю корпуса в шардах совпадает с раскрытием в одном индексе.
+ *
+ */
+
+QueryExpansion ExpandQuery(std::string_view raw_query, int fuzzy_max_distance, const ExpansionDictionary& dictionary);
+
+/*
+ *
+ * Обход отсортированного по слову словаря terms (std::map со string_view-совместимым ключом) автоматом:
+ * function(итератор, расстояние) для каждого принятого слова. Ветки с префиксом, который автомат
+ * уже не примет, пропускаются переходом к GetPrefixSuccessor префикса.
+ *
+ */
+
+template <typename SortedTerms, typename Function>
+void ForEachTermWithinDistance(const LevenshteinAutomaton& automaton, const SortedTerms& terms, Function function) {
+    LevenshteinAutomaton::State state;
+    LevenshteinAutomaton::State next_state;
+    for (auto it = terms.begin(); it != terms.end();) {
+        const std::string_view term = it->first;
+        state = automaton.Start();
+        size_t depth = 0;
+        while (depth < term.size() && automaton.CanMatch(state)) {
+            depth = automaton.Step(state, term, depth, next_state);
+            std::swap(state, next_state);
+        }
+        if (automaton.CanMatch(state)) {
+            if (automaton.IsMatch(state)) {
+                function(it, automaton.GetDistance(state));
+            }
+            ++it;
+            continue;
+        }
+        const std::optional<std::string> successor = GetPrefixSuccessor(term.substr(0, depth));
+        it = successor ? terms.lower_bound(*successor) : std::next(it);
+    }
+}
@@ -0,0 +1,158 @@
+﻿#include <cstring>
+#include <stdexcept>
+
+#include "query_protocol.h"
+
+using namespace std;
+
+static_assert(sizeof(double) == 8, "Protocol encodes double as 8 bytes");
+
+namespace {
+
+// сервер и клиент собираются под little-endian платформы, порядок байт не переставляется
+template <typename Value>
+void StoreValue(char* destination, Value value) {
+    memcpy(destination, &value, sizeof(value));
+}
+
+template <typename Value>
+Value LoadValue(const char* source) {
+    Value value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+QueryWriter::QueryWriter(string& buffer)
+    : buffer_(buffer) {
+}
+
+void QueryWriter::BeginFrame() {
+    frame_start_ = buffer_.size();
+    Extend(QUERY_FRAME_HEADER_SIZE);
+}
+
+void QueryWriter::EndFrame() {
+    const size_t frame_size = buffer_.size() - frame_start_ - QUERY_FRAME_HEADER_SIZE;
+    StoreValue(buffer_.data() + frame_start_, static_cast<uint32_t>(frame_size));
+}
+
+void QueryWriter::WriteUint8(uint8_t value) {
+    StoreValue(Extend(sizeof(value)), value);
+}
+
+void QueryWriter::WriteUint32(uint32_t value) {
+    StoreValue(Extend(sizeof(value)), value);
+}
+
+void QueryWriter::WriteInt32(int32_t value) {
+    StoreValue(Extend(sizeof(value)), value);
+}
+
+void QueryWriter::WriteDouble(double value) {
+    StoreValue(Extend(sizeof(value)), value);
+}
+
+void QueryWriter::WriteString(string_view value) {
+    WriteUint32(static_cast<uint32_t>(value.size()));
+    memcpy(Extend(value.size()), value.data(), value.size());
+}
+
+void QueryWriter::WriteDocuments(const vector<Document>& documents) {
+    char* destination = Extend(sizeof(uint32_t) + documents.size() * ENCODED_DOCUMENT_SIZE);
+    StoreValue(destination, static_cast<uint32_t>(documents.size()));
+    destination += sizeof(uint32_t);
+    for (const Document& document : documents) {
+        StoreValue(destination, static_cast<int32_t>(document.id));
+        StoreValue(destination + sizeof(int32_t), document.relevance);
+        StoreValue(destination + sizeof(int32_t) + sizeof(double), static_cast<int32_t>(document.rating));
+        destination += ENCODED_DOCUMENT_SIZE;
+    }
+}
+
+char* QueryWriter::Extend(size_t size) {
+    const size_t old_size = buffer_.size();
+    buffer_.resize(old_size + size);
+    return buffer_.data() + old_size;
+}
+
+QueryReader::QueryReader(string_view payload)
+    : payload_(payload) {
+}
+
+uint8_t QueryReader::ReadUint8() {
+    return LoadValue<uint8_t>(Take(sizeof(uint8_t)));
+}
+
+uint32_t QueryReader::ReadUint32() {
+    return LoadValue<uint32_t>(Take(sizeof(uint32_t)));
+}
+
+int32_t QueryReader::ReadInt32() {
+    return LoadValue<int32_t>(Take(sizeof(int32_t)));
+}
+
+double QueryReader::ReadDouble() {
+    return LoadValue<double>(Take(sizeof(double)));
+}
+
+string_view QueryReader::ReadString() {
+    const uint32_t size = ReadUint32();
+    return { Take(size), size };
+}
+
+vector<Document> QueryReader::ReadDocuments() {
+    const uint32_t count = ReadUint32();
+    if (count > payload_.size() / ENCODED_DOCUMENT_SIZE) {
+        throw invalid_argument("Truncated documents in query frame"s);
+    }
+    vector<Document> documents;
+    documents.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const int id = ReadInt32();
+        const double relevance = ReadDouble();
+        documents.push_back({ id, relevance, ReadInt32() });
+    }
+    return documents;
+}
+
+vector<int> QueryReader::ReadInt32s() {
+    const uint32_t count = ReadUint32();
+    if (count > payload_.size() / sizeof(int32_t)) {
+        throw invalid_argument("Truncated numbers in query frame"s);
+    }
+    vector<int> values(count);
+    for (int& value : values) {
+        value = ReadInt32();
+    }
+    return values;
+}
+
+bool QueryReader::AtEnd() const {
+    return payload_.empty();
+}
+
+const char* QueryReader::Take(size_t size) {
+    if (size > payload_.size()) {
+        throw invalid_argument("Truncated query frame"s);
+    }
+    const char* data = payload_.data();
+    payload_.remove_prefix(size);
+    return data;
+}
+
+bool ReadFrameSize(string_view data, uint32_t& frame_size) {
+    if (data.size() < QUERY_FRAME_HEADER_SIZE) {
+        return false;
+    }
+    const uint32_t size = LoadValue<uint32_t>(data.data());
+    if (size > MAX_QUERY_FRAME_SIZE) {
+        throw invalid_argument("Query frame is too large"s);
+    }
+    if (data.size() - QUERY_FRAME_HEADER_SIZE < size) {
+        return false;
+    }
+    frame_size = size;
+    return true;
+}
@@ -0,0 +1,125 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+
+/*
+ *
+ * Двоичный протокол сетевого сервера запросов. Каждое сообщение - кадр: длина тела (uint32)
+ * и тело. Числа передаются в порядке байт little-endian, строки - длиной (uint32) и байтами.
+ *
+ * Тело запроса - код операции (uint8) и аргументы:
+ *  FIND_TOP_DOCUMENTS: статус (uint8), запрос;
+ *  MATCH_DOCUMENT: id документа (int32), запрос;
+ *  ADD_DOCUMENT: id (int32), статус (uint8), число рейтингов (uint32), рейтинги (int32), текст;
+ *  REMOVE_DOCUMENT: id (int32).
+ *
+ * Тело ответа - результат (uint8): ERROR и текст ошибки или OK и данные:
+ *  FIND_TOP_DOCUMENTS: число документов (uint32), документы - id (int32), релевантность (double), рейтинг (int32);
+ *  MATCH_DOCUMENT: статус (uint8), число слов (uint32), слова;
+ *  ADD_DOCUMENT, REMOVE_DOCUMENT: без данных.
+ *
+ * Запросы одного соединения можно отправлять не дожидаясь ответов, ответы приходят в порядке запросов.
+ *
+ */
+
+enum class QueryOperation : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    ADD_DOCUMENT = 3,
+    REMOVE_DOCUMENT = 4,
+};
+
+enum class QueryResult : uint8_t {
+    OK = 0,
+    ERROR = 1,
+};
+
+// кадр длиннее считается ошибкой протокола, соединение закрывается
+const uint32_t MAX_QUERY_FRAME_SIZE = 16 * 1024 * 1024;
+const size_t QUERY_FRAME_HEADER_SIZE = sizeof(uint32_t);
+// документ в ответе FIND_TOP_DOCUMENTS
+const size_t ENCODED_DOCUMENT_SIZE = sizeof(int32_t) + sizeof(double) + sizeof(int32_t);
+
+/*
+ *
+ * Запись кадров прямо в буфер отправки соединения: без промежуточных строк и копий результатов.
+ * BeginFrame оставляет место под длину, EndFrame ее заполняет.
+ *
+ */
+
+class QueryWriter {
+public:
+    explicit QueryWriter(std::string& buffer);
+
+    void BeginFrame();
+
+    void EndFrame();
+
+    void WriteUint8(uint8_t value);
+
+    void WriteUint32(uint32_t value);
+
+    void WriteInt32(int32_t value);
+
+    void WriteDouble(double value);
+
+    void WriteString(std::string_view value);
+
+    // число документов и документы одним расширением буфера
+    void WriteDocuments(const std::vector<Document>& documents);
+
+private:
+    std::string& buffer_;
+    size_t frame_start_ = 0;
+
+    char* Extend(size_t size);
+};
+
+/*
+ *
+ * Чтение тела кадра. Выход за конец тела - исключение invalid_argument.
+ * Строки возвращаются string_view на тело кадра.
+ *
+ */
+
+class QueryReader {
+public:
+    explicit QueryReader(std::string_view payload);
+
+    uint8_t ReadUint8();
+
+    uint32_t ReadUint32();
+
+    int32_t ReadInt32();
+
+    double ReadDouble();
+
+    std::string_view ReadString();
+
+    std::vector<Document> ReadDocuments();
+
+    // число (uint32) и сами числа int32
+    std::vector<int> ReadInt32s();
+
+    bool AtEnd() const;
+
+private:
+    std::string_view payload_;
+
+    const char* Take(size_t size);
+};
+
+/*
+ *
+ * true и длина тела первого кадра в frame_size, если кадр пришел в data целиком.
+ * Слишком длинный кадр - исключение invalid_argument.
+ *
+ */
+
+bool ReadFrameSize(std::string_view data, uint32_t& frame_size);
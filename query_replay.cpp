@@ -0,0 +1,305 @@
+﻿#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include "query_replay.h"
+#include "search_benchmark.h"
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+void AppendUtf8(uint32_t code_point, string& out) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | code_point >> 6);
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xE0 | code_point >> 12);
+        out += static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+// строка JSON, начинающаяся с кавычки text[pos]; pos сдвигается за закрывающую кавычку
+string ParseJsonString(string_view text, size_t& pos) {
+    string value;
+    for (++pos; pos < text.size(); ++pos) {
+        const char c = text[pos];
+        if (c == '"') {
+            ++pos;
+            return value;
+        }
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++pos == text.size()) {
+            break;
+        }
+        switch (text[pos]) {
+        case 'n': value += '\n'; break;
+        case 't': value += '\t'; break;
+        case 'r': value += '\r'; break;
+        case 'b': value += '\b'; break;
+        case 'f': value += '\f'; break;
+        case 'u':
+            if (pos + 4 >= text.size()) {
+                throw invalid_argument("Truncated \\u escape in query log"s);
+            }
+            // суррогатные пары не собираются: в запросах они не нужны
+            AppendUtf8(static_cast<uint32_t>(stoul(string(text.substr(pos + 1, 4)), nullptr, 16)), value);
+            pos += 4;
+            break;
+        default: value += text[pos];
+        }
+    }
+    throw invalid_argument("Unterminated string in query log"s);
+}
+
+// значение строкового поля field объекта JSON верхнего уровня
+optional<string> FindJsonStringField(string_view line, string_view field) {
+    size_t pos = 0;
+    int depth = 0;
+    while (pos < line.size()) {
+        const char c = line[pos];
+        if (c == '{' || c == '[') {
+            ++depth;
+            ++pos;
+        }
+        else if (c == '}' || c == ']') {
+            --depth;
+            ++pos;
+        }
+        else if (c == '"') {
+            const string key = ParseJsonString(line, pos);
+            const size_t colon = line.find_first_not_of(" \t", pos);
+            if (depth != 1 || colon == string_view::npos || line[colon] != ':' || key != field) {
+                continue;
+            }
+            const size_t value_pos = line.find_first_not_of(" \t", colon + 1);
+            if (value_pos != string_view::npos && line[value_pos] == '"') {
+                pos = value_pos;
+                return ParseJsonString(line, pos);
+            }
+            pos = colon + 1;
+        }
+        else {
+            ++pos;
+        }
+    }
+    return nullopt;
+}
+
+uint64_t Percentile(const vector<uint64_t>& sorted_latencies, size_t per_mille) {
+    return sorted_latencies.empty() ? 0 : sorted_latencies[(sorted_latencies.size() - 1) * per_mille / 1000];
+}
+
+}  // namespace
+
+void ReplayResult::PrintJson(const string& name, ostream& out) const {
+    out << "{\"benchmark\":\""s << name << "\""s
+        << ",\"requests\":"s << requests
+        << ",\"seconds\":"s << seconds
+        << ",\"offered_rate\":"s << offered_rate
+        << ",\"throughput_ops\":"s << (seconds > 0 ? requests / seconds : 0.0)
+        << ",\"p50_us\":"s << p50_ns / 1000.0
+        << ",\"p99_us\":"s << p99_ns / 1000.0
+        << ",\"p999_us\":"s << p999_ns / 1000.0
+        << ",\"max_us\":"s << max_ns / 1000.0
+        << ",\"result_counts\":["s;
+    for (size_t i = 0; i < result_count_histogram.size(); ++i) {
+        out << (i > 0 ? ","s : ""s) << result_count_histogram[i];
+    }
+    out << "]}"s << endl;
+}
+
+vector<string> ReadQueryLog(istream& input, string_view field) {
+    vector<string> queries;
+    string line;
+    while (getline(input, line)) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos) {
+            continue;
+        }
+        if (line[first] == '{') {
+            if (auto query = FindJsonStringField(line, field)) {
+                queries.push_back(move(*query));
+            }
+            continue;
+        }
+        const size_t last = line.find_last_not_of(" \t\r");
+        queries.push_back(line.substr(first, last - first + 1));
+    }
+    return queries;
+}
+
+ReplayResult RunQueryReplay(const ReplayConfig& config, const vector<string>& queries,
+    const function<size_t(const string&)>& execute) {
+    if (config.requests_per_second <= 0.0 || config.thread_count == 0) {
+        throw invalid_argument("Replay needs a positive rate and at least one thread"s);
+    }
+    ReplayResult result;
+    result.offered_rate = config.requests_per_second;
+    result.result_count_histogram.assign(MAX_RESULT_DOCUMENT_COUNT + 1, 0);
+    if (queries.empty()) {
+        return result;
+    }
+    const size_t request_count = config.request_count > 0 ? config.request_count : queries.size();
+    const chrono::duration<double> interval(1.0 / config.requests_per_second);
+
+    vector<uint64_t> latencies(request_count);
+    vector<uint8_t> result_counts(request_count);
+    atomic<size_t> next_request{ 0 };
+    mutex error_mutex;
+    exception_ptr error;
+
+    const Clock::time_point start_time = Clock::now();
+    vector<thread> threads;
+    for (size_t t = 0; t < config.thread_count; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = next_request.fetch_add(1); i < request_count; i = next_request.fetch_add(1)) {
+                const Clock::time_point scheduled_time = start_time + chrono::duration_cast<Clock::duration>(interval * static_cast<double>(i));
+                this_thread::sleep_until(scheduled_time);
+                try {
+                    const size_t found = execute(queries[i % queries.size()]);
+                    result_counts[i] = static_cast<uint8_t>(min<size_t>(found, MAX_RESULT_DOCUMENT_COUNT));
+                }
+                catch (...) {
+                    lock_guard lock(error_mutex);
+                    if (!error) {
+                        error = current_exception();
+                    }
+                    next_request.store(request_count);
+                }
+                latencies[i] = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - scheduled_time).count();
+            }
+        });
+    }
+    for (thread& replay_thread : threads) {
+        replay_thread.join();
+    }
+    result.seconds = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start_time).count() / 1e9;
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    result.requests = request_count;
+    for (const uint8_t found : result_counts) {
+        ++result.result_count_histogram[found];
+    }
+    sort(latencies.begin(), latencies.end());
+    result.p50_ns = Percentile(latencies, 500);
+    result.p99_ns = Percentile(latencies, 990);
+    result.p999_ns = Percentile(latencies, 999);
+    result.max_ns = latencies.back();
+    return result;
+}
+
+ReplayResult RunQueryReplay(const ReplayConfig& config, const vector<string>& queries, const SearchServer& search_server) {
+    return RunQueryReplay(config, queries, [&search_server](const string& query) {
+        return search_server.FindTopDocuments(query).size();
+    });
+}
+
+ReplayResult RunQueryReplay(const ReplayConfig& config, const vector<string>& queries, RequestQueue& request_queue) {
+    return RunQueryReplay(config, queries, [&request_queue](const string& query) {
+        return request_queue.AddFindRequest(query).size();
+    });
+}
+
+void RunQueryReplayTool(const vector<string>& args, ostream& out) {
+    ReplayConfig config;
+    string log_path;
+    string field = "query"s;
+    string documents_path;
+    string stop_words;
+    string target = "search_server"s;
+    vector<string> corpus_args;
+    for (const string& arg : args) {
+        const auto equal_pos = arg.find('=');
+        const string key = arg.substr(0, equal_pos);
+        const string value = equal_pos == arg.npos ? ""s : arg.substr(equal_pos + 1);
+        if (key == "log"s) {
+            log_path = value;
+        }
+        else if (key == "field"s) {
+            field = value;
+        }
+        else if (key == "rate"s) {
+            config.requests_per_second = stod(value);
+        }
+        else if (key == "threads"s) {
+            config.thread_count = stoull(value);
+        }
+        else if (key == "requests"s) {
+            config.request_count = stoull(value);
+        }
+        else if (key == "target"s) {
+            target = value;
+        }
+        else if (key == "documents"s) {
+            documents_path = value;
+        }
+        else if (key == "stop_words"s) {
+            stop_words = value;
+        }
+        else {
+            corpus_args.push_back(arg);
+        }
+    }
+    if (target != "search_server"s && target != "request_queue"s) {
+        throw invalid_argument("Unknown replay target: "s + target);
+    }
+
+    const BenchmarkConfig corpus_config = ParseBenchmarkConfig(corpus_args);
+    const SyntheticCorpus corpus(documents_path.empty() ? corpus_config : BenchmarkConfig{ 0 });
+    SearchServer search_server(documents_path.empty() ? corpus.GetStopWords() : stop_words);
+    if (documents_path.empty()) {
+        for (const SyntheticDocument& document : corpus.GetDocuments()) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    }
+    else {
+        ifstream documents_file(documents_path);
+        if (!documents_file) {
+            throw invalid_argument("Cannot open documents file "s + documents_path);
+        }
+        string text;
+        for (int id = 0; getline(documents_file, text); ++id) {
+            search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { 0 });
+        }
+    }
+
+    vector<string> queries;
+    if (log_path.empty()) {
+        queries = corpus.GenerateQueries(QueryKind::LONG, corpus_config.query_count, corpus_config.seed + 2);
+    }
+    else {
+        ifstream log_file(log_path);
+        if (!log_file) {
+            throw invalid_argument("Cannot open query log "s + log_path);
+        }
+        queries = ReadQueryLog(log_file, field);
+    }
+
+    ReplayResult result;
+    if (target == "request_queue"s) {
+        RequestQueue request_queue(search_server);
+        result = RunQueryReplay(config, queries, request_queue);
+    }
+    else {
+        result = RunQueryReplay(config, queries, search_server);
+    }
+    result.PrintJson("replay_"s + target, out);
+}
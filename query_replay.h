@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "request_queue.h"
+#include "search_server.h"
+
+/*
+ *
+ * Воспроизведение лога запросов с постоянной частотой поступления (открытая нагрузка).
+ * Запрос i должен начаться в момент start + i / requests_per_second независимо от того,
+ * успели ли выполниться предыдущие, и его задержка считается от этого момента, а не от
+ * фактического начала. Поэтому, если поисковая система не успевает за нагрузкой, очередь
+ * ожидания попадает в задержки, а не прячется замедлением отправки (coordinated omission).
+ *
+ */
+
+struct ReplayConfig {
+    double requests_per_second = 1000.0;
+    // потоков, выполняющих запросы: их должно хватать, чтобы не отставать от расписания
+    size_t thread_count = 4;
+    // 0 - каждый запрос лога один раз, иначе запросы лога берутся по кругу
+    size_t request_count = 0;
+};
+
+struct ReplayResult {
+    size_t requests = 0;
+    double seconds = 0.0;
+    double offered_rate = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+    // result_count_histogram[k] - сколько запросов нашли k документов
+    std::vector<size_t> result_count_histogram;
+
+    // одна строка JSON, как у замеров бенчмарка
+    void PrintJson(const std::string& name, std::ostream& out) const;
+};
+
+/*
+ *
+ * Запросы лога: из строк JSON Lines берется строковое поле field (строки без него пропускаются),
+ * остальные непустые строки считаются текстом запроса.
+ *
+ */
+
+std::vector<std::string> ReadQueryLog(std::istream& input, std::string_view field = "query");
+
+// execute выполняет запрос и возвращает число найденных документов; вызывается из нескольких потоков
+ReplayResult RunQueryReplay(const ReplayConfig& config, const std::vector<std::string>& queries,
+    const std::function<size_t(const std::string&)>& execute);
+
+ReplayResult RunQueryReplay(const ReplayConfig& config, const std::vector<std::string>& queries, const SearchServer& search_server);
+
+ReplayResult RunQueryReplay(const ReplayConfig& config, const std::vector<std::string>& queries, RequestQueue& request_queue);
+
+/*
+ *
+ * Инструмент воспроизведения: аргументы key=value - log (файл лога, без него - запросы синтетического
+ * корпуса), field, rate, threads, requests, target (search_server или request_queue), documents
+ * (файл с текстом документа в каждой строке, без него - синтетический корпус), stop_words
+ * (для documents) и параметры синтетического корпуса, как у бенчмарка.
+ *
+ */
+
+void RunQueryReplayTool(const std::vector<std::string>& args, std::ostream& out);
@@ -0,0 +1,320 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "query_protocol.h"
+#include "query_server.h"
+
+using namespace std;
+
+namespace {
+
+const int MAX_EPOLL_EVENTS = 64;
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+DocumentStatus ReadStatus(QueryReader& reader) {
+    const uint8_t status = reader.ReadUint8();
+    if (status >= DOCUMENT_STATUS_COUNT) {
+        throw invalid_argument("Unknown document status"s);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+}  // namespace
+
+QueryServer::QueryServer(SearchServer& search_server, uint16_t port, const string& address)
+    : search_server_(search_server) {
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+        throw invalid_argument("Invalid server address "s + address);
+    }
+
+    try {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("socket"s);
+        }
+        const int reuse_address = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) < 0) {
+            ThrowSystemError("bind"s);
+        }
+        if (listen(listen_fd_, SOMAXCONN) < 0) {
+            ThrowSystemError("listen"s);
+        }
+        socklen_t address_size = sizeof(socket_address);
+        if (getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&socket_address), &address_size) < 0) {
+            ThrowSystemError("getsockname"s);
+        }
+        port_ = ntohs(socket_address.sin_port);
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || stop_fd_ < 0) {
+            ThrowSystemError("epoll"s);
+        }
+        for (const int fd : { listen_fd_, stop_fd_ }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+                ThrowSystemError("epoll_ctl"s);
+            }
+        }
+    }
+    catch (...) {
+        for (const int fd : { listen_fd_, epoll_fd_, stop_fd_ }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw;
+    }
+}
+
+QueryServer::~QueryServer() {
+    for (const auto& [fd, connection] : connections_) {
+        close(fd);
+    }
+    close(listen_fd_);
+    close(epoll_fd_);
+    close(stop_fd_);
+}
+
+uint16_t QueryServer::GetPort() const {
+    return port_;
+}
+
+void QueryServer::Run() {
+    epoll_event events[MAX_EPOLL_EVENTS];
+    while (true) {
+        const int event_count = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait"s);
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                uint64_t value = 0;
+                [[maybe_unused]] const ssize_t read_size = read(stop_fd_, &value, sizeof(value));
+                return;
+            }
+            if (fd == listen_fd_) {
+                AcceptConnections();
+                continue;
+            }
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+            bool is_open = (events[i].events & EPOLLERR) == 0;
+            if (is_open && (events[i].events & (EPOLLIN | EPOLLHUP)) != 0) {
+                is_open = ReadInput(connection);
+            }
+            if (is_open) {
+                is_open = ServeConnection(connection);
+            }
+            if (is_open) {
+                UpdateEvents(connection);
+            }
+            else {
+                CloseConnection(fd);
+            }
+        }
+    }
+}
+
+void QueryServer::Stop() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t write_size = write(stop_fd_, &value, sizeof(value));
+}
+
+void QueryServer::AcceptConnections() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EAGAIN - очередь принятых соединений пуста, остальные ошибки относятся к одному соединению
+            return;
+        }
+        // ответы маленькие, ждать заполнения пакета нельзя
+        const int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        Connection& connection = connections_[fd];
+        connection.fd = fd;
+        connection.events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection.events;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            CloseConnection(fd);
+        }
+    }
+}
+
+bool QueryServer::ReadInput(Connection& connection) {
+    while (!connection.input_closed) {
+        const size_t old_size = connection.input.size();
+        connection.input.resize(old_size + READ_CHUNK_SIZE);
+        const ssize_t read_size = read(connection.fd, connection.input.data() + old_size, READ_CHUNK_SIZE);
+        connection.input.resize(old_size + max<ssize_t>(read_size, 0));
+        if (read_size == 0) {
+            connection.input_closed = true;
+        }
+        else if (read_size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+    return true;
+}
+
+bool QueryServer::ServeConnection(Connection& connection) {
+    uint32_t frame_size = 0;
+    try {
+        do {
+            ProcessFrames(connection);
+            if (!WriteResponses(connection)) {
+                return false;
+            }
+            // кадры, отложенные из-за неотправленных ответов, можно выполнить, если ответы ушли
+        } while (connection.output.size() - connection.output_offset < MAX_PENDING_OUTPUT_SIZE
+            && ReadFrameSize(connection.input, frame_size));
+    }
+    catch (const invalid_argument&) {
+        // кадр больше допустимого: дальше поток байт не разобрать
+        return false;
+    }
+    return !connection.input_closed || connection.output.size() > connection.output_offset
+        || ReadFrameSize(connection.input, frame_size);
+}
+
+void QueryServer::ProcessFrames(Connection& connection) {
+    string_view data = connection.input;
+    uint32_t frame_size = 0;
+    while (connection.output.size() - connection.output_offset < MAX_PENDING_OUTPUT_SIZE
+        && ReadFrameSize(data, frame_size)) {
+        ProcessRequest(data.substr(QUERY_FRAME_HEADER_SIZE, frame_size), connection.output);
+        data.remove_prefix(QUERY_FRAME_HEADER_SIZE + frame_size);
+    }
+    connection.input.erase(0, connection.input.size() - data.size());
+}
+
+bool QueryServer::WriteResponses(Connection& connection) {
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t write_size = send(connection.fd, connection.output.data() + connection.output_offset,
+            connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (write_size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            return false;
+        }
+        connection.output_offset += write_size;
+    }
+    connection.output.clear();
+    connection.output_offset = 0;
+    return true;
+}
+
+void QueryServer::UpdateEvents(Connection& connection) {
+    const size_t pending_output = connection.output.size() - connection.output_offset;
+    uint32_t events = 0;
+    if (pending_output < MAX_PENDING_OUTPUT_SIZE && !connection.input_closed) {
+        events |= EPOLLIN;
+    }
+    if (pending_output > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == connection.events) {
+        return;
+    }
+    connection.events = events;
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = connection.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryServer::CloseConnection(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+
+void QueryServer::ProcessRequest(string_view payload, string& output) {
+    QueryWriter writer(output);
+    writer.BeginFrame();
+    const size_t result_offset = output.size();
+    try {
+        QueryReader reader(payload);
+        const auto operation = static_cast<QueryOperation>(reader.ReadUint8());
+        switch (operation) {
+        case QueryOperation::FIND_TOP_DOCUMENTS: {
+            const DocumentStatus status = ReadStatus(reader);
+            const vector<Document> documents = search_server_.FindTopDocuments(reader.ReadString(), status);
+            writer.WriteUint8(static_cast<uint8_t>(QueryResult::OK));
+            writer.WriteDocuments(documents);
+            break;
+        }
+        case QueryOperation::MATCH_DOCUMENT: {
+            const int document_id = reader.ReadInt32();
+            const auto [words, status] = search_server_.MatchDocument(reader.ReadString(), document_id);
+            writer.WriteUint8(static_cast<uint8_t>(QueryResult::OK));
+            writer.WriteUint8(static_cast<uint8_t>(status));
+            writer.WriteUint32(static_cast<uint32_t>(words.size()));
+            for (const string_view word : words) {
+                writer.WriteString(word);
+            }
+            break;
+        }
+        case QueryOperation::ADD_DOCUMENT: {
+            const int document_id = reader.ReadInt32();
+            const DocumentStatus status = ReadStatus(reader);
+            const vector<int> ratings = reader.ReadInt32s();
+            search_server_.AddDocument(document_id, reader.ReadString(), status, ratings);
+            writer.WriteUint8(static_cast<uint8_t>(QueryResult::OK));
+            break;
+        }
+        case QueryOperation::REMOVE_DOCUMENT:
+            search_server_.RemoveDocument(reader.ReadInt32());
+            writer.WriteUint8(static_cast<uint8_t>(QueryResult::OK));
+            break;
+        default:
+            throw invalid_argument("Unknown query operation"s);
+        }
+    }
+    catch (const exception& error) {
+        // ответ об ошибке заменяет начатый ответ, соединение продолжает работать
+        output.resize(result_offset);
+        writer.WriteUint8(static_cast<uint8_t>(QueryResult::ERROR));
+        writer.WriteString(error.what());
+    }
+    writer.EndFrame();
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "search_server.h"
+
+/*
+ *
+ * Сетевой сервер запросов к SearchServer по протоколу из query_protocol.h.
+ * Один поток обслуживает все соединения через epoll: сокеты неблокирующие, из соединения
+ * читается все, что пришло, разбираются все целые кадры (запросы конвейером), ответы копятся
+ * в буфере отправки соединения и уходят, как только сокет готов к записи. Запросы выполняются
+ * в этом же потоке по очереди, поэтому AddDocument и RemoveDocument не пересекаются с поиском.
+ * Пока ответы соединения не отправлены и их больше MAX_PENDING_OUTPUT_SIZE, новые запросы
+ * из него не читаются.
+ *
+ * Ошибки создания сокетов - исключение system_error.
+ *
+ */
+
+class QueryServer {
+public:
+    static const size_t MAX_PENDING_OUTPUT_SIZE = 4 * 1024 * 1024;
+
+    // слушает address:port, port 0 - любой свободный порт
+    QueryServer(SearchServer& search_server, uint16_t port, const std::string& address = "127.0.0.1");
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer();
+
+    uint16_t GetPort() const;
+
+    // обслуживает соединения, пока не вызван Stop
+    void Run();
+
+    // можно вызывать из любого потока
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        // сколько байт output уже отправлено
+        size_t output_offset = 0;
+        uint32_t events = 0;
+        // клиент закрыл свою сторону: соединение закрывается, когда уйдут ответы на все пришедшие запросы
+        bool input_closed = false;
+    };
+
+    SearchServer& search_server_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    // eventfd, запись в который будит Run для остановки
+    int stop_fd_ = -1;
+    uint16_t port_ = 0;
+    std::unordered_map<int, Connection> connections_;
+
+    void AcceptConnections();
+
+    // читает из сокета все, что пришло; false - ошибка соединения
+    bool ReadInput(Connection& connection);
+
+    // выполняет пришедшие запросы и отправляет ответы; false - соединение нужно закрыть
+    bool ServeConnection(Connection& connection);
+
+    // выполняет целые кадры из input, пока неотправленных ответов меньше MAX_PENDING_OUTPUT_SIZE
+    void ProcessFrames(Connection& connection);
+
+    bool WriteResponses(Connection& connection);
+
+    void UpdateEvents(Connection& connection);
+
+    void CloseConnection(int fd);
+
+    void ProcessRequest(std::string_view payload, std::string& output);
+};
@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <string_view>
+
+/*
+ *
+ * Функции ранжирования - параметр шаблона поиска, поэтому вызов Score во внутреннем цикле
+ * обхода постингов подставляется при компиляции, без виртуальных вызовов.
+ *
+ * Ранжирование должно предоставить:
+ *  USES_DOCUMENT_LENGTH - нужна ли длина документа (иначе она не читается и передается 0);
+ *  ComputeTermWeight(document_freq, statistics) - вес слова, не зависящий от документа;
+ *  Score(term_weight, term_freq, document_length, statistics) - вклад слова в релевантность документа,
+ *      term_freq - доля слова среди слов документа (без стоп слов);
+ *  ComputeUpperBound(term_weight, max_term_freq, max_term_count) - вклад слова, больше которого
+ *      не бывает ни в одном документе (для отсечения документов, не попадающих в топ).
+ *
+ */
+
+struct RankingStatistics {
+    int document_count = 0;
+    double average_document_length = 0.0;
+};
+
+/*
+ *
+ * Статистика корпуса, по которой считаются веса слов. Если документы разложены по нескольким
+ * поисковым системам (шардам), общая статистика дает тот же вес слова, что и в одном индексе.
+ *
+ */
+
+class CorpusStatistics {
+public:
+    virtual ~CorpusStatistics() = default;
+
+    virtual RankingStatistics GetRankingStatistics() const = 0;
+
+    // в скольких документах корпуса встречается слово
+    virtual size_t GetDocumentFreq(std::string_view word) const = 0;
+};
+
+// TF-IDF: доля слова в документе на логарифм обратной частоты документов
+class TfIdfRanking {
+public:
+    static constexpr bool USES_DOCUMENT_LENGTH = false;
+
+    double ComputeTermWeight(size_t document_freq, const RankingStatistics& statistics) const {
+        return std::log(statistics.document_count * 1.0 / document_freq);
+    }
+
+    double Score(double term_weight, double term_freq, int, const RankingStatistics&) const {
+        return term_freq * term_weight;
+    }
+
+    double ComputeUpperBound(double term_weight, double max_term_freq, int) const {
+        return max_term_freq * term_weight;
+    }
+};
+
+/*
+ *
+ * Okapi BM25: число вхождений слова насыщается (параметр k1),
+ * длинные по сравнению со средним документы штрафуются (параметр b)
+ *
+ */
+
+class Bm25Ranking {
+public:
+    static constexpr bool USES_DOCUMENT_LENGTH = true;
+
+    explicit Bm25Ranking(double k1 = 1.2, double b = 0.75)
+        : k1_(k1)
+        , b_(b) {
+    }
+
+    double ComputeTermWeight(size_t document_freq, const RankingStatistics& statistics) const {
+        return std::log(1.0 + (statistics.document_count - static_cast<double>(document_freq) + 0.5) / (document_freq + 0.5));
+    }
+
+    double Score(double term_weight, double term_freq, int document_length, const RankingStatistics& statistics) const {
+        const double term_count = term_freq * document_length;
+        const double length_norm = 1.0 - b_ + b_ * document_length / statistics.average_document_length;
+        return term_weight * term_count * (k1_ + 1.0) / (term_count + k1_ * length_norm);
+    }
+
+    double ComputeUpperBound(double term_weight, double, int max_term_count) const {
+        // знаменатель не меньше term_count + k1 * (1 - b) при любой длине документа
+        return term_weight * max_term_count * (k1_ + 1.0) / (max_term_count + k1_ * (1.0 - b_));
+    }
+
+private:
+    double k1_;
+    double b_;
+};
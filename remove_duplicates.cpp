@@ -11,8 +11,8 @@ void RemoveDuplicates(SearchServer& search_server) {
 
     for (auto i = search_server.begin(); i != search_server.end(); ++i) {
         for (auto j = next(i, 1); j != search_server.end(); ++j) {
-            const map<string_view, double>& words_from_first_document = search_server.GetWordFrequencies(*i);
-            const map<string_view, double>& words_from_second_document = search_server.GetWordFrequencies(*j);
+            const SearchServer::WordFrequencies& words_from_first_document = search_server.GetWordFrequencies(*i);
+            const SearchServer::WordFrequencies& words_from_second_document = search_server.GetWordFrequencies(*j);
 
             if (words_from_first_document.size() != words_from_second_document.size()) {
                 continue;
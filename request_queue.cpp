@@ -2,42 +2,37 @@
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+RequestQueue::RequestQueue(const SearchServer& search_server, Clock::duration window, Clock::duration resolution,
+    TimeSource time_source)
     : search_server_(search_server)
-    , no_search_result_(0)
-    , current_time_(0) {
+    , time_source_(move(time_source))
+    , statistics_(window, resolution) {
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
+    const auto start_time = Clock::now();
     auto found_result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(found_result.size());
+    AddRequest(found_result.size(), start_time);
     return found_result;
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
+    const auto start_time = Clock::now();
     auto found_result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(found_result.size());
+    AddRequest(found_result.size(), start_time);
     return found_result;
 }
 
 /*отвечает на вопрос : сколько за последние сутки было запросов, на которые ничего не нашлось ?*/
 int RequestQueue::GetNoResultRequests() const {
-    return no_search_result_;
+    return static_cast<int>(GetStatistics().no_result_count);
 }
 
-void RequestQueue::AddRequest(size_t result) {
-    ++current_time_;
-    /*хитроумный цикл: будет удалять старые результаты, когда наступят новые сутки, то есть > 1440 сек*/
-    while (!requests_.empty() && sec_in_day_ <= current_time_ - requests_.front().time_step) {
-        /*отвечает на вопрос: сколько за последние сутки было запросов, на которые ничего не нашлось? в данном случае в текущий день*/
-        if (requests_.front().result == 0) {
-            --no_search_result_;
-        }
-        requests_.pop_front();
-    }
-    // сохраняем новый результат поиска
-    requests_.push_back({ current_time_, result });
-    if (result == 0) {
-        ++no_search_result_;
-    }
+RequestStatistics::Snapshot RequestQueue::GetStatistics() const {
+    return statistics_.GetSnapshot(time_source_());
+}
+
+void RequestQueue::AddRequest(size_t result, Clock::time_point start_time) {
+    // задержка - всегда реальное время поиска, даже если время запросов моделируется
+    statistics_.Record(time_source_(), result, Clock::now() - start_time);
 }
\ No newline at end of file
@@ -1,12 +1,28 @@
 ﻿#pragma once
 
-#include <deque>				
+#include <chrono>
+#include <functional>
 
+#include "request_statistics.h"
 #include "search_server.h"
 
+/*
+ *
+ * Поиск через RequestQueue дополнительно учитывается в статистике за скользящее окно
+ * (по умолчанию сутки с шагом в минуту): сколько было запросов, сколько из них ничего не нашли
+ * и как долго они выполнялись. AddFindRequest можно вызывать из нескольких потоков одновременно,
+ * учет запроса не берет блокировок. Время запросов берется из time_source (по умолчанию steady_clock),
+ * ее можно подменить, например, чтобы моделировать время в тестах.
+ *
+ */
+
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server_);
+    using Clock = RequestStatistics::Clock;
+    using TimeSource = std::function<Clock::time_point()>;
+
+    explicit RequestQueue(const SearchServer& search_server_, Clock::duration window = std::chrono::hours(24),
+        Clock::duration resolution = std::chrono::minutes(1), TimeSource time_source = Clock::now);
 
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     template <typename DocumentPredicate>
@@ -19,26 +35,21 @@ public:
     /*отвечает на вопрос : сколько за последние сутки было запросов, на которые ничего не нашлось ?*/
     int GetNoResultRequests() const;
 
+    // число запросов, их частота, доля запросов без результатов и процентили задержки за окно
+    RequestStatistics::Snapshot GetStatistics() const;
+
 private:
-    /*структура для того, чтобы хранить в деке данные: 1 - в какое время был сделан запрос
-                                                       2 - результат нахождения запроса(пустой или не пустой)*/
-    struct QueryResult {
-        uint64_t time_step;
-        size_t result;
-    };
-    std::deque<QueryResult> requests_;
-    const static int sec_in_day_ = 1440;
     const SearchServer& search_server_;
-    int no_search_result_;                  //переменная для счета не найденных результатов
-    uint64_t current_time_;
-
+    const TimeSource time_source_;
+    RequestStatistics statistics_;
 
-    void AddRequest(size_t result);
+    void AddRequest(size_t result, Clock::time_point start_time);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document>RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const auto start_time = Clock::now();
     auto found_result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(found_result.size());
+    AddRequest(found_result.size(), start_time);
     return found_result;
 }
\ No newline at end of file
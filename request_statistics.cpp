@@ -0,0 +1,157 @@
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "request_statistics.h"
+
+using namespace std;
+
+namespace {
+
+atomic<uint64_t> next_instance_id{ 0 };
+
+size_t GetLatencyBucket(uint64_t latency_ns) {
+    if (latency_ns < 2) {
+        return latency_ns;
+    }
+    const size_t power = 63 - __builtin_clzll(latency_ns);
+    const size_t half = latency_ns >> (power - 1) & 1;
+    return min(2 * power + half, RequestStatistics::LATENCY_BUCKET_COUNT - 1);
+}
+
+// наименьшая задержка корзины bucket
+uint64_t GetLatencyBucketStart(size_t bucket) {
+    if (bucket < 2) {
+        return bucket;
+    }
+    const size_t power = bucket / 2;
+    return (uint64_t{ 1 } << power) + (bucket % 2) * (uint64_t{ 1 } << (power - 1));
+}
+
+uint64_t GetPercentile(const vector<uint64_t>& latency_buckets, uint64_t count, size_t per_mille) {
+    if (count == 0) {
+        return 0;
+    }
+    // номер запроса процентиля, считая с 1
+    const uint64_t rank = max<uint64_t>(1, (count * per_mille + 999) / 1000);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < latency_buckets.size(); ++bucket) {
+        seen += latency_buckets[bucket];
+        if (seen >= rank) {
+            return GetLatencyBucketStart(bucket + 1);
+        }
+    }
+    return GetLatencyBucketStart(latency_buckets.size());
+}
+
+}  // namespace
+
+RequestStatistics::RequestStatistics(Clock::duration window, Clock::duration resolution)
+    : window_(window)
+    , resolution_(resolution)
+    , slot_count_(resolution > Clock::duration::zero() ? static_cast<size_t>(window / resolution) : 0)
+    , instance_id_(next_instance_id.fetch_add(1)) {
+    if (slot_count_ == 0 || window % resolution != Clock::duration::zero()) {
+        throw invalid_argument("Statistics window must be a positive multiple of resolution"s);
+    }
+}
+
+RequestStatistics::~RequestStatistics() {
+    for (ThreadSlots* thread_slots = thread_slots_.load(); thread_slots != nullptr;) {
+        ThreadSlots* next = thread_slots->next;
+        delete thread_slots;
+        thread_slots = next;
+    }
+}
+
+void RequestStatistics::Record(Clock::time_point time, size_t result_count, Clock::duration latency) {
+    const int64_t period = GetPeriod(time);
+    Slot& slot = GetThreadSlots().slots[static_cast<size_t>(period) % slot_count_];
+    // в слот пишет только этот поток, поэтому хватает отдельных чтения и записи без атомарного сложения
+    const auto increment = [](atomic<uint32_t>& counter) {
+        counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    };
+    if (slot.period.load(memory_order_relaxed) != period) {
+        // пока слот сбрасывается, читатели его пропускают
+        slot.period.store(-1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        slot.request_count.store(0, memory_order_relaxed);
+        slot.no_result_count.store(0, memory_order_relaxed);
+        for (atomic<uint32_t>& bucket : slot.latency_buckets) {
+            bucket.store(0, memory_order_relaxed);
+        }
+        slot.period.store(period, memory_order_release);
+    }
+    increment(slot.request_count);
+    if (result_count == 0) {
+        increment(slot.no_result_count);
+    }
+    const auto latency_ns = chrono::duration_cast<chrono::nanoseconds>(latency).count();
+    increment(slot.latency_buckets[GetLatencyBucket(static_cast<uint64_t>(max<int64_t>(latency_ns, 0)))]);
+}
+
+RequestStatistics::Snapshot RequestStatistics::GetSnapshot(Clock::time_point now) const {
+    const int64_t last_period = GetPeriod(now);
+    const int64_t first_period = last_period - static_cast<int64_t>(slot_count_) + 1;
+    Snapshot snapshot;
+    vector<uint64_t> latency_buckets(LATENCY_BUCKET_COUNT);
+    vector<uint32_t> slot_buckets(LATENCY_BUCKET_COUNT);
+    for (const ThreadSlots* thread_slots = thread_slots_.load(memory_order_acquire); thread_slots != nullptr;
+        thread_slots = thread_slots->next) {
+        for (size_t i = 0; i < slot_count_; ++i) {
+            const Slot& slot = thread_slots->slots[i];
+            const int64_t period = slot.period.load(memory_order_acquire);
+            if (period < first_period || period > last_period) {
+                continue;
+            }
+            const uint32_t request_count = slot.request_count.load(memory_order_relaxed);
+            const uint32_t no_result_count = slot.no_result_count.load(memory_order_relaxed);
+            for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+                slot_buckets[bucket] = slot.latency_buckets[bucket].load(memory_order_relaxed);
+            }
+            atomic_thread_fence(memory_order_acquire);
+            // слот перешел на другой период, пока его читали
+            if (slot.period.load(memory_order_relaxed) != period) {
+                continue;
+            }
+            snapshot.request_count += request_count;
+            snapshot.no_result_count += no_result_count;
+            for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+                latency_buckets[bucket] += slot_buckets[bucket];
+            }
+        }
+    }
+
+    const double window_seconds = chrono::duration<double>(window_).count();
+    snapshot.request_rate = snapshot.request_count / window_seconds;
+    snapshot.no_result_rate = snapshot.request_count > 0 ? snapshot.no_result_count * 1.0 / snapshot.request_count : 0.0;
+    snapshot.p50_ns = GetPercentile(latency_buckets, snapshot.request_count, 500);
+    snapshot.p99_ns = GetPercentile(latency_buckets, snapshot.request_count, 990);
+    snapshot.p999_ns = GetPercentile(latency_buckets, snapshot.request_count, 999);
+    return snapshot;
+}
+
+RequestStatistics::ThreadSlots& RequestStatistics::GetThreadSlots() {
+    // кольцо потока для последнего экземпляра проверяется без поиска
+    thread_local uint64_t cached_instance_id = UINT64_MAX;
+    thread_local ThreadSlots* cached_slots = nullptr;
+    thread_local unordered_map<uint64_t, ThreadSlots*> instance_slots;
+    if (cached_instance_id == instance_id_) {
+        return *cached_slots;
+    }
+    ThreadSlots*& thread_slots = instance_slots[instance_id_];
+    if (thread_slots == nullptr) {
+        thread_slots = new ThreadSlots;
+        thread_slots->slots = make_unique<Slot[]>(slot_count_);
+        thread_slots->next = thread_slots_.load(memory_order_relaxed);
+        while (!thread_slots_.compare_exchange_weak(thread_slots->next, thread_slots, memory_order_release, memory_order_relaxed)) {
+        }
+    }
+    cached_instance_id = instance_id_;
+    cached_slots = thread_slots;
+    return *thread_slots;
+}
+
+int64_t RequestStatistics::GetPeriod(Clock::time_point time) const {
+    return time.time_since_epoch() / resolution_;
+}
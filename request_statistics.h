@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/*
+ *
+ * Статистика запросов за скользящее окно времени: число запросов, доля запросов без результатов
+ * и распределение задержек. Окно - кольцо слотов по resolution, в окне window / resolution слотов.
+ *
+ * Каждый поток пишет только в свое кольцо слотов, поэтому запись - несколько атомарных
+ * записей без блокировок и без общих для потоков кэш линий. Чтение складывает кольца всех потоков;
+ * слот, который поток в этот момент переводит на новый период, пропускается.
+ *
+ */
+
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // задержки копятся в гистограмме с 2 корзинами на каждую степень двойки наносекунд
+    static const size_t LATENCY_BUCKET_COUNT = 80;
+
+    struct Snapshot {
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        // запросов в секунду в среднем за окно
+        double request_rate = 0.0;
+        double no_result_rate = 0.0;
+        // верхние границы корзин гистограммы, в которые попал процентиль
+        uint64_t p50_ns = 0;
+        uint64_t p99_ns = 0;
+        uint64_t p999_ns = 0;
+    };
+
+    RequestStatistics(Clock::duration window, Clock::duration resolution);
+
+    RequestStatistics(const RequestStatistics&) = delete;
+    RequestStatistics& operator=(const RequestStatistics&) = delete;
+
+    ~RequestStatistics();
+
+    // запрос, завершившийся в момент time
+    void Record(Clock::time_point time, size_t result_count, Clock::duration latency);
+
+    // запросы с моментами из (now - window, now]
+    Snapshot GetSnapshot(Clock::time_point now) const;
+
+private:
+    struct Slot {
+        // номер периода resolution, который сейчас считает слот, -1 - слот сбрасывается
+        std::atomic<int64_t> period{ -1 };
+        std::atomic<uint32_t> request_count{ 0 };
+        std::atomic<uint32_t> no_result_count{ 0 };
+        std::array<std::atomic<uint32_t>, LATENCY_BUCKET_COUNT> latency_buckets{};
+    };
+
+    struct ThreadSlots {
+        std::unique_ptr<Slot[]> slots;
+        ThreadSlots* next = nullptr;
+    };
+
+    const Clock::duration window_;
+    const Clock::duration resolution_;
+    const size_t slot_count_;
+    // различает экземпляры в кэше колец потока: адрес может достаться новому экземпляру
+    const uint64_t instance_id_;
+    // кольца всех писавших потоков, добавляются в голову списка
+    std::atomic<ThreadSlots*> thread_slots_{ nullptr };
+
+    ThreadSlots& GetThreadSlots();
+
+    int64_t GetPeriod(Clock::time_point time) const;
+};
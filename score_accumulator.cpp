@@ -0,0 +1,231 @@
+﻿#include <algorithm>
+#include <cassert>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// AVX2-ядра собираются атрибутом target без -mavx2 и выбираются по процессору во время выполнения
+#define SCORE_ACCUMULATOR_AVX2_DISPATCH
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "score_accumulator.h"
+
+using namespace std;
+
+namespace {
+
+#ifdef SCORE_ACCUMULATOR_AVX2_DISPATCH
+bool CpuSupportsAvx2() {
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return supported;
+}
+
+// обрабатывает постинги блоками по 8, возвращает число обработанных
+__attribute__((target("avx2")))
+size_t AddPostingsAvx2(uint32_t* scores, const int* document_ids, const uint8_t* impacts, size_t count, uint32_t term_weight) {
+    const __m256i weight = _mm256_set1_epi32(static_cast<int>(term_weight));
+    alignas(32) uint32_t products[8];
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i impact_bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(impacts + i));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(products), _mm256_mullo_epi32(_mm256_cvtepu8_epi32(impact_bytes), weight));
+        for (size_t lane = 0; lane < 8; ++lane) {
+            scores[document_ids[i + lane]] += products[lane];
+        }
+    }
+    return i;
+}
+
+// обнуляет счета слов карты с first_block по last_block, слова целиком лежат в массиве
+__attribute__((target("avx2")))
+void RemoveBlocksAvx2(uint32_t* scores, const uint64_t* blocks, size_t first_block, size_t last_block) {
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    for (size_t block_index = first_block; block_index < last_block; ++block_index) {
+        const uint64_t block = blocks[block_index];
+        for (size_t first_lane = 0; block != 0 && first_lane < 64; first_lane += 8) {
+            const int bits = static_cast<int>(block >> first_lane & 0xFF);
+            if (bits == 0) {
+                continue;
+            }
+            __m256i* address = reinterpret_cast<__m256i*>(scores + block_index * 64 + first_lane);
+            const __m256i removed = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), lane_bits), lane_bits);
+            _mm256_storeu_si256(address, _mm256_andnot_si256(removed, _mm256_loadu_si256(address)));
+        }
+    }
+}
+
+// собирает и обнуляет ненулевые счета блоками по 8, возвращает первый необработанный id
+__attribute__((target("avx2")))
+int ExtractAvx2(uint32_t* scores, int document_id, int end_id, vector<pair<int, uint32_t>>& documents) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (; document_id + 8 <= end_id; document_id += 8) {
+        __m256i* block_address = reinterpret_cast<__m256i*>(scores + document_id);
+        const __m256i block = _mm256_loadu_si256(block_address);
+        int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, zero))) & 0xFF;
+        if (mask == 0) {
+            continue;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            const int lane = __builtin_ctz(mask);
+            documents.push_back({ document_id + lane, scores[document_id + lane] });
+        }
+        _mm256_storeu_si256(block_address, zero);
+    }
+    return document_id;
+}
+#endif
+
+#ifdef __SSE2__
+void RemoveBlocksSse2(uint32_t* scores, const uint64_t* blocks, size_t first_block, size_t last_block) {
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    for (size_t block_index = first_block; block_index < last_block; ++block_index) {
+        const uint64_t block = blocks[block_index];
+        for (size_t first_lane = 0; block != 0 && first_lane < 64; first_lane += 4) {
+            const int bits = static_cast<int>(block >> first_lane & 0xF);
+            if (bits == 0) {
+                continue;
+            }
+            __m128i* address = reinterpret_cast<__m128i*>(scores + block_index * 64 + first_lane);
+            const __m128i removed = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(bits), lane_bits), lane_bits);
+            _mm_storeu_si128(address, _mm_andnot_si128(removed, _mm_loadu_si128(address)));
+        }
+    }
+}
+
+int ExtractSse2(uint32_t* scores, int document_id, int end_id, vector<pair<int, uint32_t>>& documents) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; document_id + 4 <= end_id; document_id += 4) {
+        __m128i* block_address = reinterpret_cast<__m128i*>(scores + document_id);
+        const __m128i block = _mm_loadu_si128(block_address);
+        int mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, zero))) & 0xF;
+        if (mask == 0) {
+            continue;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            const int lane = __builtin_ctz(mask);
+            documents.push_back({ document_id + lane, scores[document_id + lane] });
+        }
+        _mm_storeu_si128(block_address, zero);
+    }
+    return document_id;
+}
+#endif
+
+}  // namespace
+
+void ScoreAccumulator::Reset(int max_document_id) {
+    if (scores_.size() < static_cast<size_t>(max_document_id) + 1) {
+        scores_.resize(static_cast<size_t>(max_document_id) + 1);
+    }
+    max_document_id_ = max_document_id;
+    first_touched_ = 0;
+    last_touched_ = -1;
+}
+
+void ScoreAccumulator::AddPostings(const int* document_ids, const uint8_t* impacts, size_t count, uint32_t term_weight) {
+    if (count == 0) {
+        return;
+    }
+    Touch(document_ids[0], document_ids[count - 1]);
+    size_t i = 0;
+#ifdef SCORE_ACCUMULATOR_AVX2_DISPATCH
+    if (CpuSupportsAvx2()) {
+        i = AddPostingsAvx2(scores_.data(), document_ids, impacts, count, term_weight);
+    }
+#endif
+    for (; i < count; ++i) {
+        scores_[document_ids[i]] += impacts[i] * term_weight;
+    }
+}
+
+uint32_t ScoreAccumulator::Add(int document_id, uint32_t score) {
+    Touch(document_id, document_id);
+    return scores_[document_id] += score;
+}
+
+void ScoreAccumulator::RemoveAll(const DocumentIdBitmap& document_ids) {
+    if (last_touched_ < first_touched_) {
+        return;
+    }
+    if (!document_ids.IsDense()) {
+        const vector<int>& sparse_ids = document_ids.GetSparseIds();
+        for (auto id = lower_bound(sparse_ids.begin(), sparse_ids.end(), first_touched_);
+            id != sparse_ids.end() && *id <= last_touched_; ++id) {
+            scores_[*id] = 0;
+        }
+        return;
+    }
+    const vector<uint64_t>& blocks = document_ids.GetBlocks();
+    const size_t last_block = min(blocks.size(), static_cast<size_t>(last_touched_) / 64 + 1);
+    size_t block_index = static_cast<size_t>(first_touched_) / 64;
+    // слова карты, целиком лежащие в массиве, обрабатываются векторно
+    const size_t last_full_block = max(block_index, min(last_block, scores_.size() / 64));
+#ifdef SCORE_ACCUMULATOR_AVX2_DISPATCH
+    if (CpuSupportsAvx2()) {
+        RemoveBlocksAvx2(scores_.data(), blocks.data(), block_index, last_full_block);
+        block_index = last_full_block;
+    }
+#endif
+#ifdef __SSE2__
+    RemoveBlocksSse2(scores_.data(), blocks.data(), block_index, last_full_block);
+    block_index = last_full_block;
+#endif
+    for (; block_index < last_block; ++block_index) {
+        // хвост массива короче слова карты
+        for (uint64_t bits = blocks[block_index]; bits != 0; bits &= bits - 1) {
+            const size_t document_id = block_index * 64 + __builtin_ctzll(bits);
+            if (document_id < scores_.size()) {
+                scores_[document_id] = 0;
+            }
+        }
+    }
+}
+
+uint32_t ScoreAccumulator::Get(int document_id) const {
+    return scores_[document_id];
+}
+
+vector<pair<int, uint32_t>> ScoreAccumulator::Extract() {
+    vector<pair<int, uint32_t>> documents;
+    int document_id = first_touched_;
+#ifdef SCORE_ACCUMULATOR_AVX2_DISPATCH
+    if (CpuSupportsAvx2()) {
+        document_id = ExtractAvx2(scores_.data(), document_id, last_touched_ + 1, documents);
+    }
+#endif
+#ifdef __SSE2__
+    document_id = ExtractSse2(scores_.data(), document_id, last_touched_ + 1, documents);
+#endif
+    for (; document_id <= last_touched_; ++document_id) {
+        if (scores_[document_id] != 0) {
+            documents.push_back({ document_id, scores_[document_id] });
+            scores_[document_id] = 0;
+        }
+    }
+    first_touched_ = 0;
+    last_touched_ = -1;
+    return documents;
+}
+
+void ScoreAccumulator::Clear() {
+    if (first_touched_ <= last_touched_) {
+        fill(scores_.begin() + first_touched_, scores_.begin() + last_touched_ + 1, 0);
+    }
+    first_touched_ = 0;
+    last_touched_ = -1;
+}
+
+void ScoreAccumulator::Touch(int first_document_id, int last_document_id) {
+    assert(0 <= first_document_id && first_document_id <= last_document_id && last_document_id <= max_document_id_);
+    if (last_touched_ < first_touched_) {
+        first_touched_ = first_document_id;
+        last_touched_ = last_document_id;
+        return;
+    }
+    first_touched_ = min(first_touched_, first_document_id);
+    last_touched_ = max(last_touched_, last_document_id);
+}
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "document_filter.h"
+
+/*
+ *
+ * 32-битные целочисленные счета документов в массиве, индексированном id документа.
+ * Вклад слова - квантованная частота (байт) на квантованный вес слова (до 16 бит),
+ * поэтому без переполнения складываются до 256 слов.
+ * Произведения считаются блоками по 8 (AVX2), сложение по id - скалярное: разброс
+ * по произвольным id не векторизуется. Выбор ненулевых счетов с одновременной очисткой
+ * массива идет блоками по 8 (AVX2) или 4 (SSE2) счета.
+ * AVX2-путь выбирается во время выполнения по процессору, сборка с -mavx2 не требуется.
+ *
+ */
+
+class ScoreAccumulator {
+public:
+    // готовит массив для id от 0 до max_document_id, массив должен быть пуст (после Extract);
+    // id вне этого диапазона в AddPostings и Add - ошибка вызывающего (assert)
+    void Reset(int max_document_id);
+
+    // scores[ids[i]] += impacts[i] * term_weight, ids отсортированы
+    void AddPostings(const int* document_ids, const uint8_t* impacts, size_t count, uint32_t term_weight);
+
+    // возвращает новый счет документа
+    uint32_t Add(int document_id, uint32_t score);
+
+    // обнуляет счета всех документов карты: AND-NOT маски, развернутой из битов по 8 (AVX2) или 4 (SSE2) счета;
+    // для карты-списка - по одному id из диапазона затронутых
+    void RemoveAll(const DocumentIdBitmap& document_ids);
+
+    uint32_t Get(int document_id) const;
+
+    // ненулевые счета в порядке id; массив после вызова снова пуст
+    std::vector<std::pair<int, uint32_t>> Extract();
+
+    // очищает массив, не собирая счета
+    void Clear();
+
+private:
+    std::vector<uint32_t> scores_;
+    // массив бывает длиннее после прошлых Reset, но id больше max_document_id_ в нем не ждут
+    int max_document_id_ = -1;
+    // диапазон id, в котором могут быть ненулевые счета
+    int first_touched_ = 0;
+    int last_touched_ = -1;
+
+    void Touch(int first_document_id, int last_document_id);
+};
@@ -0,0 +1,1026 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <execution>
+#include <functional>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "search_benchmark.h"
+#include "async_search_server.h"
+#include "process_queries.h"
+#include "query_client.h"
+#include "query_server.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "sharded_search_server.h"
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+// число стоп слов: самые частые слова словаря
+const size_t STOP_WORD_COUNT = 3;
+// запросы QueryKind::SKEWED начинаются с одного из стольких самых частых слов после стоп слов
+const size_t SKEWED_QUERY_WORD_COUNT = 4;
+
+uint64_t ToNanoseconds(Clock::duration duration) {
+    return chrono::duration_cast<chrono::nanoseconds>(duration).count();
+}
+
+string MakeWord(size_t rank) {
+    string word;
+    do {
+        word += static_cast<char>('a' + rank % 26);
+        rank /= 26;
+    } while (rank > 0);
+    return word;
+}
+
+/*
+ *
+ * Выполняет operation(i) для i из [0, operations) и замеряет время каждого вызова.
+ * operation возвращает число найденных документов/слов.
+ *
+ */
+
+template <typename Operation>
+BenchmarkResult Measure(const string& name, size_t document_count, size_t operations, Operation operation) {
+    BenchmarkResult result;
+    result.name = name;
+    result.document_count = document_count;
+    result.operations = operations;
+
+    vector<uint64_t> latencies(operations);
+    const auto start_time = Clock::now();
+    for (size_t i = 0; i < operations; ++i) {
+        const auto operation_start_time = Clock::now();
+        result.results += operation(i);
+        latencies[i] = ToNanoseconds(Clock::now() - operation_start_time);
+    }
+    result.seconds = ToNanoseconds(Clock::now() - start_time) / 1e9;
+
+    if (!latencies.empty()) {
+        sort(latencies.begin(), latencies.end());
+        result.p50_ns = latencies[(latencies.size() - 1) / 2];
+        result.p99_ns = latencies[(latencies.size() - 1) * 99 / 100];
+    }
+    result.peak_rss_kb = GetPeakRssKb();
+    return result;
+}
+
+// временно подменяет буфер потока, чтобы заглушить вывод RemoveDuplicates
+class StreamRedirect {
+public:
+    StreamRedirect(ostream& stream, streambuf* buffer)
+        : stream_(stream)
+        , old_buffer_(stream.rdbuf(buffer)) {
+    }
+
+    ~StreamRedirect() {
+        stream_.rdbuf(old_buffer_);
+    }
+
+private:
+    ostream& stream_;
+    streambuf* old_buffer_;
+};
+
+/*
+ *
+ * Совпадение топов приближенного поиска с точными: доля общих документов и доля запросов
+ * с тем же порядком документов
+ *
+ */
+
+void PrintAgreement(const string& name, const vector<vector<Document>>& exact_results,
+    const vector<vector<Document>>& approximate_results, ostream& out) {
+    double overlap_sum = 0.0;
+    size_t same_order_count = 0;
+    for (size_t query = 0; query < exact_results.size(); ++query) {
+        const vector<Document>& exact_result = exact_results[query];
+        const vector<Document>& approximate_result = approximate_results[query];
+        size_t common_count = 0;
+        bool same_order = exact_result.size() == approximate_result.size();
+        for (size_t i = 0; i < exact_result.size(); ++i) {
+            common_count += count_if(approximate_result.begin(), approximate_result.end(), [&](const Document& document) {
+                return document.id == exact_result[i].id;
+            });
+            same_order = same_order && approximate_result[i].id == exact_result[i].id;
+        }
+        overlap_sum += exact_result.empty() ? 1.0 : common_count * 1.0 / exact_result.size();
+        same_order_count += same_order ? 1 : 0;
+    }
+    const size_t query_count = exact_results.size();
+    out << "{\"benchmark\":\""s << name << "\",\"queries\":"s << query_count
+        << ",\"top_k_overlap\":"s << (query_count > 0 ? overlap_sum / query_count : 1.0)
+        << ",\"same_order\":"s << (query_count > 0 ? same_order_count * 1.0 / query_count : 1.0) << "}"s << endl;
+}
+
+/*
+ *
+ * Раскрытие слов с опечатками автоматом Левенштейна на словаре из fuzzy_vocabulary_size
+ * случайных слов длиной 5-12 букв. Опечатки - одна или две замены букв в словарном слове.
+ *
+ */
+
+void RunFuzzyBenchmark(const BenchmarkConfig& config, ostream& out) {
+    mt19937_64 generator(config.seed + 8);
+    uniform_int_distribution<size_t> length_distribution(5, 12);
+    uniform_int_distribution<int> letter_distribution('a', 'z');
+    set<string> unique_words;
+    while (unique_words.size() < config.fuzzy_vocabulary_size) {
+        string word(length_distribution(generator), ' ');
+        for (char& c : word) {
+            c = static_cast<char>(letter_distribution(generator));
+        }
+        unique_words.insert(move(word));
+    }
+    const vector<string> words(unique_words.begin(), unique_words.end());
+    unique_words.clear();
+
+    TermDictionary dictionary;
+    BenchmarkResult build_result = Measure("build_term_dictionary"s, 0, 1, [&](size_t) {
+        vector<pair<string_view, int>> terms;
+        terms.reserve(words.size());
+        for (size_t i = 0; i < words.size(); ++i) {
+            terms.push_back({ words[i], static_cast<int>(i) });
+        }
+        dictionary = TermDictionary(terms);
+        return dictionary.size();
+    });
+    build_result.bytes = dictionary.GetByteSize();
+    build_result.PrintJson(out);
+
+    if (words.empty()) {
+        return;
+    }
+    uniform_int_distribution<size_t> word_distribution(0, words.size() - 1);
+    for (int max_distance = 1; max_distance <= 2; ++max_distance) {
+        vector<string> misspelled_words;
+        for (size_t i = 0; i < config.query_count; ++i) {
+            string word = words[word_distribution(generator)];
+            for (int edit = 0; edit < max_distance; ++edit) {
+                word[uniform_int_distribution<size_t>(0, word.size() - 1)(generator)] = static_cast<char>(letter_distribution(generator));
+            }
+            misspelled_words.push_back(move(word));
+        }
+        Measure("expand_fuzzy_distance_"s + to_string(max_distance), 0, misspelled_words.size(), [&](size_t i) {
+            return dictionary.FindWithinDistance(LevenshteinAutomaton(misspelled_words[i], max_distance)).size();
+        }).PrintJson(out);
+    }
+}
+
+// промахи dTLB на чтение в потоке бенчмарка; если perf_event_open недоступен, счетчика нет
+class DtlbMissCounter {
+public:
+    DtlbMissCounter() {
+        perf_event_attr attributes{};
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+
+    DtlbMissCounter(const DtlbMissCounter&) = delete;
+
+    DtlbMissCounter& operator=(const DtlbMissCounter&) = delete;
+
+    ~DtlbMissCounter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void Start() {
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    optional<uint64_t> Stop() {
+        if (fd_ < 0) {
+            return nullopt;
+        }
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(fd_, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) {
+            return nullopt;
+        }
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+// добавление корпуса и запросы при способе выделения узлов allocation
+void RunNodeAllocation(const SyntheticCorpus& corpus, const vector<string>& queries, const string& allocation_name,
+    NodeAllocation allocation, ostream& out) {
+    const auto& documents = corpus.GetDocuments();
+    DtlbMissCounter dtlb_misses;
+    const long rss_before_kb = GetCurrentRssKb();
+    SearchServer search_server(corpus.GetStopWords());
+    search_server.SetNodeAllocation(allocation);
+
+    dtlb_misses.Start();
+    BenchmarkResult ingest_result = Measure("ingest_nodes_"s + allocation_name, documents.size(), documents.size(), [&](size_t i) {
+        const SyntheticDocument& document = documents[i];
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        return size_t{ 1 };
+    });
+    ingest_result.dtlb_misses = dtlb_misses.Stop();
+    ingest_result.rss_growth_kb = GetCurrentRssKb() - rss_before_kb;
+    ingest_result.PrintJson(out);
+
+    dtlb_misses.Start();
+    BenchmarkResult query_result = Measure("query_nodes_"s + allocation_name, documents.size(), queries.size(), [&](size_t i) {
+        size_t results = 0;
+        for (const Document& document : search_server.FindTopDocuments(execution::seq, queries[i])) {
+            results += get<0>(search_server.MatchDocument(queries[i], document.id)).size();
+            results += search_server.GetWordFrequencies(document.id).size();
+        }
+        return results;
+    });
+    query_result.dtlb_misses = dtlb_misses.Stop();
+    query_result.PrintJson(out);
+}
+
+/*
+ *
+ * Выполняет run в дочернем процессе и возвращает то, что он вывел: замер начинается с кучи,
+ * в которой нет освобожденных блоков прошлых замеров. Если fork недоступен, run выполняется здесь же.
+ *
+ */
+
+string RunInChildProcess(const function<void(ostream&)>& run) {
+    int pipe_fds[2];
+    pid_t pid = -1;
+    if (pipe(pipe_fds) == 0) {
+        pid = fork();
+        if (pid < 0) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+    }
+    if (pid < 0) {
+        ostringstream output;
+        run(output);
+        return output.str();
+    }
+    if (pid == 0) {
+        close(pipe_fds[0]);
+        ostringstream output;
+        run(output);
+        const string text = output.str();
+        for (size_t written = 0; written < text.size();) {
+            const ssize_t count = write(pipe_fds[1], text.data() + written, text.size() - written);
+            if (count <= 0) {
+                break;
+            }
+            written += static_cast<size_t>(count);
+        }
+        _exit(0);
+    }
+    close(pipe_fds[1]);
+    string text;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<size_t>(count));
+    }
+    close(pipe_fds[0]);
+    waitpid(pid, nullptr, 0);
+    return text;
+}
+
+/*
+ *
+ * Добавление корпуса и запросы, читающие узлы индекса (поиск, MatchDocument и частоты слов найденных документов),
+ * для каждого способа выделения узлов: прирост RSS за добавление и промахи dTLB.
+ * Каждый режим меряется в своем процессе, чтобы прирост RSS не занижался повторным использованием кучи.
+ *
+ */
+
+void RunNodeAllocationBenchmark(const SyntheticCorpus& corpus, const vector<string>& queries, ostream& out) {
+    const vector<pair<string, NodeAllocation>> allocations = {
+        { "heap"s, NodeAllocation::HEAP },
+        { "pool"s, NodeAllocation::POOL },
+        { "pool_thp"s, NodeAllocation::POOL_TRANSPARENT_HUGE_PAGES },
+        { "pool_hugetlb"s, NodeAllocation::POOL_HUGETLB },
+    };
+    for (const auto& [allocation_name, allocation] : allocations) {
+        out << RunInChildProcess([&](ostream& child_out) {
+            RunNodeAllocation(corpus, queries, allocation_name, allocation, child_out);
+        });
+    }
+}
+
+
+}  // namespace
+
+BenchmarkConfig ParseBenchmarkConfig(const vector<string>& args) {
+    BenchmarkConfig config;
+    for (const string& arg : args) {
+        const auto equal_pos = arg.find('=');
+        if (equal_pos == arg.npos) {
+            throw invalid_argument("Benchmark argument must be key=value: "s + arg);
+        }
+        const string key = arg.substr(0, equal_pos);
+        const string value = arg.substr(equal_pos + 1);
+        if (key == "docs"s) {
+            config.document_count = stoull(value);
+        }
+        else if (key == "vocabulary"s) {
+            config.vocabulary_size = stoull(value);
+        }
+        else if (key == "min_words"s) {
+            config.min_document_words = stoull(value);
+        }
+        else if (key == "max_words"s) {
+            config.max_document_words = stoull(value);
+        }
+        else if (key == "zipf"s) {
+            config.zipf_exponent = stod(value);
+        }
+        else if (key == "queries"s) {
+            config.query_count = stoull(value);
+        }
+        else if (key == "duplicates_docs"s) {
+            config.duplicates_document_count = stoull(value);
+        }
+        else if (key == "fuzzy_vocabulary"s) {
+            config.fuzzy_vocabulary_size = stoull(value);
+        }
+        else if (key == "seed"s) {
+            config.seed = stoull(value);
+        }
+        else {
+            throw invalid_argument("Unknown benchmark argument: "s + key);
+        }
+    }
+    if (config.vocabulary_size <= STOP_WORD_COUNT || config.min_document_words == 0
+        || config.min_document_words > config.max_document_words) {
+        throw invalid_argument("Incorrect benchmark corpus parameters"s);
+    }
+    return config;
+}
+
+ZipfDistribution::ZipfDistribution(size_t size, double exponent)
+    : cumulative_(size) {
+    double sum = 0.0;
+    for (size_t rank = 0; rank < size; ++rank) {
+        sum += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+        cumulative_[rank] = sum;
+    }
+}
+
+size_t ZipfDistribution::operator()(mt19937_64& generator) const {
+    uniform_real_distribution<double> distribution(0.0, cumulative_.back());
+    const auto it = upper_bound(cumulative_.begin(), cumulative_.end(), distribution(generator));
+    return min(static_cast<size_t>(it - cumulative_.begin()), cumulative_.size() - 1);
+}
+
+SyntheticCorpus::SyntheticCorpus(const BenchmarkConfig& config)
+    : word_distribution_(config.vocabulary_size, config.zipf_exponent) {
+    vocabulary_.reserve(config.vocabulary_size);
+    for (size_t rank = 0; rank < config.vocabulary_size; ++rank) {
+        vocabulary_.push_back(MakeWord(rank));
+    }
+    for (size_t rank = 0; rank < STOP_WORD_COUNT; ++rank) {
+        stop_words_ += (rank > 0 ? " "s : ""s) + vocabulary_[rank];
+    }
+
+    mt19937_64 generator(config.seed);
+    uniform_int_distribution<size_t> word_count_distribution(config.min_document_words, config.max_document_words);
+    uniform_int_distribution<int> status_distribution(0, 19);
+    uniform_int_distribution<int> rating_distribution(-10, 10);
+
+    documents_.reserve(config.document_count);
+    for (size_t i = 0; i < config.document_count; ++i) {
+        SyntheticDocument document;
+        document.id = static_cast<int>(i);
+        const size_t word_count = word_count_distribution(generator);
+        for (size_t j = 0; j < word_count; ++j) {
+            if (j > 0) {
+                document.text += ' ';
+            }
+            document.text += vocabulary_[word_distribution_(generator)];
+        }
+        // 85% актуальных документов, остальные статусы поровну
+        const int status = status_distribution(generator);
+        document.status = status < 17 ? DocumentStatus::ACTUAL : static_cast<DocumentStatus>(status - 16);
+        document.ratings = { rating_distribution(generator), rating_distribution(generator), rating_distribution(generator) };
+        documents_.push_back(move(document));
+    }
+}
+
+const string& SyntheticCorpus::GetStopWords() const {
+    return stop_words_;
+}
+
+const vector<SyntheticDocument>& SyntheticCorpus::GetDocuments() const {
+    return documents_;
+}
+
+const string& SyntheticCorpus::GetWord(size_t rank) const {
+    return vocabulary_.at(rank);
+}
+
+vector<string> SyntheticCorpus::GenerateQueries(QueryKind kind, size_t count, uint64_t seed) const {
+    mt19937_64 generator(seed);
+    const auto random_words = [this, &generator](size_t min_count, size_t max_count, const string& prefix) {
+        string words;
+        const size_t word_count = uniform_int_distribution<size_t>(min_count, max_count)(generator);
+        for (size_t i = 0; i < word_count; ++i) {
+            words += ' ' + prefix + vocabulary_[word_distribution_(generator)];
+        }
+        return words;
+    };
+
+    vector<string> queries;
+    queries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        string query;
+        switch (kind) {
+        case QueryKind::SHORT:
+            query = random_words(1, 2, ""s);
+            break;
+        case QueryKind::LONG:
+            query = random_words(5, 10, ""s);
+            break;
+        case QueryKind::WITH_MINUS_WORDS:
+            query = random_words(2, 4, ""s) + random_words(1, 2, "-"s);
+            break;
+        case QueryKind::CONJUNCTIVE:
+            query = random_words(2, 4, "+"s);
+            break;
+        case QueryKind::MISSPELLED:
+            for (size_t j = 0; j < 2; ++j) {
+                string word = vocabulary_[word_distribution_(generator)];
+                word[uniform_int_distribution<size_t>(0, word.size() - 1)(generator)] = static_cast<char>('a' + generator() % 26);
+                query += ' ' + word;
+            }
+            break;
+        case QueryKind::SKEWED:
+            query = ' ' + vocabulary_[STOP_WORD_COUNT + generator() % SKEWED_QUERY_WORD_COUNT] + random_words(2, 4, ""s);
+            break;
+        case QueryKind::PREFIX: {
+            const string& word = vocabulary_[word_distribution_(generator)];
+            query = ' ' + word.substr(0, max<size_t>(1, word.size() - 1)) + '*';
+            break;
+        }
+        }
+        queries.push_back(query.substr(1));
+    }
+    return queries;
+}
+
+vector<string> SyntheticCorpus::GeneratePositionalQueries(bool is_phrase, size_t count, uint64_t seed) const {
+    vector<string> queries;
+    if (documents_.empty()) {
+        return queries;
+    }
+    mt19937_64 generator(seed);
+    uniform_int_distribution<size_t> document_distribution(0, documents_.size() - 1);
+    while (queries.size() < count) {
+        const vector<string_view> words = SplitIntoWords(documents_[document_distribution(generator)].text);
+        if (words.size() < 4) {
+            continue;
+        }
+        const size_t first = uniform_int_distribution<size_t>(0, words.size() - 4)(generator);
+        if (is_phrase) {
+            const size_t phrase_size = uniform_int_distribution<size_t>(2, 3)(generator);
+            string query = "\""s;
+            for (size_t i = first; i < first + phrase_size; ++i) {
+                query += (i > first ? " "s : ""s) + string(words[i]);
+            }
+            queries.push_back(query + "\""s);
+        }
+        else {
+            const size_t distance = uniform_int_distribution<size_t>(1, 3)(generator);
+            queries.push_back(string(words[first]) + " NEAR/3 "s + string(words[first + distance]));
+        }
+    }
+    return queries;
+}
+
+void BenchmarkResult::PrintJson(ostream& out) const {
+    out << "{\"benchmark\":\""s << name << "\""s
+        << ",\"docs\":"s << document_count
+        << ",\"operations\":"s << operations
+        << ",\"seconds\":"s << seconds
+        << ",\"throughput_ops\":"s << (seconds > 0 ? operations / seconds : 0.0)
+        << ",\"p50_us\":"s << p50_ns / 1000.0
+        << ",\"p99_us\":"s << p99_ns / 1000.0
+        << ",\"peak_rss_kb\":"s << peak_rss_kb
+        << (bytes > 0 ? ",\"bytes\":"s + to_string(bytes) : ""s)
+        << (rss_growth_kb ? ",\"rss_growth_kb\":"s + to_string(*rss_growth_kb) : ""s)
+        << (dtlb_misses ? ",\"dtlb_misses\":"s + to_string(*dtlb_misses) : ""s)
+        << ",\"results\":"s << results << "}"s << endl;
+}
+
+long GetCurrentRssKb() {
+    long total_pages = 0;
+    long resident_pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+    if (fscanf(statm, "%ld %ld", &total_pages, &resident_pages) != 2) {
+        resident_pages = 0;
+    }
+    fclose(statm);
+    return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+long GetPeakRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void RunSearchBenchmark(const BenchmarkConfig& config, ostream& out) {
+    const SyntheticCorpus corpus(config);
+    const auto& documents = corpus.GetDocuments();
+    const size_t document_count = documents.size();
+
+    // до остальных замеров: режимы меряются в дочерних процессах, а fork безопасен, пока не запущены рабочие потоки
+    RunNodeAllocationBenchmark(corpus, corpus.GenerateQueries(QueryKind::SHORT, config.query_count, config.seed + 1), out);
+
+    SearchServer search_server(corpus.GetStopWords());
+    Measure("add_document"s, document_count, document_count, [&](size_t i) {
+        const SyntheticDocument& document = documents[i];
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        return size_t{ 1 };
+    }).PrintJson(out);
+
+    // те же документы в случайном порядке id: вставка, смена статуса и удаление в середине списков постингов
+    {
+        vector<size_t> order(document_count);
+        iota(order.begin(), order.end(), size_t{ 0 });
+        mt19937_64 generator(config.seed + 11);
+        shuffle(order.begin(), order.end(), generator);
+        SearchServer shuffled_server(corpus.GetStopWords());
+        Measure("add_document_shuffled"s, document_count, document_count, [&](size_t i) {
+            const SyntheticDocument& document = documents[order[i]];
+            shuffled_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            return size_t{ 1 };
+        }).PrintJson(out);
+        const size_t mutation_count = min(config.query_count, document_count / 10);
+        // статус меняется туда и обратно
+        Measure("set_document_status_shuffled"s, document_count, 2 * mutation_count, [&](size_t i) {
+            const SyntheticDocument& document = documents[order[i / 2]];
+            const DocumentStatus other_status = document.status == DocumentStatus::ACTUAL ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            shuffled_server.SetDocumentStatus(document.id, i % 2 == 0 ? other_status : document.status);
+            return size_t{ 1 };
+        }).PrintJson(out);
+        Measure("remove_document_shuffled"s, document_count, mutation_count, [&](size_t i) {
+            shuffled_server.RemoveDocument(documents[order[i]].id);
+            return size_t{ 1 };
+        }).PrintJson(out);
+    }
+
+    const vector<pair<string, vector<string>>> workloads = {
+        { "short"s, corpus.GenerateQueries(QueryKind::SHORT, config.query_count, config.seed + 1) },
+        { "long"s, corpus.GenerateQueries(QueryKind::LONG, config.query_count, config.seed + 2) },
+        { "minus"s, corpus.GenerateQueries(QueryKind::WITH_MINUS_WORDS, config.query_count, config.seed + 3) },
+        { "and"s, corpus.GenerateQueries(QueryKind::CONJUNCTIVE, config.query_count, config.seed + 4) },
+        { "prefix"s, corpus.GenerateQueries(QueryKind::PREFIX, config.query_count, config.seed + 7) },
+    };
+
+    // пороги adaptive_execution замеряются при запуске, до поисков
+    Measure("calibrate_adaptive_execution"s, 0, 1, [](size_t) {
+        WarmUpAdaptiveExecution();
+        return size_t{ 1 };
+    }).PrintJson(out);
+    WarmUpAdaptiveExecution().PrintJson("adaptive_execution_thresholds", out);
+
+    for (const auto& [workload_name, queries] : workloads) {
+        Measure("find_top_seq_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+            return search_server.FindTopDocuments(execution::seq, queries[i]).size();
+        }).PrintJson(out);
+        Measure("find_top_par_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+            return search_server.FindTopDocuments(execution::par, queries[i]).size();
+        }).PrintJson(out);
+        Measure("find_top_adaptive_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+            return search_server.FindTopDocuments(adaptive_execution, queries[i]).size();
+        }).PrintJson(out);
+    }
+
+    // BM25 дополнительно читает длину документа на каждом постинге
+    const Bm25Ranking bm25;
+    for (size_t workload = 0; workload < 2; ++workload) {
+        const auto& [workload_name, queries] = workloads[workload];
+        Measure("find_top_seq_bm25_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+            return search_server.FindTopDocuments(execution::seq, queries[i], DocumentFilter::ByStatus(DocumentStatus::ACTUAL), bm25).size();
+        }).PrintJson(out);
+        Measure("find_top_par_bm25_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+            return search_server.FindTopDocuments(execution::par, queries[i], DocumentFilter::ByStatus(DocumentStatus::ACTUAL), bm25).size();
+        }).PrintJson(out);
+    }
+
+    // поиск с бюджетом на длинных запросах: время и доля запросов с неполным результатом
+    {
+        const vector<string>& long_queries = workloads[1].second;
+        const DocumentFilter actual = DocumentFilter::ByStatus(DocumentStatus::ACTUAL);
+        const SearchBudget postings_budget = SearchBudget::WithPostings(max<size_t>(document_count / 10, 1));
+        array<size_t, 3> partial_counts{};
+        Measure("find_top_seq_budget_postings_long"s, document_count, long_queries.size(), [&](size_t i) {
+            const SearchResult result = search_server.FindTopDocuments(execution::seq, long_queries[i], actual, postings_budget);
+            partial_counts[0] += result.is_partial ? 1 : 0;
+            return result.documents.size();
+        }).PrintJson(out);
+        Measure("find_top_par_budget_postings_long"s, document_count, long_queries.size(), [&](size_t i) {
+            const SearchResult result = search_server.FindTopDocuments(execution::par, long_queries[i], actual, postings_budget);
+            partial_counts[1] += result.is_partial ? 1 : 0;
+            return result.documents.size();
+        }).PrintJson(out);
+        Measure("find_top_seq_budget_deadline_long"s, document_count, long_queries.size(), [&](size_t i) {
+            const SearchBudget deadline = SearchBudget::WithTimeout(chrono::microseconds(200));
+            const SearchResult result = search_server.FindTopDocuments(execution::seq, long_queries[i], actual, deadline);
+            partial_counts[2] += result.is_partial ? 1 : 0;
+            return result.documents.size();
+        }).PrintJson(out);
+        const double query_count = max<size_t>(long_queries.size(), 1);
+        out << "{\"benchmark\":\"budget_partial_share\",\"postings_seq\":"s << partial_counts[0] / query_count
+            << ",\"postings_par\":"s << partial_counts[1] / query_count
+            << ",\"deadline_seq\":"s << partial_counts[2] / query_count << "}"s << endl;
+    }
+
+    // квантованный TF-IDF: скорость и совпадение топа с точным расчетом в double
+    {
+        vector<vector<Document>> exact_results;
+        for (size_t workload = 0; workload < 2; ++workload) {
+            for (const string& query : workloads[workload].second) {
+                exact_results.push_back(search_server.FindTopDocuments(execution::seq, query));
+            }
+        }
+        search_server.SetQuantizedScoring(true);
+        for (size_t workload = 0; workload < 2; ++workload) {
+            const auto& [workload_name, queries] = workloads[workload];
+            Measure("find_top_seq_quantized_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+                return search_server.FindTopDocuments(execution::seq, queries[i]).size();
+            }).PrintJson(out);
+        }
+
+        vector<vector<Document>> quantized_results;
+        for (size_t workload = 0; workload < 2; ++workload) {
+            for (const string& query : workloads[workload].second) {
+                quantized_results.push_back(search_server.FindTopDocuments(execution::seq, query));
+            }
+        }
+        search_server.SetQuantizedScoring(false);
+        PrintAgreement("quantized_agreement"s, exact_results, quantized_results, out);
+
+        // постинги частых слов по убыванию частоты: обход до неизменного топа и с бюджетом постингов
+        const size_t min_document_count = max<size_t>(document_count / 100, 1);
+        const size_t postings_budget = max<size_t>(document_count / 10, 1);
+        search_server.SetImpactOrderedPostings(min_document_count);
+        for (size_t workload = 0; workload < 2; ++workload) {
+            const auto& [workload_name, queries] = workloads[workload];
+            Measure("find_top_seq_impact_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+                return search_server.FindTopDocuments(execution::seq, queries[i]).size();
+            }).PrintJson(out);
+        }
+        search_server.SetImpactOrderedPostings(min_document_count, postings_budget);
+        vector<vector<Document>> budget_results;
+        for (size_t workload = 0; workload < 2; ++workload) {
+            const auto& [workload_name, queries] = workloads[workload];
+            Measure("find_top_seq_impact_budget_"s + workload_name, document_count, queries.size(), [&](size_t i) {
+                return search_server.FindTopDocuments(execution::seq, queries[i]).size();
+            }).PrintJson(out);
+            for (const string& query : queries) {
+                budget_results.push_back(search_server.FindTopDocuments(execution::seq, query));
+            }
+        }
+        search_server.SetImpactOrderedPostings(0);
+        PrintAgreement("impact_budget_agreement"s, quantized_results, budget_results, out);
+    }
+
+    // фразы и NEAR: сначала поиск позиций разбором текста, затем по позиционному индексу
+    const vector<string> phrase_queries = corpus.GeneratePositionalQueries(true, config.query_count, config.seed + 5);
+    const vector<string> near_queries = corpus.GeneratePositionalQueries(false, config.query_count, config.seed + 6);
+    Measure("find_top_phrase_text_scan"s, document_count, phrase_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::seq, phrase_queries[i]).size();
+    }).PrintJson(out);
+    BenchmarkResult positional_index_result = Measure("build_positional_index"s, document_count, 1, [&](size_t) {
+        search_server.EnablePositionalIndex();
+        return size_t{ 1 };
+    });
+    positional_index_result.bytes = search_server.GetPositionalIndexByteSize();
+    positional_index_result.PrintJson(out);
+    Measure("find_top_phrase_seq"s, document_count, phrase_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::seq, phrase_queries[i]).size();
+    }).PrintJson(out);
+    Measure("find_top_phrase_par"s, document_count, phrase_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::par, phrase_queries[i]).size();
+    }).PrintJson(out);
+    Measure("find_top_near_seq"s, document_count, near_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::seq, near_queries[i]).size();
+    }).PrintJson(out);
+
+    // слова с опечатками: без нечеткого поиска большая часть запросов ничего не находит
+    const vector<string> misspelled_queries = corpus.GenerateQueries(QueryKind::MISSPELLED, config.query_count, config.seed + 9);
+    Measure("find_top_misspelled_exact"s, document_count, misspelled_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::seq, misspelled_queries[i]).size();
+    }).PrintJson(out);
+    search_server.SetFuzzyMatching(2);
+    Measure("find_top_misspelled_fuzzy"s, document_count, misspelled_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::seq, misspelled_queries[i]).size();
+    }).PrintJson(out);
+    search_server.SetFuzzyMatching(0);
+
+    const vector<string>& short_queries = workloads[0].second;
+    Measure("find_top_status_seq"s, document_count, short_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::seq, short_queries[i], DocumentStatus::BANNED).size();
+    }).PrintJson(out);
+    Measure("find_top_status_par"s, document_count, short_queries.size(), [&](size_t i) {
+        return search_server.FindTopDocuments(execution::par, short_queries[i], DocumentStatus::BANNED).size();
+    }).PrintJson(out);
+
+    // тот же поиск с учетом в статистике запросов: разница с find_top_seq_short - цена учета
+    RequestQueue request_queue(search_server);
+    Measure("request_queue_short"s, document_count, short_queries.size(), [&](size_t i) {
+        return request_queue.AddFindRequest(short_queries[i]).size();
+    }).PrintJson(out);
+
+    const vector<string>& minus_queries = workloads[2].second;
+    if (document_count > 0) {
+        Measure("match_document_seq"s, document_count, minus_queries.size(), [&](size_t i) {
+            return get<0>(search_server.MatchDocument(execution::seq, minus_queries[i], documents[i % document_count].id)).size();
+        }).PrintJson(out);
+        Measure("match_document_par"s, document_count, minus_queries.size(), [&](size_t i) {
+            return get<0>(search_server.MatchDocument(execution::par, minus_queries[i], documents[i % document_count].id)).size();
+        }).PrintJson(out);
+        Measure("match_document_adaptive"s, document_count, minus_queries.size(), [&](size_t i) {
+            return get<0>(search_server.MatchDocument(adaptive_execution, minus_queries[i], documents[i % document_count].id)).size();
+        }).PrintJson(out);
+
+        // матчинг всех документов из выдачи запроса, как при подсветке результатов
+        const vector<string>& short_queries = workloads[0].second;
+        Measure("match_documents_top_k"s, document_count, short_queries.size(), [&](size_t i) {
+            vector<int> document_ids;
+            for (const Document& document : search_server.FindTopDocuments(short_queries[i])) {
+                document_ids.push_back(document.id);
+            }
+            size_t results = 0;
+            for (const auto& [words, status] : search_server.MatchDocuments(execution::par, short_queries[i], document_ids)) {
+                results += words.size();
+            }
+            return results;
+        }).PrintJson(out);
+    }
+
+    const vector<string>& long_queries = workloads[1].second;
+    Measure("process_queries"s, document_count, 1, [&](size_t) {
+        size_t results = 0;
+        for (const auto& query_documents : ProcessQueries(search_server, long_queries)) {
+            results += query_documents.size();
+        }
+        return results;
+    }).PrintJson(out);
+
+    // на запросах с общими частыми словами обход постингов раз на группу запросов выигрывает больше всего
+    const vector<string> skewed_queries = corpus.GenerateQueries(QueryKind::SKEWED, config.query_count, config.seed + 10);
+    const vector<pair<string, const vector<string>*>> batch_workloads = { { "long"s, &long_queries }, { "skewed"s, &skewed_queries } };
+    for (const auto& [workload_name, queries] : batch_workloads) {
+        Measure("process_queries_per_query_"s + workload_name, document_count, 1, [&](size_t) {
+            return ProcessQueriesJoined(search_server, *queries, QueryBatchMode::PER_QUERY).size();
+        }).PrintJson(out);
+        Measure("process_queries_shared_terms_"s + workload_name, document_count, 1, [&](size_t) {
+            return ProcessQueriesJoined(search_server, *queries, QueryBatchMode::SHARED_TERMS).size();
+        }).PrintJson(out);
+    }
+    PrintAgreement("process_queries_shared_terms_agreement"s, ProcessQueries(search_server, skewed_queries, QueryBatchMode::PER_QUERY),
+        ProcessQueries(search_server, skewed_queries, QueryBatchMode::SHARED_TERMS), out);
+
+    // те же запросы одним пакетом и через асинхронный интерфейс, все отправлены сразу
+    const vector<string_view> long_query_views(long_queries.begin(), long_queries.end());
+    const vector<DocumentFilter> long_query_filters(long_queries.size(), DocumentFilter::ByStatus(DocumentStatus::ACTUAL));
+    Measure("find_top_batch_long"s, document_count, 1, [&](size_t) {
+        size_t results = 0;
+        for (const auto& query_documents : search_server.FindTopDocumentsBatch(long_query_views, long_query_filters)) {
+            results += query_documents.size();
+        }
+        return results;
+    }).PrintJson(out);
+    {
+        AsyncSearchServer async_server(search_server, chrono::microseconds(200));
+        Measure("find_top_async_long"s, document_count, 1, [&](size_t) {
+            vector<future<vector<Document>>> futures;
+            futures.reserve(long_queries.size());
+            for (const string& query : long_queries) {
+                futures.push_back(async_server.FindTopDocuments(query));
+            }
+            size_t results = 0;
+            for (auto& query_documents : futures) {
+                results += query_documents.get().size();
+            }
+            return results;
+        }).PrintJson(out);
+    }
+
+    // глубокая выдача: PAGE_COUNT страниц по курсору против пересчета с отбрасыванием предыдущих страниц
+    {
+        const size_t PAGE_SIZE = 10;
+        const size_t PAGE_COUNT = 20;
+        const size_t page_query_count = min(long_queries.size(), size_t{ 50 });
+        const DocumentFilter filter = DocumentFilter::ByStatus(DocumentStatus::ACTUAL);
+        Measure("find_top_page_cursor_long"s, document_count, page_query_count, [&](size_t i) {
+            size_t results = 0;
+            optional<SearchCursor> cursor;
+            for (size_t page = 0; page < PAGE_COUNT; ++page) {
+                SearchPage search_page = search_server.FindTopDocumentsPage(long_queries[i], filter, cursor, PAGE_SIZE);
+                results += search_page.documents.size();
+                if (!search_page.next_cursor) {
+                    break;
+                }
+                cursor = search_page.next_cursor;
+            }
+            return results;
+        }).PrintJson(out);
+        Measure("find_top_page_offset_long"s, document_count, page_query_count, [&](size_t i) {
+            size_t results = 0;
+            for (size_t page = 0; page < PAGE_COUNT; ++page) {
+                const size_t offset = page * PAGE_SIZE;
+                const SearchPage search_page = search_server.FindTopDocumentsPage(long_queries[i], filter, nullopt, offset + PAGE_SIZE);
+                if (search_page.documents.size() <= offset) {
+                    break;
+                }
+                results += search_page.documents.size() - offset;
+                if (!search_page.next_cursor) {
+                    break;
+                }
+            }
+            return results;
+        }).PrintJson(out);
+
+        // одна поздняя страница: по сохраненному курсору куча держит PAGE_SIZE + 1 документ,
+        // со смещением - все LATE_PAGE * PAGE_SIZE предыдущих
+        const size_t LATE_PAGE = 50;
+        vector<optional<SearchCursor>> late_cursors(page_query_count);
+        for (size_t i = 0; i < page_query_count; ++i) {
+            const SearchPage previous_pages = search_server.FindTopDocumentsPage(long_queries[i], filter, nullopt, LATE_PAGE * PAGE_SIZE);
+            if (!previous_pages.documents.empty()) {
+                late_cursors[i] = MakeSearchCursor(previous_pages.documents.back());
+            }
+        }
+        Measure("find_top_late_page_cursor_long"s, document_count, page_query_count, [&](size_t i) {
+            return search_server.FindTopDocumentsPage(long_queries[i], filter, late_cursors[i], PAGE_SIZE).documents.size();
+        }).PrintJson(out);
+        Measure("find_top_late_page_offset_long"s, document_count, page_query_count, [&](size_t i) {
+            const size_t offset = LATE_PAGE * PAGE_SIZE;
+            const SearchPage search_page = search_server.FindTopDocumentsPage(long_queries[i], filter, nullopt, offset + PAGE_SIZE);
+            return search_page.documents.size() > offset ? search_page.documents.size() - offset : size_t{ 0 };
+        }).PrintJson(out);
+    }
+
+    // тот же корпус в SHARD_COUNT шардах с общей статистикой слов
+    {
+        const size_t SHARD_COUNT = 4;
+        ShardedSearchServer sharded_server(corpus.GetStopWords(), SHARD_COUNT);
+        const string shard_suffix = "sharded_"s + to_string(SHARD_COUNT);
+        Measure("add_document_"s + shard_suffix, document_count, document_count, [&](size_t i) {
+            const SyntheticDocument& document = documents[i];
+            sharded_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            return size_t{ 1 };
+        }).PrintJson(out);
+        vector<vector<Document>> sharded_results;
+        Measure("find_top_"s + shard_suffix + "_long"s, document_count, long_queries.size(), [&](size_t i) {
+            sharded_results.push_back(sharded_server.FindTopDocuments(long_queries[i]));
+            return sharded_results.back().size();
+        }).PrintJson(out);
+        vector<vector<Document>> exact_results;
+        for (const string& query : long_queries) {
+            exact_results.push_back(search_server.FindTopDocuments(query));
+        }
+        PrintAgreement(shard_suffix + "_agreement"s, exact_results, sharded_results, out);
+    }
+
+    // те же запросы через сетевой сервер на loopback: без конвейера и по 8 запросов в полете на соединение
+    {
+        QueryServer query_server(search_server, 0);
+        thread server_thread([&query_server] { query_server.Run(); });
+        for (const size_t pipeline_depth : { size_t{ 1 }, size_t{ 8 } }) {
+            QueryLoadConfig load_config;
+            load_config.port = query_server.GetPort();
+            load_config.pipeline_depth = pipeline_depth;
+            load_config.request_count = long_queries.size();
+            const QueryLoadResult load_result = RunQueryLoad(load_config, long_queries);
+
+            BenchmarkResult result;
+            result.name = "network_find_top_long_c"s + to_string(load_config.connection_count) + "_p"s + to_string(pipeline_depth);
+            result.document_count = document_count;
+            result.operations = load_result.requests;
+            result.seconds = load_result.seconds;
+            result.p50_ns = load_result.p50_ns;
+            result.p99_ns = load_result.p99_ns;
+            result.peak_rss_kb = GetPeakRssKb();
+            result.results = load_result.results;
+            result.PrintJson(out);
+        }
+        query_server.Stop();
+        server_thread.join();
+    }
+
+    // замена последнего слова в документах из середины корпуса: обновление на месте, затем возврат удалением и добавлением.
+    // Длина документа не меняется, поэтому частоты остальных слов остаются прежними
+    {
+        const size_t update_count = min(config.query_count, document_count / 10);
+        vector<string> edited_texts;
+        for (size_t i = 0; i < update_count; ++i) {
+            const string& text = documents[document_count / 2 + i].text;
+            edited_texts.push_back(text.substr(0, text.rfind(' ') + 1) + corpus.GetWord(STOP_WORD_COUNT + i % 100));
+        }
+        Measure("update_document_edit"s, document_count, update_count, [&](size_t i) {
+            const SyntheticDocument& document = documents[document_count / 2 + i];
+            search_server.UpdateDocument(document.id, edited_texts[i], document.status, document.ratings);
+            return size_t{ 1 };
+        }).PrintJson(out);
+        Measure("remove_add_document_edit"s, document_count, update_count, [&](size_t i) {
+            const SyntheticDocument& document = documents[document_count / 2 + i];
+            search_server.RemoveDocument(document.id);
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            return size_t{ 1 };
+        }).PrintJson(out);
+        // статус меняется туда и обратно
+        Measure("set_document_status"s, document_count, 2 * update_count, [&](size_t i) {
+            const SyntheticDocument& document = documents[document_count / 2 + i / 2];
+            const DocumentStatus other_status = document.status == DocumentStatus::ACTUAL ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            search_server.SetDocumentStatus(document.id, i % 2 == 0 ? other_status : document.status);
+            return size_t{ 1 };
+        }).PrintJson(out);
+    }
+
+    // удаляем по десятой части корпуса (но не больше числа запросов) каждой версией
+    const size_t remove_count = min(config.query_count, document_count / 10);
+    Measure("remove_document_seq"s, document_count, remove_count, [&](size_t i) {
+        search_server.RemoveDocument(execution::seq, documents[i].id);
+        return size_t{ 1 };
+    }).PrintJson(out);
+    Measure("remove_document_par"s, document_count, remove_count, [&](size_t i) {
+        search_server.RemoveDocument(execution::par, documents[remove_count + i].id);
+        return size_t{ 1 };
+    }).PrintJson(out);
+    Measure("remove_document_adaptive"s, document_count, remove_count, [&](size_t i) {
+        search_server.RemoveDocument(adaptive_execution, documents[2 * remove_count + i].id);
+        return size_t{ 1 };
+    }).PrintJson(out);
+    // какими путями прошли вызовы с adaptive_execution во всех замерах выше
+    search_server.GetAdaptiveExecutionStatistics().PrintJson("adaptive_execution_paths", out);
+
+    // каждый десятый документ небольшого корпуса добавляется дважды
+    const size_t duplicates_document_count = min(config.duplicates_document_count, document_count);
+    SearchServer duplicates_server(corpus.GetStopWords());
+    for (size_t i = 0; i < duplicates_document_count; ++i) {
+        const SyntheticDocument& document = documents[i];
+        duplicates_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        if (i % 10 == 0) {
+            duplicates_server.AddDocument(static_cast<int>(document_count + i), document.text, document.status, document.ratings);
+        }
+    }
+    Measure("remove_duplicates"s, duplicates_server.GetDocumentCount(), 1, [&](size_t) {
+        ostringstream ignored_output;
+        StreamRedirect redirect(cout, ignored_output.rdbuf());
+        const int count_before = duplicates_server.GetDocumentCount();
+        RemoveDuplicates(duplicates_server);
+        return static_cast<size_t>(count_before - duplicates_server.GetDocumentCount());
+    }).PrintJson(out);
+
+    RunFuzzyBenchmark(config, out);
+}
+
+void RunMemoryBenchmark(const BenchmarkConfig& config, ostream& out) {
+    const size_t MIN_CORPUS_DIVISOR = 8;
+    for (size_t divisor = MIN_CORPUS_DIVISOR; divisor >= 1; divisor /= 2) {
+        BenchmarkConfig corpus_config = config;
+        corpus_config.document_count = config.document_count / divisor;
+        if (corpus_config.document_count == 0) {
+            continue;
+        }
+        const SyntheticCorpus corpus(corpus_config);
+        SearchServer search_server(corpus.GetStopWords());
+        for (const SyntheticDocument& document : corpus.GetDocuments()) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        search_server.GetMemoryReport().PrintJson("memory"s, out);
+    }
+}
@@ -0,0 +1,134 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+
+/*
+ *
+ * Воспроизводимый бенчмарк поисковой системы на синтетическом корпусе.
+ * Частоты слов подчиняются закону Ципфа, корпус и запросы полностью
+ * определяются параметрами и seed. Результаты печатаются в формате JSON Lines,
+ * по одной строке на замер, чтобы их можно было сравнивать между версиями.
+ *
+ */
+
+struct BenchmarkConfig {
+    size_t document_count = 10000;
+    size_t vocabulary_size = 50000;
+    size_t min_document_words = 5;
+    size_t max_document_words = 30;
+    double zipf_exponent = 1.0;
+    size_t query_count = 1000;
+    // RemoveDuplicates квадратичен по числу документов, поэтому меряется на отдельном небольшом корпусе
+    size_t duplicates_document_count = 1000;
+    // нечеткий поиск меряется на отдельном словаре из случайных слов, близком по размеру к реальным
+    size_t fuzzy_vocabulary_size = 2000000;
+    uint64_t seed = 42;
+};
+
+/*
+ *
+ * Разбор параметров вида key=value (docs, vocabulary, min_words, max_words, zipf,
+ * queries, duplicates_docs, fuzzy_vocabulary, seed). Неизвестный ключ - исключение invalid_argument.
+ *
+ */
+
+BenchmarkConfig ParseBenchmarkConfig(const std::vector<std::string>& args);
+
+/*
+ *
+ * Распределение Ципфа на рангах [0, size): P(rank) ~ 1 / (rank + 1)^exponent
+ *
+ */
+
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent);
+
+    size_t operator()(std::mt19937_64& generator) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+struct SyntheticDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+enum class QueryKind {
+    SHORT,              // 1-2 плюс слова
+    LONG,               // 5-10 плюс слов
+    WITH_MINUS_WORDS,   // 2-4 плюс слова и 1-2 минус слова
+    CONJUNCTIVE,        // 2-4 обязательных слова ("+word")
+    PREFIX,             // слово без последней буквы с оператором "word*"
+    MISSPELLED,         // 1-2 слова, в каждом одна буква заменена случайной
+    SKEWED,             // одно из SKEWED_QUERY_WORD_COUNT самых частых слов и 2-4 плюс слова
+};
+
+class SyntheticCorpus {
+public:
+    explicit SyntheticCorpus(const BenchmarkConfig& config);
+
+    const std::string& GetStopWords() const;
+
+    const std::vector<SyntheticDocument>& GetDocuments() const;
+
+    std::vector<std::string> GenerateQueries(QueryKind kind, size_t count, uint64_t seed) const;
+
+    // фразы ("w1 w2") или запросы "w1 NEAR/3 w2" из слов, стоящих рядом в документах корпуса
+    std::vector<std::string> GeneratePositionalQueries(bool is_phrase, size_t count, uint64_t seed) const;
+
+    // слово словаря по рангу частоты
+    const std::string& GetWord(size_t rank) const;
+
+private:
+    std::vector<std::string> vocabulary_;
+    ZipfDistribution word_distribution_;
+    std::string stop_words_;
+    std::vector<SyntheticDocument> documents_;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    size_t document_count = 0;
+    size_t operations = 0;
+    double seconds = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    long peak_rss_kb = 0;
+    // размер построенной структуры, если замер его измеряет
+    size_t bytes = 0;
+    // суммарное число найденных документов/слов: одинаковые корпус и запросы должны давать одинаковое значение
+    size_t results = 0;
+    // прирост текущего RSS и промахи dTLB, если замер их измеряет
+    std::optional<long> rss_growth_kb;
+    std::optional<uint64_t> dtlb_misses;
+
+    void PrintJson(std::ostream& out) const;
+};
+
+// пиковое потребление памяти процессом
+long GetPeakRssKb();
+
+// текущее потребление памяти процессом
+long GetCurrentRssKb();
+
+void RunSearchBenchmark(const BenchmarkConfig& config, std::ostream& out);
+
+/*
+ *
+ * Отчет о памяти индекса (SearchServer::GetMemoryReport) на корпусах из 1/8, 1/4, 1/2 и всех
+ * config.document_count документов, по строке JSON на размер корпуса
+ *
+ */
+
+void RunMemoryBenchmark(const BenchmarkConfig& config, std::ostream& out);
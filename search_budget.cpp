@@ -0,0 +1,47 @@
+#include "search_budget.h"
+
+using namespace std;
+
+SearchBudget SearchBudget::WithTimeout(Clock::duration timeout) {
+    SearchBudget budget;
+    budget.deadline = Clock::now() + timeout;
+    return budget;
+}
+
+SearchBudget SearchBudget::WithPostings(size_t max_postings) {
+    SearchBudget budget;
+    budget.max_postings = max_postings;
+    return budget;
+}
+
+SearchBudgetTracker::SearchBudgetTracker(const SearchBudget& budget)
+    : budget_(budget) {
+}
+
+bool SearchBudgetTracker::Consume(size_t posting_count) {
+    if (IsExhausted()) {
+        return false;
+    }
+    if (budget_.deadline && SearchBudget::Clock::now() >= *budget_.deadline) {
+        deadline_exceeded_.store(true, memory_order_relaxed);
+        return false;
+    }
+    const size_t consumed = postings_.fetch_add(posting_count, memory_order_relaxed);
+    if (budget_.max_postings > 0 && consumed >= budget_.max_postings) {
+        postings_budget_exceeded_.store(true, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool SearchBudgetTracker::IsExhausted() const {
+    return IsDeadlineExceeded() || IsPostingsBudgetExceeded();
+}
+
+bool SearchBudgetTracker::IsDeadlineExceeded() const {
+    return deadline_exceeded_.load(memory_order_relaxed);
+}
+
+bool SearchBudgetTracker::IsPostingsBudgetExceeded() const {
+    return postings_budget_exceeded_.load(memory_order_relaxed);
+}
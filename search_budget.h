@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+
+/*
+ *
+ * Ограничение одного поиска: крайний срок и/или число постингов, которые можно обойти.
+ * Без ограничений поиск идет до конца.
+ *
+ */
+
+struct SearchBudget {
+    using Clock = std::chrono::steady_clock;
+
+    std::optional<Clock::time_point> deadline;
+    // 0 - без ограничения
+    size_t max_postings = 0;
+
+    static SearchBudget WithTimeout(Clock::duration timeout);
+
+    static SearchBudget WithPostings(size_t max_postings);
+};
+
+/*
+ *
+ * Результат поиска с бюджетом. is_partial - бюджет кончился раньше, чем обход постингов,
+ * и documents - лучшие документы по уже пройденным постингам.
+ *
+ */
+
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
+
+/*
+ *
+ * Учет бюджета во время обхода. Постинги списываются блоками по BLOCK_SIZE,
+ * время проверяется один раз на блок, так что бюджет может быть превышен не больше чем на блок.
+ * Списывать можно одновременно из нескольких потоков.
+ *
+ */
+
+class SearchBudgetTracker {
+public:
+    static const size_t BLOCK_SIZE = 256;
+
+    explicit SearchBudgetTracker(const SearchBudget& budget);
+
+    // списывает блок из posting_count постингов; false - бюджет исчерпан и блок обходить не нужно
+    bool Consume(size_t posting_count);
+
+    bool IsExhausted() const;
+
+    bool IsDeadlineExceeded() const;
+
+    bool IsPostingsBudgetExceeded() const;
+
+private:
+    const SearchBudget budget_;
+    std::atomic<size_t> postings_{ 0 };
+    std::atomic<bool> deadline_exceeded_{ false };
+    std::atomic<bool> postings_budget_exceeded_{ false };
+};
@@ -0,0 +1,207 @@
+﻿#include <functional>
+#include <thread>
+
+#include "search_metrics.h"
+
+using namespace std;
+
+namespace {
+
+const int SUB_BUCKET_BITS = 3;
+const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+const uint64_t MAX_TRACKED_VALUE = (uint64_t{ 1 } << 48) - 1;
+
+void UpdateMax(atomic<uint64_t>& max_value, uint64_t value) {
+    uint64_t current = max_value.load(memory_order_relaxed);
+    while (current < value && !max_value.compare_exchange_weak(current, value, memory_order_relaxed)) {
+    }
+}
+
+uint64_t GetPercentile(const array<uint64_t, LatencyHistogram::BUCKET_COUNT>& buckets, uint64_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = static_cast<uint64_t>(percentile * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int bucket_index = 0; bucket_index < LatencyHistogram::BUCKET_COUNT; ++bucket_index) {
+        seen += buckets[bucket_index];
+        if (seen >= rank) {
+            return LatencyHistogram::GetBucketUpperBound(bucket_index);
+        }
+    }
+    return LatencyHistogram::GetBucketUpperBound(LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+}  // namespace
+
+const char* GetStageName(SearchStage stage) {
+    switch (stage) {
+    case SearchStage::PARSE:
+        return "parse";
+    case SearchStage::POSTINGS:
+        return "postings";
+    case SearchStage::MINUS_WORDS:
+        return "minus_words";
+    case SearchStage::TOP_K:
+        return "top_k";
+    case SearchStage::PREDICATE:
+        return "predicate";
+    case SearchStage::TOTAL:
+        return "total";
+    }
+    return "unknown";
+}
+
+const char* GetCounterName(SearchCounter counter) {
+    switch (counter) {
+    case SearchCounter::POSTINGS_TOUCHED:
+        return "postings_touched";
+    case SearchCounter::CANDIDATES_SCORED:
+        return "candidates_scored";
+    case SearchCounter::DEADLINE_EXCEEDED:
+        return "deadline_exceeded";
+    case SearchCounter::POSTINGS_BUDGET_EXCEEDED:
+        return "postings_budget_exceeded";
+    }
+    return "unknown";
+}
+
+void SearchMetricsReport::PrintText(ostream& out) const {
+    for (int stage = 0; stage < SEARCH_STAGE_COUNT; ++stage) {
+        const StageStatistics& statistics = stages[stage];
+        out << GetStageName(static_cast<SearchStage>(stage)) << ": count = "s << statistics.count
+            << ", total = "s << statistics.total_ns << " ns"s
+            << ", p50 = "s << statistics.p50_ns << " ns"s
+            << ", p90 = "s << statistics.p90_ns << " ns"s
+            << ", p99 = "s << statistics.p99_ns << " ns"s
+            << ", p99.9 = "s << statistics.p999_ns << " ns"s
+            << ", max = "s << statistics.max_ns << " ns"s << endl;
+    }
+    for (int counter = 0; counter < SEARCH_COUNTER_COUNT; ++counter) {
+        out << GetCounterName(static_cast<SearchCounter>(counter)) << " = "s << counters[counter] << endl;
+    }
+}
+
+void SearchMetricsReport::PrintJson(ostream& out) const {
+    out << "{\"stages\":{"s;
+    for (int stage = 0; stage < SEARCH_STAGE_COUNT; ++stage) {
+        const StageStatistics& statistics = stages[stage];
+        out << (stage > 0 ? ","s : ""s)
+            << "\""s << GetStageName(static_cast<SearchStage>(stage)) << "\":{"s
+            << "\"count\":"s << statistics.count
+            << ",\"total_ns\":"s << statistics.total_ns
+            << ",\"p50_ns\":"s << statistics.p50_ns
+            << ",\"p90_ns\":"s << statistics.p90_ns
+            << ",\"p99_ns\":"s << statistics.p99_ns
+            << ",\"p999_ns\":"s << statistics.p999_ns
+            << ",\"max_ns\":"s << statistics.max_ns << "}"s;
+    }
+    out << "},\"counters\":{"s;
+    for (int counter = 0; counter < SEARCH_COUNTER_COUNT; ++counter) {
+        out << (counter > 0 ? ","s : ""s)
+            << "\""s << GetCounterName(static_cast<SearchCounter>(counter)) << "\":"s << counters[counter];
+    }
+    out << "}}"s;
+}
+
+int LatencyHistogram::GetBucketIndex(uint64_t value_ns) {
+    if (value_ns < SUB_BUCKET_COUNT) {
+        return static_cast<int>(value_ns);
+    }
+    value_ns = min(value_ns, MAX_TRACKED_VALUE);
+    const int exponent = 63 - __builtin_clzll(value_ns);
+    const int sub_bucket = static_cast<int>(value_ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(int bucket_index) {
+    if (bucket_index < SUB_BUCKET_COUNT) {
+        return static_cast<uint64_t>(bucket_index);
+    }
+    const int exponent = bucket_index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+    const uint64_t sub_bucket = bucket_index % SUB_BUCKET_COUNT;
+    const uint64_t width = uint64_t{ 1 } << (exponent - SUB_BUCKET_BITS);
+    return (SUB_BUCKET_COUNT + sub_bucket) * width + width - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value_ns) {
+    buckets_[GetBucketIndex(value_ns)].fetch_add(1, memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::MergeTo(array<uint64_t, BUCKET_COUNT>& buckets) const {
+    for (int bucket_index = 0; bucket_index < BUCKET_COUNT; ++bucket_index) {
+        buckets[bucket_index] += buckets_[bucket_index].load(memory_order_relaxed);
+    }
+}
+
+SearchMetrics::StageTimer::StageTimer(SearchMetrics& metrics, SearchStage stage)
+    : metrics_(metrics)
+    , stage_(stage) {
+}
+
+SearchMetrics::StageTimer::~StageTimer() {
+    const auto duration = Clock::now() - start_time_;
+    metrics_.RecordStage(stage_, chrono::duration_cast<chrono::nanoseconds>(duration).count());
+}
+
+void SearchMetrics::RecordStage(SearchStage stage, uint64_t duration_ns) {
+    Shard& shard = GetThreadShard();
+    const int stage_index = static_cast<int>(stage);
+    shard.histograms[stage_index].Record(duration_ns);
+    shard.total_ns[stage_index].fetch_add(duration_ns, memory_order_relaxed);
+    UpdateMax(shard.max_ns[stage_index], duration_ns);
+}
+
+void SearchMetrics::Add(SearchCounter counter, uint64_t value) {
+    GetThreadShard().counters[static_cast<int>(counter)].fetch_add(value, memory_order_relaxed);
+}
+
+void SearchMetrics::Reset() {
+    for (Shard& shard : shards_) {
+        for (int stage = 0; stage < SEARCH_STAGE_COUNT; ++stage) {
+            shard.histograms[stage].Reset();
+            shard.total_ns[stage].store(0, memory_order_relaxed);
+            shard.max_ns[stage].store(0, memory_order_relaxed);
+        }
+        for (auto& counter : shard.counters) {
+            counter.store(0, memory_order_relaxed);
+        }
+    }
+}
+
+SearchMetricsReport SearchMetrics::BuildReport() const {
+    SearchMetricsReport report;
+    for (int stage = 0; stage < SEARCH_STAGE_COUNT; ++stage) {
+        array<uint64_t, LatencyHistogram::BUCKET_COUNT> buckets{};
+        StageStatistics& statistics = report.stages[stage];
+        for (const Shard& shard : shards_) {
+            shard.histograms[stage].MergeTo(buckets);
+            statistics.total_ns += shard.total_ns[stage].load(memory_order_relaxed);
+            statistics.max_ns = max(statistics.max_ns, shard.max_ns[stage].load(memory_order_relaxed));
+        }
+        for (const uint64_t bucket : buckets) {
+            statistics.count += bucket;
+        }
+        statistics.p50_ns = GetPercentile(buckets, statistics.count, 0.5);
+        statistics.p90_ns = GetPercentile(buckets, statistics.count, 0.9);
+        statistics.p99_ns = GetPercentile(buckets, statistics.count, 0.99);
+        statistics.p999_ns = GetPercentile(buckets, statistics.count, 0.999);
+    }
+    for (const Shard& shard : shards_) {
+        for (int counter = 0; counter < SEARCH_COUNTER_COUNT; ++counter) {
+            report.counters[counter] += shard.counters[counter].load(memory_order_relaxed);
+        }
+    }
+    return report;
+}
+
+SearchMetrics::Shard& SearchMetrics::GetThreadShard() {
+    thread_local const size_t shard_index = hash<thread::id>{}(this_thread::get_id()) % SHARD_COUNT;
+    return shards_[shard_index];
+}
@@ -0,0 +1,138 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+/*
+ *
+ * Метрики поисковой системы: гистограммы времени по этапам запроса и счетчики.
+ * Сбор включается макросом SEARCH_SERVER_METRICS при сборке; без него макросы
+ * SEARCH_METRICS_STAGE и SEARCH_METRICS_ADD ничего не делают, а отчет пустой.
+ *
+ */
+
+enum class SearchStage {
+    PARSE,          // разбор запроса
+    POSTINGS,       // обход постингов плюс слов
+    MINUS_WORDS,    // исключение документов с минус словами
+    TOP_K,          // сортировка и отбор лучших документов
+    PREDICATE,      // проверка пользовательского предиката
+    TOTAL,          // весь вызов FindTopDocuments
+};
+
+const int SEARCH_STAGE_COUNT = 6;
+
+enum class SearchCounter {
+    POSTINGS_TOUCHED,
+    CANDIDATES_SCORED,
+    DEADLINE_EXCEEDED,          // поиски с бюджетом, прерванные по крайнему сроку
+    POSTINGS_BUDGET_EXCEEDED,   // поиски с бюджетом, прерванные по числу постингов
+};
+
+const int SEARCH_COUNTER_COUNT = 4;
+
+struct StageStatistics {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+struct SearchMetricsReport {
+    std::array<StageStatistics, SEARCH_STAGE_COUNT> stages;
+    std::array<uint64_t, SEARCH_COUNTER_COUNT> counters{};
+
+    void PrintText(std::ostream& out) const;
+
+    void PrintJson(std::ostream& out) const;
+};
+
+const char* GetStageName(SearchStage stage);
+
+const char* GetCounterName(SearchCounter counter);
+
+/*
+ *
+ * Лог-линейная гистограмма (в духе HDR Histogram): 8 корзин на каждую степень двойки,
+ * то есть погрешность не больше 12.5%. Запись - одно relaxed атомарное сложение.
+ *
+ */
+
+class LatencyHistogram {
+public:
+    static const int BUCKET_COUNT = 368;
+
+    void Record(uint64_t value_ns);
+
+    void Reset();
+
+    // прибавляет корзины этой гистограммы к buckets
+    void MergeTo(std::array<uint64_t, BUCKET_COUNT>& buckets) const;
+
+    static int GetBucketIndex(uint64_t value_ns);
+
+    // верхняя граница значений корзины
+    static uint64_t GetBucketUpperBound(int bucket_index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+};
+
+class SearchMetrics {
+public:
+    class StageTimer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        StageTimer(SearchMetrics& metrics, SearchStage stage);
+
+        ~StageTimer();
+
+    private:
+        SearchMetrics& metrics_;
+        const SearchStage stage_;
+        const Clock::time_point start_time_ = Clock::now();
+    };
+
+    void RecordStage(SearchStage stage, uint64_t duration_ns);
+
+    void Add(SearchCounter counter, uint64_t value);
+
+    void Reset();
+
+    // сливает данные всех потоков
+    SearchMetricsReport BuildReport() const;
+
+private:
+    static const size_t SHARD_COUNT = 8;
+
+    // у каждого потока свой шард, поэтому запись почти не конкурирует за кэш-линии
+    struct alignas(64) Shard {
+        std::array<LatencyHistogram, SEARCH_STAGE_COUNT> histograms;
+        std::array<std::atomic<uint64_t>, SEARCH_STAGE_COUNT> total_ns{};
+        std::array<std::atomic<uint64_t>, SEARCH_STAGE_COUNT> max_ns{};
+        std::array<std::atomic<uint64_t>, SEARCH_COUNTER_COUNT> counters{};
+    };
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    Shard& GetThreadShard();
+};
+
+#define SEARCH_METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define SEARCH_METRICS_CONCAT(X, Y) SEARCH_METRICS_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_METRICS
+#define SEARCH_METRICS_STAGE(metrics, stage) \
+    SearchMetrics::StageTimer SEARCH_METRICS_CONCAT(stageTimer, __LINE__)(metrics, stage)
+#define SEARCH_METRICS_ADD(metrics, counter, value) (metrics).Add(counter, value)
+#else
+#define SEARCH_METRICS_STAGE(metrics, stage)
+#define SEARCH_METRICS_ADD(metrics, counter, value)
+#endif
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "search_page.h"
+
+using namespace std;
+
+bool IsBeforeOnPage(const Document& lhs, const Document& rhs) {
+    if (lhs.relevance != rhs.relevance) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+bool IsAfterCursor(const Document& document, const SearchCursor& cursor) {
+    return IsBeforeOnPage({ cursor.document_id, cursor.relevance, cursor.rating }, document);
+}
+
+SearchCursor MakeSearchCursor(const Document& document) {
+    return { document.relevance, document.rating, document.id };
+}
+
+SearchPageCollector::SearchPageCollector(const optional<SearchCursor>& cursor, size_t page_size)
+    : cursor_(cursor)
+    , page_size_(page_size) {
+    if (page_size == 0) {
+        throw invalid_argument("Page size must be positive"s);
+    }
+}
+
+void SearchPageCollector::Add(const Document& document) {
+    if (cursor_ && !IsAfterCursor(document, *cursor_)) {
+        return;
+    }
+    if (heap_.size() <= page_size_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsBeforeOnPage);
+    }
+    else if (IsBeforeOnPage(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsBeforeOnPage);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsBeforeOnPage);
+    }
+}
+
+SearchPage SearchPageCollector::Finish() {
+    SearchPage page;
+    sort_heap(heap_.begin(), heap_.end(), IsBeforeOnPage);
+    if (heap_.size() > page_size_) {
+        heap_.resize(page_size_);
+        page.next_cursor = MakeSearchCursor(heap_.back());
+    }
+    page.documents = move(heap_);
+    heap_.clear();
+    return page;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+
+/*
+ *
+ * Курсор постраничного поиска: последний документ выданной страницы. Следующая страница начинается
+ * с документов, стоящих после него, поэтому ее можно получить, не считая заново предыдущие страницы.
+ * Курсор нужно передавать с тем же запросом и фильтром, с которыми получена страница.
+ *
+ */
+
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = 0;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // курсор для следующей страницы, если после этой есть еще документы
+    std::optional<SearchCursor> next_cursor;
+};
+
+/*
+ *
+ * Порядок документов на страницах: по убыванию релевантности, затем рейтинга, затем по возрастанию id.
+ * В отличие от IsRankedHigher, релевантности сравниваются точно, так что порядок строгий
+ * и каждый документ попадает ровно на одну страницу.
+ *
+ */
+
+bool IsBeforeOnPage(const Document& lhs, const Document& rhs);
+
+bool IsAfterCursor(const Document& document, const SearchCursor& cursor);
+
+SearchCursor MakeSearchCursor(const Document& document);
+
+/*
+ *
+ * Страница, собираемая по мере ранжирования: документы не после курсора отбрасываются сразу,
+ * из остальных в куче хранятся только page_size + 1 первых в порядке IsBeforeOnPage
+ * (лишний документ означает, что есть следующая страница). Память и время выбора страницы
+ * не зависят от того, сколько страниц уже выдано.
+ *
+ */
+
+class SearchPageCollector {
+public:
+    SearchPageCollector(const std::optional<SearchCursor>& cursor, size_t page_size);
+
+    void Add(const Document& document);
+
+    // страница в порядке IsBeforeOnPage; после вызова коллектор пуст
+    SearchPage Finish();
+
+private:
+    std::optional<SearchCursor> cursor_;
+    size_t page_size_;
+    // куча по IsBeforeOnPage: в вершине - документ, стоящий на странице последним
+    std::vector<Document> heap_;
+};
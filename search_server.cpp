@@ -1,10 +1,14 @@
 ﻿#include <stdexcept>
+#include <climits>
 #include <cmath>
 #include <execution>
+#include <limits>
 #include <string_view>
+#include <unordered_map>
 
 
 #include "search_server.h"
+#include "score_accumulator.h"
 
 using namespace std;
 
@@ -26,13 +30,27 @@ void SearchServer::AddDocument(int document_id, string_view document, DocumentSt
     const auto it_inserted_word = save_text.emplace(save_text.end(), string(document));
     const auto words = SplitIntoWordsNoStop(*it_inserted_word);
 
-    documents_data_.emplace(document_id, DocumentInformation{ ComputeAverageRating(ratings), status, *it_inserted_word });
+    const int rating = ComputeAverageRating(ratings);
+    document_ratings_.Set(document_id, rating);
+    document_lengths_.Set(document_id, static_cast<int>(words.size()));
+    total_document_length_ += words.size();
+    rating_to_document_ids_.emplace(rating, document_id);
 
+    vector<int> term_ids;
     const double inv_word_count = 1.0 / words.size();
     for (const string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        id_word_frequencies_[document_id][word] += inv_word_count;
+        term_ids.push_back(AddTerm(word));
+        id_word_frequencies_.try_emplace(document_id, word_frequencies_allocator_).first->second[word] += inv_word_count;
     }
+
+    sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    for (const int term_id : term_ids) {
+        const double term_freq = id_word_frequencies_.at(document_id).at(term_id_to_word_[term_id]);
+        InsertPosting(term_postings_[term_id], StatusIndex(status), document_id, term_freq, words.size());
+    }
+    DocumentPositions positions = positional_index_enabled_ ? BuildDocumentPositions(*it_inserted_word, term_ids) : DocumentPositions();
+    documents_data_.emplace(document_id, DocumentInformation{ status, *it_inserted_word, save_text.size() - 1, move(term_ids), move(positions) });
     
     document_ids_.insert(document_id);
 }
@@ -41,77 +59,233 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentS
     return FindTopDocuments(std::execution::seq, raw_query, status);
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
-    return FindTopDocuments(std::execution::seq, raw_query);
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter);
 }
 
-int SearchServer::GetDocumentCount() const {
-    return documents_data_.size();
+SearchResult SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter, const SearchBudget& budget) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter, budget);
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
-    return MatchDocument(execution::seq, raw_query, document_id);
+SearchPage SearchServer::FindTopDocumentsPage(string_view raw_query, const DocumentFilter& filter,
+    const optional<SearchCursor>& cursor, size_t page_size) const {
+    return FindTopDocumentsPage(std::execution::seq, raw_query, filter, cursor, page_size);
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, string_view raw_query, int document_id) const {
-    const Query query = ParseQuery(raw_query);
-    vector<string_view> words;
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(std::execution::seq, raw_query);
+}
 
-    for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string_view>& raw_queries,
+    const vector<DocumentFilter>& filters) const {
+    if (raw_queries.size() != filters.size()) {
+        throw invalid_argument("Each query in a batch needs its own filter"s);
+    }
+    vector<vector<Document>> results(raw_queries.size());
+    vector<Query> queries(raw_queries.size());
+    vector<size_t> batched_queries;
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        queries[i] = ParseQuery(raw_queries[i]);
+        if (CanEvaluateInBatch(queries[i], filters[i])) {
+            batched_queries.push_back(i);
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { words, documents_data_.at(document_id).document_status };
+        else {
+            results[i] = FindTopDocuments(std::execution::seq, raw_queries[i], filters[i]);
         }
     }
+    if (batched_queries.empty()) {
+        return results;
+    }
 
-    for (const string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    const TfIdfRanking ranking;
+    const RankingStatistics statistics = GetRankingStatistics();
+    // релевантность запроса j части пакета - scores[j * score_count + id], NaN - документ не найден;
+    // если плотный массив даже одного запроса больше BATCH_DENSE_SCORES_MAX_BYTES - sparse_scores[j][id]
+    const size_t score_count = document_ids_.empty() ? 1 : static_cast<size_t>(*document_ids_.rbegin()) + 1;
+    const size_t dense_query_count = BATCH_DENSE_SCORES_MAX_BYTES / (score_count * sizeof(double));
+    const bool dense = dense_query_count > 0;
+    const size_t chunk_size = min({ BATCH_QUERY_CHUNK_SIZE, batched_queries.size(), dense ? dense_query_count : numeric_limits<size_t>::max() });
+    vector<double> scores(dense ? chunk_size * score_count : 0, numeric_limits<double>::quiet_NaN());
+    vector<unordered_map<int, double>> sparse_scores(dense ? 0 : chunk_size);
+    const auto get_score = [&](size_t j, int document_id) -> double& {
+        if (dense) {
+            return scores[j * score_count + document_id];
+        }
+        return sparse_scores[j].try_emplace(document_id, numeric_limits<double>::quiet_NaN()).first->second;
+    };
+    vector<vector<int>> found_documents(chunk_size);
+    vector<pair<size_t, double>> status_queries;
+    vector<double> relevances;
+
+    for (size_t chunk_begin = 0; chunk_begin < batched_queries.size(); chunk_begin += chunk_size) {
+        const size_t chunk_end = min(chunk_begin + chunk_size, batched_queries.size());
+        // слово -> запросы части, в которых оно плюс слово; слова по возрастанию,
+        // поэтому вклады в релевантность складываются в том же порядке, что и при поиске по одному запросу
+        map<string_view, vector<size_t>> word_to_queries;
+        for (size_t j = chunk_begin; j < chunk_end; ++j) {
+            for (string_view word : queries[batched_queries[j]].plus_words) {
+                word_to_queries[word].push_back(j - chunk_begin);
+            }
+        }
+
+        {
+            SEARCH_METRICS_STAGE(*metrics_, SearchStage::POSTINGS);
+            for (const auto& [word, chunk_queries] : word_to_queries) {
+                const WordPostings* postings = FindPostings(word);
+                if (postings == nullptr) {
+                    continue;
+                }
+                for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                    status_queries.clear();
+                    for (const size_t j : chunk_queries) {
+                        const size_t query_index = batched_queries[chunk_begin + j];
+                        if (filters[query_index].statuses.test(status)) {
+                            status_queries.push_back({ j, ComputeTermWeight(ranking, statistics, queries[query_index], word, *postings) });
+                        }
+                    }
+                    if (status_queries.empty()) {
+                        continue;
+                    }
+                    SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, postings->by_status[status].size());
+                    for (const auto [document_id, term_freq] : postings->by_status[status]) {
+                        for (const auto& [j, term_weight] : status_queries) {
+                            double& score = get_score(j, document_id);
+                            if (isnan(score)) {
+                                score = 0.0;
+                                found_documents[j].push_back(document_id);
+                            }
+                            score += ScorePosting(ranking, statistics, term_weight, document_id, term_freq);
+                        }
+                    }
+                }
+            }
         }
-        for (const auto &[id, _] : word_to_document_freqs_.at(word)) {
-            if (document_id == id)
-                words.push_back(word);
+
+        for (size_t j = 0; j < chunk_end - chunk_begin; ++j) {
+            const size_t query_index = batched_queries[chunk_begin + j];
+            const DocumentIdBitmap minus_documents = CollectMinusDocuments(queries[query_index], filters[query_index]);
+            relevances.clear();
+            for (const int document_id : found_documents[j]) {
+                if (minus_documents.Contains(document_id)) {
+                    get_score(j, document_id) = numeric_limits<double>::quiet_NaN();
+                }
+                else {
+                    relevances.push_back(get_score(j, document_id));
+                }
+            }
+            SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, relevances.size());
+            // в топ попадут только документы не ниже MAX_RESULT_DOCUMENT_COUNT-й релевантности
+            // (с точностью сравнения SortTopDocuments), остальные не сортируем
+            double min_relevance = -numeric_limits<double>::infinity();
+            if (relevances.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                nth_element(relevances.begin(), relevances.begin() + (MAX_RESULT_DOCUMENT_COUNT - 1), relevances.end(), greater<>());
+                min_relevance = relevances[MAX_RESULT_DOCUMENT_COUNT - 1] - 1e-6;
+            }
+            // как и при поиске по одному запросу, документы до сортировки идут по возрастанию id
+            sort(found_documents[j].begin(), found_documents[j].end());
+            vector<Document>& documents = results[query_index];
+            for (const int document_id : found_documents[j]) {
+                double& relevance = get_score(j, document_id);
+                if (relevance >= min_relevance) {
+                    documents.push_back({ document_id, relevance, document_ratings_.Get(document_id) });
+                }
+                relevance = numeric_limits<double>::quiet_NaN();
+            }
+            found_documents[j].clear();
+            if (!dense) {
+                sparse_scores[j].clear();
+            }
+            SortTopDocuments(std::execution::seq, documents);
         }
     }
+    return results;
+}
 
-    return { words, documents_data_.at(document_id).document_status };  
+int SearchServer::GetDocumentCount() const {
+    return documents_data_.size();
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&, string_view raw_query, int document_id) const {
-    const Query query = ParseQuery(raw_query);
-    vector<string_view> matched_words;
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return MatchDocument(execution::seq, raw_query, document_id);
+}
 
-    const auto status = documents_data_.at(document_id).document_status;
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy& policy, string_view raw_query, int document_id) const {
+    return MatchCompiledQuery(policy, CompileQuery(ParseQuery(raw_query)), document_id);
+}
 
-    //функция которая проверяет, есть ли в множетве минус/плюс слов слова в общей базе данных и соотвественно id документа
-    const auto word_checker =
-        [this, document_id](string_view word) {
-        const auto it = word_to_document_freqs_.find(word);
-        return it != word_to_document_freqs_.end() && it->second.count(document_id);
-    };
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, string_view raw_query, int document_id) const {
+    return MatchCompiledQuery(policy, CompileQuery(ParseQuery(raw_query)), document_id);
+}
 
-    //проходимся по всему диапозону минус слов и проверяем с помощью функции word_checker есть ли минус слово в базе данных
-    if (any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), word_checker)) {
-        return { matched_words, status };
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const AdaptiveExecutionPolicy&, string_view raw_query, int document_id) const {
+    const auto active_call = adaptive_counters_->StartCall();
+    const Query query = ParseQuery(raw_query);
+    const ExecutionPath path = ChooseExecutionPath(query.plus_words.size() + query.minus_words.size(),
+        GetAdaptiveExecutionThresholds().parallel_match_min_words, numeric_limits<size_t>::max(), adaptive_counters_->GetActiveCount());
+    adaptive_counters_->Record(path);
+    if (path == ExecutionPath::SEQUENTIAL) {
+        return MatchCompiledQuery(execution::seq, CompileQuery(query), document_id);
     }
+    return MatchCompiledQuery(execution::par, CompileQuery(query), document_id);
+}
 
-    matched_words.resize(query.plus_words.size());
+vector<SearchServer::MatchDocumentResult> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocuments(execution::seq, raw_query, document_ids);
+}
 
-    //скопируем все плюс слова в отдельный объект с помощью функции word_checker
-    auto words_end = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), word_checker);
-    sort(matched_words.begin(), words_end);
-    
-    //удалим все повторяющие слова в векторе, например (word1, word1, word2) -> (word1, word2) запищется в words_end
-    words_end = unique(matched_words.begin(), words_end);
-    //удаляем
-    matched_words.erase(words_end, matched_words.end());
+vector<SearchServer::MatchDocumentResult> SearchServer::MatchDocuments(const execution::sequenced_policy& policy,
+    string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocumentsImpl(policy, raw_query, document_ids);
+}
 
-    return { matched_words, status };
+vector<SearchServer::MatchDocumentResult> SearchServer::MatchDocuments(const execution::parallel_policy& policy,
+    string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocumentsImpl(policy, raw_query, document_ids);
 }
 
+template <typename ExecutionPolicy>
+vector<SearchServer::MatchDocumentResult> SearchServer::MatchDocumentsImpl(const ExecutionPolicy& policy,
+    string_view raw_query, const vector<int>& document_ids) const {
+    const CompiledQuery query = CompileQuery(ParseQuery(raw_query));
+    vector<MatchDocumentResult> results(document_ids.size());
 
+    // параллелим по документам, матчинг одного документа выполняем последовательно
+    transform(policy, document_ids.begin(), document_ids.end(), results.begin(),
+        [this, &query](int document_id) {
+            return MatchCompiledQuery(execution::seq, query, document_id);
+        });
+    return results;
+}
+
+template <typename ExecutionPolicy>
+SearchServer::MatchDocumentResult SearchServer::MatchCompiledQuery(const ExecutionPolicy& policy, const CompiledQuery& query, int document_id) const {
+    const DocumentInformation& document = documents_data_.at(document_id);
+    vector<string_view> matched_words;
+
+    const auto contains = [&term_ids = document.term_ids](int term_id) {
+        return binary_search(term_ids.begin(), term_ids.end(), term_id);
+    };
+
+    if (any_of(policy, query.minus_term_ids.begin(), query.minus_term_ids.end(), contains)
+        || !all_of(policy, query.required_term_ids.begin(), query.required_term_ids.end(), contains)
+        || !MatchesConstraints(query.constraints, document_id)) {
+        return { matched_words, document.document_status };
+    }
+
+    // copy_if сохраняет порядок, поэтому слова остаются упорядоченными, как в запросе
+    vector<pair<int, string_view>> matched_terms(query.plus_terms.size());
+    const auto terms_end = copy_if(policy, query.plus_terms.begin(), query.plus_terms.end(), matched_terms.begin(),
+        [&contains](const auto& term) {
+            return contains(term.first);
+        });
+    matched_words.resize(terms_end - matched_terms.begin());
+    transform(matched_terms.begin(), terms_end, matched_words.begin(),
+        [](const auto& term) {
+            return term.second;
+        });
+
+    return { matched_words, document.document_status };
+}
 
 int SearchServer::GetDocumentId(int index) const {
     if (index >= 0 && index < GetDocumentCount()) {
@@ -129,7 +303,7 @@ set<int>::iterator SearchServer::end() {
     return document_ids_.end();
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const {
     if (id_word_frequencies_.count(document_id)) {
         return id_word_frequencies_.at(document_id);
     }
@@ -146,19 +320,111 @@ void SearchServer::RemoveDocument(const execution::sequenced_policy&, int docume
         return;
     }
 
-    for (auto it = word_to_document_freqs_.begin(); it != word_to_document_freqs_.end(); ++it) {
-        if (it->second.count(document_id)) {
-            it->second.erase(document_id);
-        }
+    const DocumentInformation& document = documents_data_.at(document_id);
+    const size_t status = StatusIndex(document.document_status);
+    for (const int term_id : document.term_ids) {
+        ErasePosting(term_postings_[term_id], status, document_id);
     }
+    ReleaseDocumentText(document);
 
     documents_data_.erase(document_id);
+    rating_to_document_ids_.erase({ document_ratings_.Get(document_id), document_id });
+    total_document_length_ -= document_lengths_.Get(document_id);
 
     id_word_frequencies_.erase(document_id);
 
     document_ids_.erase(document_id);    
 }
 
+void SearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    DocumentInformation& information = GetDocumentForUpdate(document_id);
+    if (information.text == document) {
+        SetDocumentStatus(document_id, status);
+        SetDocumentRating(document_id, ComputeAverageRating(ratings));
+        return;
+    }
+
+    // некорректный текст должен отвергаться до того, как старый текст освобожден
+    SplitIntoWordsNoStop(document);
+    // новый текст занимает строку старого: частые правки документа не копят в save_text его прежние тексты
+    ReleaseDocumentText(information);
+    string& text = save_text[information.text_index];
+    text = document;
+    const vector<string_view> words = SplitIntoWordsNoStop(text);
+
+    WordFrequencies word_frequencies(word_frequencies_allocator_);
+    vector<int> term_ids;
+    const double inv_word_count = 1.0 / words.size();
+    for (const string_view word : words) {
+        term_ids.push_back(AddTerm(word));
+        word_frequencies[word] += inv_word_count;
+    }
+    sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+
+    // слияние отсортированных id старых и новых слов документа
+    const vector<int>& old_term_ids = information.term_ids;
+    const size_t old_status = StatusIndex(information.document_status);
+    const size_t new_status = StatusIndex(status);
+    size_t old_index = 0;
+    for (const int term_id : term_ids) {
+        for (; old_index < old_term_ids.size() && old_term_ids[old_index] < term_id; ++old_index) {
+            ErasePosting(term_postings_[old_term_ids[old_index]], old_status, document_id);
+        }
+        WordPostings& postings = term_postings_[term_id];
+        const double term_freq = word_frequencies.at(term_id_to_word_[term_id]);
+        if (old_index < old_term_ids.size() && old_term_ids[old_index] == term_id) {
+            ++old_index;
+            if (old_status == new_status && *postings.by_status[old_status].Find(document_id) == term_freq) {
+                // доля слова та же, но при другой длине документа меняется число вхождений - граница BM25 должна его учесть
+                UpdateTermMaxima(postings, term_freq, words.size());
+                continue;
+            }
+            ErasePosting(postings, old_status, document_id);
+        }
+        InsertPosting(postings, new_status, document_id, term_freq, words.size());
+    }
+    for (; old_index < old_term_ids.size(); ++old_index) {
+        ErasePosting(term_postings_[old_term_ids[old_index]], old_status, document_id);
+    }
+
+    total_document_length_ = total_document_length_ - document_lengths_.Get(document_id) + words.size();
+    document_lengths_.Set(document_id, static_cast<int>(words.size()));
+    SetDocumentRating(document_id, ComputeAverageRating(ratings));
+    if (word_frequencies.empty()) {
+        id_word_frequencies_.erase(document_id);
+    }
+    else {
+        id_word_frequencies_.insert_or_assign(document_id, move(word_frequencies));
+    }
+    information.positions = positional_index_enabled_ ? BuildDocumentPositions(text, term_ids) : DocumentPositions();
+    information.document_status = status;
+    information.text = text;
+    information.term_ids = move(term_ids);
+}
+
+void SearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    DocumentInformation& information = GetDocumentForUpdate(document_id);
+    const size_t old_status = StatusIndex(information.document_status);
+    const size_t new_status = StatusIndex(status);
+    if (old_status == new_status) {
+        return;
+    }
+    // карта документов слова общая для всех статусов и не меняется
+    for (const int term_id : information.term_ids) {
+        WordPostings& postings = term_postings_[term_id];
+        const double term_freq = *postings.by_status[old_status].Find(document_id);
+        if (postings.impact_ordered) {
+            const uint8_t impact = PostingList::QuantizeTermFreq(term_freq);
+            (*postings.impact_ordered)[old_status].Erase(document_id, impact);
+            (*postings.impact_ordered)[new_status].Add(document_id, impact);
+        }
+        postings.by_status[old_status].Erase(document_id);
+        postings.by_status[new_status].Add(document_id, term_freq);
+    }
+    information.document_status = status;
+}
+
 void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
     if (!document_ids_.count(document_id)) {
         return;
@@ -166,29 +432,446 @@ void SearchServer::RemoveDocument(const execution::parallel_policy&, int documen
 
     document_ids_.erase(document_id);
 
+    ReleaseDocumentText(documents_data_.at(document_id));
+    const vector<int> term_ids = move(documents_data_.at(document_id).term_ids);
+    const size_t status = StatusIndex(documents_data_.at(document_id).document_status);
     documents_data_.erase(document_id);
+    rating_to_document_ids_.erase({ document_ratings_.Get(document_id), document_id });
+    total_document_length_ -= document_lengths_.Get(document_id);
 
-    const auto& word_freqs = id_word_frequencies_.at(document_id);
-    vector<string_view> words(word_freqs.size());
-
-    transform(execution::par, word_freqs.begin(), word_freqs.end(), words.begin(),
-        [](const auto& item) {
-            return item.first;
-        });
-
-    for_each(execution::par, words.begin(), words.end(), 
-        [this, document_id](string_view word) {
-            word_to_document_freqs_.at(word).erase(document_id);
+    for_each(execution::par, term_ids.begin(), term_ids.end(), 
+        [this, document_id, status](int term_id) {
+            ErasePosting(term_postings_[term_id], status, document_id);
         });
 
     id_word_frequencies_.erase(document_id);
 }
 
+void SearchServer::RemoveDocument(const AdaptiveExecutionPolicy&, int document_id) {
+    const auto active_call = adaptive_counters_->StartCall();
+    const auto document = documents_data_.find(document_id);
+    if (document == documents_data_.end()) {
+        return;
+    }
+    // удаление из постингов сдвигает хвост массива, так что стоимость - суммарная длина постингов слов документа
+    const size_t status = StatusIndex(document->second.document_status);
+    size_t postings_count = 0;
+    for (const int term_id : document->second.term_ids) {
+        postings_count += term_postings_[term_id].by_status[status].size();
+    }
+    const ExecutionPath path = ChooseExecutionPath(postings_count, GetAdaptiveExecutionThresholds().parallel_terms_min_postings,
+        numeric_limits<size_t>::max(), adaptive_counters_->GetActiveCount());
+    adaptive_counters_->Record(path);
+    if (path == ExecutionPath::SEQUENTIAL) {
+        RemoveDocument(execution::seq, document_id);
+    }
+    else {
+        RemoveDocument(execution::par, document_id);
+    }
+}
+
+
+SearchMetricsReport SearchServer::GetMetricsReport() const {
+#ifdef SEARCH_SERVER_METRICS
+    return metrics_->BuildReport();
+#else
+    return {};
+#endif
+}
+
+void SearchServer::ResetMetrics() {
+#ifdef SEARCH_SERVER_METRICS
+    metrics_->Reset();
+#endif
+}
+
+void SearchServer::EnablePositionalIndex() {
+    if (positional_index_enabled_) {
+        return;
+    }
+    for (auto& [document_id, document] : documents_data_) {
+        document.positions = BuildDocumentPositions(document.text, document.term_ids);
+    }
+    positional_index_enabled_ = true;
+}
+
+size_t SearchServer::GetPositionalIndexByteSize() const {
+    size_t byte_size = 0;
+    for (const auto& [document_id, document] : documents_data_) {
+        byte_size += document.positions.GetByteSize();
+    }
+    return byte_size;
+}
+
+void SearchServer::SetFuzzyMatching(int max_distance) {
+    if (max_distance < 0 || max_distance > 2) {
+        throw invalid_argument("Fuzzy matching distance must be from 0 to 2"s);
+    }
+    fuzzy_max_distance_ = max_distance;
+}
+
+void SearchServer::SetQuantizedScoring(bool enabled) {
+    for (WordPostings& postings : term_postings_) {
+        for (PostingList& status_postings : postings.by_status) {
+            if (enabled) {
+                status_postings.EnableImpacts();
+            }
+            else {
+                status_postings.DisableImpacts();
+            }
+        }
+    }
+    quantized_scoring_enabled_ = enabled;
+}
+
+void SearchServer::SetImpactOrderedPostings(size_t min_document_count, size_t postings_budget) {
+    for (WordPostings& postings : term_postings_) {
+        if (min_document_count > 0 && postings.DocumentCount() >= min_document_count) {
+            BuildImpactOrder(postings);
+        }
+        else {
+            postings.impact_ordered.reset();
+        }
+    }
+    impact_order_min_document_count_ = min_document_count;
+    impact_postings_budget_ = postings_budget;
+}
+
+void SearchServer::SetCorpusStatistics(const CorpusStatistics* statistics) {
+    corpus_statistics_ = statistics;
+}
+
+RankingStatistics SearchServer::GetLocalRankingStatistics() const {
+    const int document_count = GetDocumentCount();
+    return { document_count, document_count > 0 ? total_document_length_ * 1.0 / document_count : 0.0 };
+}
+
+size_t SearchServer::GetLocalDocumentFreq(string_view word) const {
+    const WordPostings* postings = FindPostings(word);
+    return postings != nullptr ? postings->DocumentCount() : 0;
+}
+
+IndexMemoryReport SearchServer::GetMemoryReport() const {
+    IndexMemoryReport report;
+    report.document_count = documents_data_.size();
+    report.term_count = term_postings_.size();
+
+    MemoryUsage stop_words = GetNodesMemoryUsage(stop_words_.size(), GetTreeNodeSize<string>());
+    for (const string& stop_word : stop_words_) {
+        stop_words.AddString(stop_word);
+    }
+    report.structures.emplace_back("stop_words"s, stop_words);
+
+    MemoryUsage texts = save_text.get_allocator().GetUsage();
+    for (const string& text : save_text) {
+        texts.AddString(text);
+    }
+    report.structures.emplace_back("save_text"s, texts);
+
+    MemoryUsage term_words = term_words_.get_allocator().GetUsage();
+    for (const string& word : term_words_) {
+        term_words.AddString(word);
+    }
+    report.structures.emplace_back("term_words"s, term_words);
+
+    // копия текста и прямой индекс документа; позиции - отдельной строкой отчета
+    MemoryUsage documents = documents_data_.get_allocator().GetUsage();
+    MemoryUsage positions;
+    for (const auto& [document_id, document] : documents_data_) {
+        documents.AddString(document.text);
+        documents.AddVector(document.term_ids);
+        positions += document.positions.GetMemoryUsage();
+    }
+    report.structures.emplace_back("documents_data"s, documents);
+    report.structures.emplace_back("positional_index"s, positions);
+
+    MemoryUsage document_columns = GetNodesMemoryUsage(document_ids_.size(), GetTreeNodeSize<int>());
+    document_columns += document_ratings_.GetMemoryUsage();
+    document_columns += document_lengths_.GetMemoryUsage();
+    document_columns += rating_to_document_ids_.get_allocator().GetUsage();
+    report.structures.emplace_back("document_columns"s, document_columns);
+
+    MemoryUsage word_frequencies = id_word_frequencies_.get_allocator().GetUsage();
+    word_frequencies += word_frequencies_allocator_.GetUsage();
+    report.structures.emplace_back("id_word_frequencies"s, word_frequencies);
+
+    MemoryUsage postings;
+    MemoryUsage impact_ordered;
+    MemoryUsage bitmaps;
+    postings.AddVector(term_postings_);
+    for (const WordPostings& word_postings : term_postings_) {
+        MemoryUsage word_usage;
+        for (const PostingList& status_postings : word_postings.by_status) {
+            word_usage += status_postings.GetMemoryUsage();
+        }
+        postings += word_usage;
+        if (word_postings.impact_ordered) {
+            MemoryUsage impact_usage;
+            impact_usage.AddAllocation(sizeof(*word_postings.impact_ordered));
+            for (const ImpactOrderedPostings& status_postings : *word_postings.impact_ordered) {
+                impact_usage += status_postings.GetMemoryUsage();
+            }
+            impact_ordered += impact_usage;
+            word_usage += impact_usage;
+        }
+        if (word_postings.document_bitmap) {
+            MemoryUsage bitmap_usage;
+            bitmap_usage.AddAllocation(sizeof(*word_postings.document_bitmap));
+            bitmap_usage += word_postings.document_bitmap->GetMemoryUsage();
+            bitmaps += bitmap_usage;
+            word_usage += bitmap_usage;
+        }
+        report.AddPostings(word_postings.DocumentCount(), sizeof(WordPostings) + word_usage.GetTotalBytes());
+    }
+    report.structures.emplace_back("term_postings"s, postings);
+    report.structures.emplace_back("impact_ordered_postings"s, impact_ordered);
+    report.structures.emplace_back("document_bitmaps"s, bitmaps);
+
+    MemoryUsage terms = term_dictionary_.GetMemoryUsage();
+    terms.AddVector(term_id_to_word_);
+    terms += new_terms_.get_allocator().GetUsage();
+    report.structures.emplace_back("term_dictionary"s, terms);
+
+    // арены пула, не занятые живыми узлами
+    const NodePoolStatistics pool_statistics = GetNodePoolStatistics();
+    MemoryUsage pool_free;
+    pool_free.overhead_bytes = pool_statistics.arena_bytes - min(pool_statistics.used_bytes, pool_statistics.arena_bytes);
+    pool_free.allocation_count = pool_statistics.arena_count;
+    report.structures.emplace_back("node_pool_free"s, pool_free);
+    return report;
+}
+
+namespace {
+
+// новый контейнер того же типа с узлами из pool; элементы переносятся из container
+template <typename Container>
+Container MoveToNodePool(Container& container, const shared_ptr<NodePool>& pool) {
+    using Allocator = typename Container::allocator_type;
+    Container result(pool ? Allocator(pool) : Allocator());
+    for (auto& value : container) {
+        result.emplace_hint(result.end(), move(value));
+    }
+    return result;
+}
+
+}  // namespace
+
+void SearchServer::SetNodeAllocation(NodeAllocation allocation) {
+    node_pool_ = allocation == NodeAllocation::HEAP ? nullptr : make_shared<NodePool>(allocation);
+    word_frequencies_allocator_ = node_pool_ ? WordFrequencies::allocator_type(node_pool_) : WordFrequencies::allocator_type();
+
+    CountedMap<int, WordFrequencies> id_word_frequencies = MoveToNodePool(id_word_frequencies_, node_pool_);
+    for (auto& [document_id, frequencies] : id_word_frequencies) {
+        WordFrequencies pooled_frequencies(word_frequencies_allocator_);
+        pooled_frequencies.insert(frequencies.begin(), frequencies.end());
+        frequencies = move(pooled_frequencies);
+    }
+    id_word_frequencies_ = move(id_word_frequencies);
+    documents_data_ = MoveToNodePool(documents_data_, node_pool_);
+    rating_to_document_ids_ = MoveToNodePool(rating_to_document_ids_, node_pool_);
+    new_terms_ = MoveToNodePool(new_terms_, node_pool_);
+}
+
+NodePoolStatistics SearchServer::GetNodePoolStatistics() const {
+    return node_pool_ ? node_pool_->GetStatistics() : NodePoolStatistics{};
+}
+
+void SearchServer::SetAdaptiveExecutionThresholds(const AdaptiveExecutionThresholds& thresholds) {
+    adaptive_thresholds_ = thresholds;
+}
+
+const AdaptiveExecutionThresholds& SearchServer::GetAdaptiveExecutionThresholds() const {
+    return adaptive_thresholds_ ? *adaptive_thresholds_ : GetDefaultAdaptiveExecution();
+}
+
+AdaptiveExecutionStatistics SearchServer::GetAdaptiveExecutionStatistics() const {
+    return adaptive_counters_->GetStatistics();
+}
 
 bool SearchServer::IsStopWord(string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
+optional<int> SearchServer::FindTermId(string_view word) const {
+    const auto it = new_terms_.find(word);
+    if (it != new_terms_.end()) {
+        return it->second;
+    }
+    return term_dictionary_.Find(word);
+}
+
+const SearchServer::WordPostings* SearchServer::FindPostings(string_view word) const {
+    const auto term_id = FindTermId(word);
+    return term_id ? &term_postings_[*term_id] : nullptr;
+}
+
+int SearchServer::AddTerm(string_view word) {
+    if (const auto term_id = FindTermId(word)) {
+        return *term_id;
+    }
+    const int term_id = static_cast<int>(term_id_to_word_.size());
+    term_id_to_word_.push_back(word);
+    term_postings_.emplace_back();
+    if (quantized_scoring_enabled_) {
+        for (PostingList& status_postings : term_postings_.back().by_status) {
+            status_postings.EnableImpacts();
+        }
+    }
+    new_terms_.emplace(word, term_id);
+    if (new_terms_.size() > max<size_t>(256, term_dictionary_.size() / 4)) {
+        RebuildTermDictionary();
+    }
+    return term_id;
+}
+
+void SearchServer::RebuildTermDictionary() {
+    vector<pair<string_view, int>> terms;
+    terms.reserve(term_id_to_word_.size());
+    for (size_t term_id = 0; term_id < term_id_to_word_.size(); ++term_id) {
+        terms.push_back({ term_id_to_word_[term_id], static_cast<int>(term_id) });
+    }
+    sort(terms.begin(), terms.end());
+    term_dictionary_ = TermDictionary(terms);
+    new_terms_.clear();
+}
+
+bool SearchServer::HasWord(string_view word) const {
+    return FindTermId(word).has_value();
+}
+
+vector<ExpansionCandidate> SearchServer::FindByPrefix(string_view prefix) const {
+    vector<int> term_ids = term_dictionary_.FindByPrefix(prefix);
+    for (auto it = new_terms_.lower_bound(prefix); it != new_terms_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        term_ids.push_back(it->second);
+    }
+    vector<ExpansionCandidate> candidates;
+    for (const int term_id : term_ids) {
+        candidates.push_back({ term_id_to_word_[term_id], term_postings_[term_id].DocumentCount(), 0 });
+    }
+    return candidates;
+}
+
+vector<ExpansionCandidate> SearchServer::FindWithinDistance(const LevenshteinAutomaton& automaton) const {
+    vector<pair<int, int>> matches = term_dictionary_.FindWithinDistance(automaton);
+    // слова, добавленные после построения словаря, обходятся тем же автоматом с пропуском веток
+    ForEachTermWithinDistance(automaton, new_terms_, [&matches](auto it, int distance) {
+        matches.push_back({ it->second, distance });
+    });
+
+    vector<ExpansionCandidate> candidates;
+    for (const auto& [term_id, distance] : matches) {
+        candidates.push_back({ term_id_to_word_[term_id], term_postings_[term_id].DocumentCount(), distance });
+    }
+    return candidates;
+}
+
+size_t SearchServer::StatusIndex(DocumentStatus status) {
+    return static_cast<size_t>(status);
+}
+
+void SearchServer::BuildImpactOrder(WordPostings& postings) {
+    postings.impact_ordered = make_unique<array<ImpactOrderedPostings, DOCUMENT_STATUS_COUNT>>();
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        (*postings.impact_ordered)[status] = ImpactOrderedPostings(postings.by_status[status]);
+    }
+}
+
+void SearchServer::BuildDocumentBitmap(WordPostings& postings) {
+    postings.document_bitmap = make_unique<CompressedIdBitmap>();
+    for (const PostingList& status_postings : postings.by_status) {
+        for (const auto [document_id, term_freq] : status_postings) {
+            postings.document_bitmap->Insert(document_id);
+        }
+    }
+}
+
+void SearchServer::ErasePosting(WordPostings& postings, size_t status, int document_id) {
+    if (postings.document_bitmap) {
+        postings.document_bitmap->Erase(document_id);
+    }
+    if (postings.impact_ordered) {
+        if (const double* term_freq = postings.by_status[status].Find(document_id)) {
+            (*postings.impact_ordered)[status].Erase(document_id, PostingList::QuantizeTermFreq(*term_freq));
+        }
+    }
+    postings.by_status[status].Erase(document_id);
+}
+
+void SearchServer::InsertPosting(WordPostings& postings, size_t status, int document_id, double term_freq, size_t document_length) {
+    postings.by_status[status].Add(document_id, term_freq);
+    UpdateTermMaxima(postings, term_freq, document_length);
+    if (postings.impact_ordered) {
+        (*postings.impact_ordered)[status].Add(document_id, PostingList::QuantizeTermFreq(term_freq));
+    }
+    else if (impact_order_min_document_count_ > 0 && postings.DocumentCount() >= impact_order_min_document_count_) {
+        BuildImpactOrder(postings);
+    }
+    if (postings.document_bitmap) {
+        postings.document_bitmap->Insert(document_id);
+    }
+    else if (postings.DocumentCount() >= max<size_t>(DENSE_TERM_MIN_DOCUMENT_COUNT, document_ids_.size() / DENSE_TERM_RATIO)) {
+        BuildDocumentBitmap(postings);
+    }
+}
+
+void SearchServer::UpdateTermMaxima(WordPostings& postings, double term_freq, size_t document_length) {
+    postings.max_term_freq = max(postings.max_term_freq, term_freq);
+    postings.max_term_count = max(postings.max_term_count, static_cast<int>(lround(term_freq * document_length)));
+}
+
+void SearchServer::SetDocumentRating(int document_id, int rating) {
+    const int old_rating = document_ratings_.Get(document_id);
+    if (old_rating == rating) {
+        return;
+    }
+    rating_to_document_ids_.erase({ old_rating, document_id });
+    rating_to_document_ids_.emplace(rating, document_id);
+    document_ratings_.Set(document_id, rating);
+}
+
+void SearchServer::ReleaseDocumentText(const DocumentInformation& document) {
+    string& text = save_text[document.text_index];
+    const less<const char*> is_before;
+    for (const int term_id : document.term_ids) {
+        const string_view word = term_id_to_word_[term_id];
+        if (is_before(word.data(), text.data()) || !is_before(word.data(), text.data() + text.size())) {
+            continue;
+        }
+        const string_view word_copy = term_words_.emplace_back(word);
+        term_id_to_word_[term_id] = word_copy;
+        if (const auto it = new_terms_.find(word); it != new_terms_.end()) {
+            new_terms_.erase(it);
+            new_terms_.emplace(word_copy, term_id);
+        }
+    }
+    string().swap(text);
+}
+
+SearchServer::DocumentInformation& SearchServer::GetDocumentForUpdate(int document_id) {
+    const auto it = documents_data_.find(document_id);
+    if (it == documents_data_.end()) {
+        throw invalid_argument("Document to update does not exist"s);
+    }
+    return it->second;
+}
+
+size_t SearchServer::WordPostings::DocumentCount() const {
+    size_t count = 0;
+    for (const auto& postings : by_status) {
+        count += postings.size();
+    }
+    return count;
+}
+
+bool SearchServer::IsWordInDocument(string_view word, int document_id, DocumentStatus status) const {
+    const WordPostings* postings = FindPostings(word);
+    if (postings != nullptr && postings->document_bitmap) {
+        // у документа один статус, поэтому карта всех статусов отвечает так же
+        return postings->document_bitmap->Contains(document_id);
+    }
+    return postings != nullptr && postings->by_status[StatusIndex(status)].Contains(document_id);
+}
+
 bool SearchServer::IsValidWord(string_view word) {
     // A valid word must not contain special characters
     return none_of(word.begin(), word.end(), [](char c) {
@@ -210,6 +893,10 @@ vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
+    // документ без оценок (например, ADD_DOCUMENT по сети с пустым списком) - рейтинг 0
+    if (ratings.empty()) {
+        return 0;
+    }
     int rating_sum = 0;
     for (const int rating : ratings) {
         rating_sum += rating;
@@ -219,6 +906,8 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     bool is_minus = false;
+    bool is_required = false;
+    bool is_prefix = false;
     // Word shouldn't be empty
     if (text.empty()) {
         throw invalid_argument("Empty word"s);
@@ -228,8 +917,16 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         is_minus = true;
         text = text.substr(1);
     }
+    else if (text[0] == '+') {
+        is_required = true;
+        text = text.substr(1);
+    }
+    if (!text.empty() && text.back() == '*') {
+        is_prefix = true;
+        text.remove_suffix(1);
+    }
 
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    if (text.empty() || text[0] == '-' || text[0] == '+' || !IsValidWord(text)) {
         throw invalid_argument("Incorrect word entry or empty word after \"-\" or incorrect word entry after \"-\""s);
 
     }
@@ -237,102 +934,1024 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     return {
         text,
         is_minus,
-        IsStopWord(text)
+        IsStopWord(text),
+        is_required,
+        is_prefix
     };
 }
 
-SearchServer::Query SearchServer::ParseQuery(string_view text) const {
+SearchServer::Query SearchServer::ParseQuery(string_view text, const QueryExpansion* expansion) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::PARSE);
+    QueryExpansion own_expansion;
+    if (expansion == nullptr) {
+        // без нечеткого поиска и "prefix*" раскрывать нечего
+        if (fuzzy_max_distance_ > 0 || text.find('*') != text.npos) {
+            own_expansion = ExpandQuery(text, fuzzy_max_distance_, *this);
+        }
+        expansion = &own_expansion;
+    }
     Query query;
-    for (const string_view word : SplitIntoWords(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
+    // слова нечеткого поиска добавляются после разбора: если слово есть в запросе явно, его вес 1
+    vector<pair<string_view, double>> fuzzy_words;
+    const vector<string_view> words = SplitIntoWords(text);
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (!words[i].empty() && words[i][0] == '"') {
+            i = ParsePhrase(words, i, query);
+            continue;
+        }
+
+        if (i + 2 < words.size()) {
+            if (const auto max_distance = ParseNearDistance(words[i + 1])) {
+                const QueryWord lhs = ParseQueryWord(words[i]);
+                const QueryWord rhs = ParseQueryWord(words[i + 2]);
+                if (lhs.is_minus || rhs.is_minus || lhs.is_prefix || rhs.is_prefix) {
+                    throw invalid_argument("Minus or prefix word in NEAR operator"s);
+                }
+                PositionalConstraint near{ {}, false, *max_distance };
+                for (const QueryWord& query_word : { lhs, rhs }) {
+                    if (!query_word.is_stop) {
+                        query.plus_words.insert(query_word.data);
+                        query.required_words.insert(query_word.data);
+                        near.words.push_back({ query_word.data, 0 });
+                    }
+                }
+                if (near.words.size() == 2) {
+                    query.positional_constraints.push_back(move(near));
+                }
+                // правое слово может быть левым для следующего NEAR: "a NEAR/2 b NEAR/2 c"
+                ++i;
+                continue;
+            }
+        }
+
+        const QueryWord query_word = ParseQueryWord(words[i]);
+        if (query_word.is_prefix) {
+            // обязательность "+word*" означала бы "хотя бы одно из слов", а обязательные слова пересекаются
+            if (query_word.is_required) {
+                throw invalid_argument("Required prefix word in query"s);
+            }
+            for (const string_view word : expansion->GetPrefixWords(query_word.data)) {
+                (query_word.is_minus ? query.minus_words : query.plus_words).insert(word);
+            }
+            continue;
+        }
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 query.minus_words.insert(query_word.data);
             }
+            else if (!query_word.is_required && expansion->fuzzy_words.count(query_word.data) > 0) {
+                for (const auto& [word, distance] : expansion->GetFuzzyWords(query_word.data)) {
+                    fuzzy_words.push_back({ word, pow(FUZZY_EDIT_WEIGHT, distance) });
+                }
+            }
             else {
                 query.plus_words.insert(query_word.data);
+                if (query_word.is_required) {
+                    query.required_words.insert(query_word.data);
+                }
             }
         }
     }
+
+    for (const auto& [word, weight] : fuzzy_words) {
+        const bool inserted = query.plus_words.insert(word).second;
+        if (inserted || query.word_weights.count(word) > 0) {
+            query.word_weights[word] = max(query.word_weights[word], weight);
+        }
+    }
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::Query::GetWeight(string_view word) const {
+    const auto it = word_weights.find(word);
+    return it != word_weights.end() ? it->second : 1.0;
 }
 
+size_t SearchServer::ParsePhrase(const vector<string_view>& words, size_t first, Query& query) const {
+    PositionalConstraint phrase;
+    for (size_t i = first; i < words.size(); ++i) {
+        string_view word = words[i];
+        if (i == first) {
+            word.remove_prefix(1);
+        }
+        const bool is_last = !word.empty() && word.back() == '"';
+        if (is_last) {
+            word.remove_suffix(1);
+        }
+        if (word.empty() || word[0] == '-' || word[0] == '+' || word.find('"') != word.npos || !IsValidWord(word)) {
+            throw invalid_argument("Incorrect word entry in phrase"s);
+        }
 
-vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query) const {
-    map<int, double> document_to_relevance;
+        if (!IsStopWord(word)) {
+            query.plus_words.insert(word);
+            query.required_words.insert(word);
+            phrase.words.push_back({ word, static_cast<int>(i - first) });
+        }
+        if (is_last) {
+            if (phrase.words.size() > 1) {
+                query.positional_constraints.push_back(move(phrase));
+            }
+            return i;
+        }
+    }
+    throw invalid_argument("Unclosed quote in query"s);
+}
+
+optional<int> SearchServer::ParseNearDistance(string_view word) {
+    const string_view prefix = "NEAR/"sv;
+    if (word.size() <= prefix.size() || word.substr(0, prefix.size()) != prefix) {
+        return nullopt;
+    }
+    word.remove_prefix(prefix.size());
+    if (word.size() > 6 || !all_of(word.begin(), word.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return nullopt;
+    }
+    return stoi(string(word));
+}
+
+SearchServer::CompiledQuery SearchServer::CompileQuery(const Query& query) const {
+    CompiledQuery compiled_query;
+    for (const string_view word : query.plus_words) {
+        if (const auto term_id = FindTermId(word)) {
+            compiled_query.plus_terms.push_back({ *term_id, term_id_to_word_[*term_id] });
+        }
+    }
+    for (const string_view word : query.minus_words) {
+        if (const auto term_id = FindTermId(word)) {
+            compiled_query.minus_term_ids.push_back(*term_id);
+        }
+    }
+    for (const string_view word : query.required_words) {
+        compiled_query.required_term_ids.push_back(FindTermId(word).value_or(-1));
+    }
+    compiled_query.constraints = CompileConstraints(query);
+    return compiled_query;
+}
+
+vector<SearchServer::CompiledConstraint> SearchServer::CompileConstraints(const Query& query) const {
+    vector<CompiledConstraint> constraints;
+    for (const PositionalConstraint& constraint : query.positional_constraints) {
+        CompiledConstraint compiled_constraint{ {}, constraint.is_phrase, constraint.max_distance };
+        for (const auto& [word, offset] : constraint.words) {
+            compiled_constraint.terms.push_back({ FindTermId(word).value_or(-1), offset });
+        }
+        constraints.push_back(move(compiled_constraint));
+    }
+    return constraints;
+}
+
+DocumentPositions SearchServer::BuildDocumentPositions(string_view text, const vector<int>& term_ids) const {
+    vector<vector<int>> term_positions(term_ids.size());
+    const vector<string_view> words = SplitIntoWords(text);
+    for (size_t position = 0; position < words.size(); ++position) {
+        if (IsStopWord(words[position])) {
+            continue;
+        }
+        const int term_id = *FindTermId(words[position]);
+        const size_t term_index = lower_bound(term_ids.begin(), term_ids.end(), term_id) - term_ids.begin();
+        term_positions[term_index].push_back(static_cast<int>(position));
+    }
+    return DocumentPositions(term_positions);
+}
+
+vector<int> SearchServer::GetTermPositions(const DocumentInformation& document, int term_id) const {
+    const auto it = lower_bound(document.term_ids.begin(), document.term_ids.end(), term_id);
+    if (it == document.term_ids.end() || *it != term_id) {
+        return {};
+    }
+    if (positional_index_enabled_) {
+        return document.positions.Get(it - document.term_ids.begin());
+    }
+
+    vector<int> positions;
+    const vector<string_view> words = SplitIntoWords(document.text);
+    for (size_t position = 0; position < words.size(); ++position) {
+        if (words[position] == term_id_to_word_[term_id]) {
+            positions.push_back(static_cast<int>(position));
+        }
+    }
+    return positions;
+}
+
+bool SearchServer::MatchesConstraints(const vector<CompiledConstraint>& constraints, int document_id) const {
+    if (constraints.empty()) {
+        return true;
+    }
+    const DocumentInformation& document = documents_data_.at(document_id);
+    return all_of(constraints.begin(), constraints.end(), [this, &document](const CompiledConstraint& constraint) {
+        vector<vector<int>> term_positions;
+        vector<int> offsets;
+        for (const auto& [term_id, offset] : constraint.terms) {
+            term_positions.push_back(GetTermPositions(document, term_id));
+            offsets.push_back(offset);
+        }
+        if (constraint.is_phrase) {
+            return HasPhrase(term_positions, offsets);
+        }
+        return HasNear(term_positions[0], term_positions[1], constraint.max_distance);
+    });
+}
+
+template <typename ExecutionPolicy>
+vector<int> SearchServer::FilterByConstraints(const ExecutionPolicy& policy, const vector<CompiledConstraint>& constraints,
+    vector<int> candidates) const {
+    vector<char> matches(candidates.size());
+    transform(policy, candidates.begin(), candidates.end(), matches.begin(),
+        [this, &constraints](int document_id) -> char {
+            return MatchesConstraints(constraints, document_id);
+        });
+
+    size_t matched_count = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (matches[i]) {
+            candidates[matched_count++] = candidates[i];
+        }
+    }
+    candidates.resize(matched_count);
+    return candidates;
+}
+
+RankingStatistics SearchServer::GetRankingStatistics() const {
+    return corpus_statistics_ != nullptr ? corpus_statistics_->GetRankingStatistics() : GetLocalRankingStatistics();
+}
+
+size_t SearchServer::GetDocumentFreq(string_view word, const WordPostings& postings) const {
+    return corpus_statistics_ != nullptr ? corpus_statistics_->GetDocumentFreq(word) : postings.DocumentCount();
+}
+
+template <typename Ranking>
+double SearchServer::ComputeTermWeight(const Ranking& ranking, const RankingStatistics& statistics, const Query& query,
+    string_view word, const WordPostings& postings) const {
+    return ranking.ComputeTermWeight(GetDocumentFreq(word, postings), statistics) * query.GetWeight(word);
+}
+
+template <typename Ranking>
+double SearchServer::ScorePosting(const Ranking& ranking, const RankingStatistics& statistics, double term_weight,
+    int document_id, double term_freq) const {
+    if constexpr (Ranking::USES_DOCUMENT_LENGTH) {
+        return ranking.Score(term_weight, term_freq, document_lengths_.Get(document_id), statistics);
+    }
+    else {
+        return ranking.Score(term_weight, term_freq, 0, statistics);
+    }
+}
+
+
+size_t SearchServer::CountPostings(const Query& query, const DocumentStatusSet& statuses) const {
+    size_t count = 0;
     for (string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const WordPostings* postings = FindPostings(word);
+        if (postings == nullptr) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            if (statuses.test(status)) {
+                count += postings->by_status[status].size();
+            }
         }
     }
+    return count;
+}
 
+DocumentIdBitmap SearchServer::CollectMinusDocuments(const Query& query, const DocumentFilter& filter) const {
+    DocumentIdBitmap minus_documents;
     for (string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const WordPostings* postings = FindPostings(word);
+        if (postings == nullptr) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        // в карте есть и документы других статусов, но среди кандидатов их нет
+        if (postings->document_bitmap) {
+            postings->document_bitmap->UnionInto(minus_documents);
+            continue;
+        }
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            if (filter.statuses.test(status)) {
+                for (const auto [document_id, term_freq] : postings->by_status[status]) {
+                    minus_documents.Insert(document_id);
+                }
+            }
         }
     }
+    return minus_documents;
+}
+
+bool SearchServer::CanEvaluateInBatch(const Query& query, const DocumentFilter& filter) const {
+    return query.required_words.empty() && !filter.HasAttributeConditions()
+        && !quantized_scoring_enabled_ && impact_order_min_document_count_ == 0
+        && CanUseDenseScores(query.plus_words.size());
+}
+
+optional<vector<int>> SearchServer::CollectFilterCandidates(const DocumentFilter& filter, size_t limit) const {
+    vector<int> candidates;
+    const auto accepts = [this, &filter](int document_id) {
+        const auto it = documents_data_.find(document_id);
+        return it != documents_data_.end()
+            && filter.Accepts(document_id, it->second.document_status, document_ratings_.Get(document_id));
+    };
+
+    if (filter.allowed_ids && filter.allowed_ids->Size() <= limit) {
+        filter.allowed_ids->ForEach([&candidates, &accepts](int document_id) {
+            if (accepts(document_id)) {
+                candidates.push_back(document_id);
+            }
+        });
+        return candidates;
+    }
+
+    if (filter.HasRatingRange()) {
+        auto first = filter.min_rating ? rating_to_document_ids_.lower_bound({ *filter.min_rating, INT_MIN })
+                                       : rating_to_document_ids_.begin();
+        const auto last = filter.max_rating ? rating_to_document_ids_.upper_bound({ *filter.max_rating, INT_MAX })
+                                            : rating_to_document_ids_.end();
+        for (size_t checked = 0; first != last; ++first, ++checked) {
+            // диапазон слишком широкий - дешевле обойти постинги
+            if (checked == limit) {
+                return nullopt;
+            }
+            if (accepts(first->second)) {
+                candidates.push_back(first->second);
+            }
+        }
+        return candidates;
+    }
+
+    return nullopt;
+}
+
+vector<int> SearchServer::FindConjunctiveCandidates(const Query& query, const DocumentFilter& filter) const {
+    vector<const WordPostings*> required_postings;
+    for (string_view word : query.required_words) {
+        const WordPostings* postings = FindPostings(word);
+        if (postings == nullptr) {
+            return {};
+        }
+        required_postings.push_back(postings);
+    }
+
+    vector<int> candidates;
+    const bool check_attributes = filter.HasAttributeConditions();
+    // документ лежит в постингах всех своих слов в одной и той же части по статусу,
+    // поэтому пересечение всего индекса - объединение пересечений по частям
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        if (!filter.statuses.test(status)) {
+            continue;
+        }
+        vector<const PostingList*> status_postings;
+        for (const WordPostings* postings : required_postings) {
+            status_postings.push_back(&postings->by_status[status]);
+        }
+        for (const int document_id : IntersectPostings(move(status_postings))) {
+            if (!check_attributes || filter.Accepts(document_id, static_cast<DocumentStatus>(status), document_ratings_.Get(document_id))) {
+                candidates.push_back(document_id);
+            }
+        }
+    }
+    return candidates;
+}
+
+vector<pair<string_view, const SearchServer::WordPostings*>> SearchServer::GetPlusPostings(const Query& query, bool rarest_first) const {
+    vector<pair<string_view, const WordPostings*>> plus_postings;
+    for (string_view word : query.plus_words) {
+        if (const WordPostings* postings = FindPostings(word)) {
+            plus_postings.push_back({ word, postings });
+        }
+    }
+    if (rarest_first) {
+        stable_sort(plus_postings.begin(), plus_postings.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second->DocumentCount() < rhs.second->DocumentCount();
+        });
+    }
+    return plus_postings;
+}
+
+template <typename Function>
+bool SearchServer::ForEachPosting(const PostingList& postings, SearchBudgetTracker* budget, Function function) {
+    if (budget == nullptr) {
+        for (const auto [document_id, term_freq] : postings) {
+            function(document_id, term_freq);
+        }
+        return true;
+    }
+    auto it = postings.begin();
+    for (size_t position = 0; position < postings.size();) {
+        const size_t block_end = min(position + SearchBudgetTracker::BLOCK_SIZE, postings.size());
+        if (!budget->Consume(block_end - position)) {
+            return false;
+        }
+        for (; position < block_end; ++position, ++it) {
+            const auto [document_id, term_freq] = *it;
+            function(document_id, term_freq);
+        }
+    }
+    return true;
+}
+
+template <typename ExecutionPolicy, typename Ranking>
+vector<Document> SearchServer::ScoreCandidates(const ExecutionPolicy& policy, const Query& query, const vector<int>& candidates,
+    const Ranking& ranking, SearchBudgetTracker* budget, SearchPageCollector* page) const {
+    const RankingStatistics statistics = GetRankingStatistics();
+    vector<pair<const WordPostings*, double>> plus_postings;
+    for (string_view word : query.plus_words) {
+        if (const WordPostings* postings = FindPostings(word)) {
+            plus_postings.push_back({ postings, ComputeTermWeight(ranking, statistics, query, word, *postings) });
+        }
+    }
+
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, candidates.size());
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, candidates.size() * plus_postings.size());
+
+    const auto score_document = [this, &query, &plus_postings, &ranking, &statistics](int document_id) {
+        const DocumentStatus status = documents_data_.at(document_id).document_status;
+        // id = -1 помечает документы, не попавшие в результат
+        Document document(-1, 0.0, document_ratings_.Get(document_id));
+
+        for (string_view word : query.minus_words) {
+            if (IsWordInDocument(word, document_id, status)) {
+                return document;
+            }
+        }
+        for (const auto& [postings, term_weight] : plus_postings) {
+            if (const double* term_freq = postings->by_status[StatusIndex(status)].Find(document_id)) {
+                document.id = document_id;
+                document.relevance += ScorePosting(ranking, statistics, term_weight, document_id, *term_freq);
+            }
+        }
+        return document;
+    };
+
+    vector<Document> matched_documents(candidates.size());
+    if (budget == nullptr) {
+        transform(policy, candidates.begin(), candidates.end(), matched_documents.begin(), score_document);
+    }
+    else {
+        // блок кандидатов стоит по постингу на каждое плюс слово
+        size_t scored_count = 0;
+        while (scored_count < candidates.size()) {
+            const size_t block_end = min(scored_count + SearchBudgetTracker::BLOCK_SIZE, candidates.size());
+            if (!budget->Consume((block_end - scored_count) * max<size_t>(plus_postings.size(), 1))) {
+                break;
+            }
+            transform(policy, candidates.begin() + scored_count, candidates.begin() + block_end,
+                matched_documents.begin() + scored_count, score_document);
+            scored_count = block_end;
+        }
+        matched_documents.resize(scored_count);
+    }
+
+    if (page != nullptr) {
+        for (const Document& document : matched_documents) {
+            if (document.id >= 0) {
+                page->Add(document);
+            }
+        }
+        return {};
+    }
+    matched_documents.erase(remove_if(matched_documents.begin(), matched_documents.end(),
+        [](const Document& document) {
+            return document.id < 0;
+        }),
+        matched_documents.end());
+    return matched_documents;
+}
+
+template <typename Ranking>
+vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, const DocumentFilter& filter,
+    const Ranking& ranking, SearchBudgetTracker* budget, SearchPageCollector* page) const {
+    if (query.plus_words.empty()) {
+        return {};
+    }
+    if (!query.required_words.empty()) {
+        auto candidates = FindConjunctiveCandidates(query, filter);
+        if (!query.positional_constraints.empty()) {
+            candidates = FilterByConstraints(std::execution::seq, CompileConstraints(query), move(candidates));
+        }
+        return ScoreCandidates(std::execution::seq, query, candidates, ranking, budget, page);
+    }
+    const size_t postings_count = CountPostings(query, filter.statuses);
+    if (const auto candidates = CollectFilterCandidates(filter, postings_count / query.plus_words.size())) {
+        return ScoreCandidates(std::execution::seq, query, *candidates, ranking, budget, page);
+    }
+    if constexpr (is_same_v<Ranking, TfIdfRanking>) {
+        if (quantized_scoring_enabled_) {
+            if (auto documents = FindAllDocumentsQuantized(query, filter, budget, page)) {
+                return move(*documents);
+            }
+        }
+    }
+
+    const bool check_attributes = filter.HasAttributeConditions();
+    const RankingStatistics statistics = GetRankingStatistics();
+    map<int, double> document_to_relevance;
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::POSTINGS);
+        SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, postings_count);
+        for (const auto& [word, postings] : GetPlusPostings(query, budget != nullptr)) {
+            const double term_weight = ComputeTermWeight(ranking, statistics, query, word, *postings);
+            for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                if (!filter.statuses.test(status)) {
+                    continue;
+                }
+                const bool completed = ForEachPosting(postings->by_status[status], budget, [&](int document_id, double term_freq) {
+                    if (check_attributes && !filter.Accepts(document_id, static_cast<DocumentStatus>(status), document_ratings_.Get(document_id))) {
+                        return;
+                    }
+                    document_to_relevance[document_id] += ScorePosting(ranking, statistics, term_weight, document_id, term_freq);
+                });
+                if (!completed) {
+                    break;
+                }
+            }
+            if (budget != nullptr && budget->IsExhausted()) {
+                break;
+            }
+        }
+    }
+
+    DocumentIdBitmap minus_documents;
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::MINUS_WORDS);
+        minus_documents = CollectMinusDocuments(query, filter);
+    }
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, document_to_relevance.size());
 
     vector<Document> matched_documents;
     for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({
+        if (minus_documents.Contains(document_id)) {
+            continue;
+        }
+        AddMatchedDocument(matched_documents, page, {
             document_id,
             relevance,
-            documents_data_.at(document_id).rating
+            document_ratings_.Get(document_id)
             });
     }
     return matched_documents;
 }
 
-vector<Document> SearchServer::FindAllDocuments(const Query& query) const {
-    return FindAllDocuments(std::execution::seq, query);
-}
+template <typename Ranking>
+vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, const DocumentFilter& filter,
+    const Ranking& ranking, SearchBudgetTracker* budget, SearchPageCollector* page) const {
+    if (query.plus_words.empty()) {
+        return {};
+    }
+    if (!query.required_words.empty()) {
+        auto candidates = FindConjunctiveCandidates(query, filter);
+        if (!query.positional_constraints.empty()) {
+            candidates = FilterByConstraints(std::execution::par, CompileConstraints(query), move(candidates));
+        }
+        return ScoreCandidates(std::execution::par, query, candidates, ranking, budget, page);
+    }
+    const size_t postings_count = CountPostings(query, filter.statuses);
+    if (const auto candidates = CollectFilterCandidates(filter, postings_count / query.plus_words.size())) {
+        return ScoreCandidates(std::execution::par, query, *candidates, ranking, budget, page);
+    }
+    if constexpr (is_same_v<Ranking, TfIdfRanking>) {
+        if (quantized_scoring_enabled_) {
+            if (auto documents = FindAllDocumentsQuantized(query, filter, budget, page)) {
+                return move(*documents);
+            }
+        }
+    }
 
-vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query) const {
+    const bool check_attributes = filter.HasAttributeConditions();
+    const RankingStatistics statistics = GetRankingStatistics();
     ConcurrentMap<int, double> document_to_relevance(97);
 
-    for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-        [this, &document_to_relevance](string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                return;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::POSTINGS);
+        SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, postings_count);
+        const auto plus_postings = GetPlusPostings(query, budget != nullptr);
+        for_each(std::execution::par, plus_postings.begin(), plus_postings.end(),
+            [this, &query, &document_to_relevance, &filter, &ranking, &statistics, check_attributes, budget](const auto& word_postings) {
+                const auto& [word, postings] = word_postings;
+                const double term_weight = ComputeTermWeight(ranking, statistics, query, word, *postings);
+                for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                    if (!filter.statuses.test(status)) {
+                        continue;
+                    }
+                    const bool completed = ForEachPosting(postings->by_status[status], budget, [&](int document_id, double term_freq) {
+                        if (check_attributes && !filter.Accepts(document_id, static_cast<DocumentStatus>(status), document_ratings_.Get(document_id))) {
+                            return;
+                        }
+                        document_to_relevance[document_id].ref_to_value += ScorePosting(ranking, statistics, term_weight, document_id, term_freq);
+                    });
+                    if (!completed) {
+                        return;
+                    }
+                }
             }
+        );
+    }
+
+    DocumentIdBitmap minus_documents;
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::MINUS_WORDS);
+        minus_documents = CollectMinusDocuments(query, filter);
+    }
+
+    vector<Document> matched_documents;
+    size_t candidate_count = 0;
+    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
+        if (minus_documents.Contains(document_id)) {
+            continue;
         }
-    );
+        ++candidate_count;
+        AddMatchedDocument(matched_documents, page, { document_id, relevance, document_ratings_.Get(document_id) });
+    }
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, candidate_count);
+    return matched_documents;
+
+
 
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-        [this, &document_to_relevance](string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) {
+}
+
+ExecutionPath SearchServer::ChooseSearchPath(const Query& query, const DocumentFilter& filter) const {
+    const AdaptiveExecutionThresholds& thresholds = GetAdaptiveExecutionThresholds();
+    // слово одно - параллельно по словам обходить нечего
+    const bool can_split_terms = query.plus_words.size() > 1;
+    const bool can_split_documents = query.required_words.empty() && !quantized_scoring_enabled_
+        && CanUseDenseScores(query.plus_words.size());
+    const ExecutionPath path = ChooseExecutionPath(CountPostings(query, filter.statuses),
+        can_split_terms ? thresholds.parallel_terms_min_postings : numeric_limits<size_t>::max(),
+        can_split_documents ? thresholds.document_ranges_min_postings : numeric_limits<size_t>::max(),
+        adaptive_counters_->GetActiveCount());
+    adaptive_counters_->Record(path);
+    return path;
+}
+
+template <typename Ranking>
+vector<Document> SearchServer::FindAllDocumentsByDocumentRanges(const Query& query, const DocumentFilter& filter,
+    const Ranking& ranking) const {
+    if (query.plus_words.empty()) {
+        return {};
+    }
+    const size_t postings_count = CountPostings(query, filter.statuses);
+    if (const auto candidates = CollectFilterCandidates(filter, postings_count / query.plus_words.size())) {
+        return ScoreCandidates(std::execution::par, query, *candidates, ranking, nullptr);
+    }
+
+    const bool check_attributes = filter.HasAttributeConditions();
+    const RankingStatistics statistics = GetRankingStatistics();
+    vector<pair<const WordPostings*, double>> plus_postings;
+    for (const auto& [word, postings] : GetPlusPostings(query, false)) {
+        plus_postings.push_back({ postings, ComputeTermWeight(ranking, statistics, query, word, *postings) });
+    }
+
+    DocumentIdBitmap minus_documents;
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::MINUS_WORDS);
+        minus_documents = CollectMinusDocuments(query, filter);
+    }
+
+    const size_t id_count = document_ids_.empty() ? 0 : static_cast<size_t>(*document_ids_.rbegin()) + 1;
+    const size_t range_count = GetHardwareThreadCount() * DOCUMENT_RANGES_PER_THREAD;
+    vector<vector<Document>> range_documents(range_count);
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::POSTINGS);
+        SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, postings_count);
+        vector<size_t> ranges(range_count);
+        iota(ranges.begin(), ranges.end(), 0);
+        for_each(std::execution::par, ranges.begin(), ranges.end(), [&](size_t range) {
+            const int first_id = static_cast<int>(id_count * range / range_count);
+            const int end_id = static_cast<int>(id_count * (range + 1) / range_count);
+            if (first_id == end_id) {
                 return;
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+            // NaN помечает документы без постингов: релевантность найденного документа может быть и 0
+            vector<double> relevances(end_id - first_id, numeric_limits<double>::quiet_NaN());
+            for (const auto& [postings, term_weight] : plus_postings) {
+                for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                    if (!filter.statuses.test(status)) {
+                        continue;
+                    }
+                    const PostingList& status_postings = postings->by_status[status];
+                    const vector<int>& document_ids = status_postings.GetDocumentIds();
+                    const size_t first = lower_bound(document_ids.begin(), document_ids.end(), first_id) - document_ids.begin();
+                    for (PostingList::Iterator it(status_postings, first); it != status_postings.end(); ++it) {
+                        const auto [document_id, term_freq] = *it;
+                        if (document_id >= end_id) {
+                            break;
+                        }
+                        if (check_attributes && !filter.Accepts(document_id, static_cast<DocumentStatus>(status), document_ratings_.Get(document_id))) {
+                            continue;
+                        }
+                        double& relevance = relevances[document_id - first_id];
+                        relevance = (isnan(relevance) ? 0.0 : relevance) + ScorePosting(ranking, statistics, term_weight, document_id, term_freq);
+                    }
+                }
+            }
+            for (int document_id = first_id; document_id < end_id; ++document_id) {
+                const double relevance = relevances[document_id - first_id];
+                if (!isnan(relevance) && !minus_documents.Contains(document_id)) {
+                    range_documents[range].push_back({ document_id, relevance, document_ratings_.Get(document_id) });
+                }
+            }
+        });
+    }
+
+    // диапазоны идут по возрастанию id, как документы последовательной версии
+    vector<Document> matched_documents;
+    for (vector<Document>& documents : range_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, matched_documents.size());
+    return matched_documents;
+}
+
+optional<vector<Document>> SearchServer::FindAllDocumentsQuantized(const Query& query, const DocumentFilter& filter,
+    SearchBudgetTracker* budget, SearchPageCollector* page) const {
+    if (!CanUseDenseScores(query.plus_words.size())) {
+        return nullopt;
+    }
+    const RankingStatistics statistics = GetRankingStatistics();
+    const TfIdfRanking ranking;
+    const double weight_scale = GetQuantizedWeightScale(statistics);
+
+    thread_local ScoreAccumulator accumulator;
+    accumulator.Reset(document_ids_.empty() ? 0 : *document_ids_.rbegin());
+    const bool check_attributes = filter.HasAttributeConditions();
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::POSTINGS);
+        for (const auto& [word, postings] : GetPlusPostings(query, budget != nullptr)) {
+            if (postings->DocumentCount() == 0) {
+                continue;
+            }
+            const uint32_t quantized_weight = QuantizeTermWeight(ComputeTermWeight(ranking, statistics, query, word, *postings), weight_scale);
+            for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                const PostingList& status_postings = postings->by_status[status];
+                if (!filter.statuses.test(status) || status_postings.empty()) {
+                    continue;
+                }
+                if (check_attributes || status_postings.HasRemoved()) {
+                    // id удаленных постингов могут быть больше наибольшего id документа, их пропускает итератор,
+                    // и бюджет расходуется только на живые постинги
+                    SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, status_postings.size());
+                    const bool completed = ForEachPosting(status_postings, budget, [&](int document_id, double term_freq) {
+                        if (!check_attributes || filter.Accepts(document_id, static_cast<DocumentStatus>(status), document_ratings_.Get(document_id))) {
+                            accumulator.Add(document_id, PostingList::QuantizeTermFreq(term_freq) * quantized_weight);
+                        }
+                    });
+                    if (!completed) {
+                        break;
+                    }
+                    continue;
+                }
+                const vector<int>& document_ids = status_postings.GetDocumentIds();
+                const uint8_t* impacts = status_postings.GetImpacts();
+                // без бюджета весь список - один блок
+                const size_t block_size = budget != nullptr ? SearchBudgetTracker::BLOCK_SIZE : document_ids.size();
+                for (size_t first = 0; first < document_ids.size(); first += block_size) {
+                    const size_t count = min(block_size, document_ids.size() - first);
+                    if (budget != nullptr && !budget->Consume(count)) {
+                        break;
+                    }
+                    SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, count);
+                    accumulator.AddPostings(document_ids.data() + first, impacts + first, count, quantized_weight);
+                }
+            }
+            if (budget != nullptr && budget->IsExhausted()) {
+                break;
             }
         }
-    );
+    }
 
+    if (!query.minus_words.empty()) {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::MINUS_WORDS);
+        accumulator.RemoveAll(CollectMinusDocuments(query, filter));
+    }
 
+    const double relevance_scale = weight_scale > 0.0 ? 1.0 / (255.0 * weight_scale) : 0.0;
     vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back({ document_id, relevance, documents_data_.at(document_id).rating });
+    const vector<pair<int, uint32_t>> scores = accumulator.Extract();
+    for (const auto& [document_id, score] : scores) {
+        AddMatchedDocument(matched_documents, page, { document_id, score * relevance_scale, document_ratings_.Get(document_id) });
     }
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, scores.size());
     return matched_documents;
+}
+
+void SearchServer::AddMatchedDocument(vector<Document>& documents, SearchPageCollector* page, const Document& document) {
+    if (page != nullptr) {
+        page->Add(document);
+    }
+    else {
+        documents.push_back(document);
+    }
+}
 
+bool SearchServer::CanUseDenseScores(size_t plus_word_count) const {
+    // максимальный вес слова должен уместиться в 16 бит, а сумма 256 слов - в 32 бита
+    const int max_document_id = document_ids_.empty() ? 0 : *document_ids_.rbegin();
+    const size_t max_dense_size = 8 * document_ids_.size() + 4096;
+    return plus_word_count <= 256 && static_cast<size_t>(max_document_id) <= max_dense_size;
+}
 
+double SearchServer::GetQuantizedWeightScale(const RankingStatistics& statistics) const {
+    // у слова, встречающегося в одном документе, наибольший вес
+    const double max_term_weight = TfIdfRanking().ComputeTermWeight(1, statistics);
+    return max_term_weight > 0.0 ? 65535.0 / max_term_weight : 0.0;
+}
 
+uint32_t SearchServer::QuantizeTermWeight(double term_weight, double weight_scale) {
+    // вес не меньше 1, чтобы документы со словом из всех документов (вес 0) не потерялись, как и в точном пути
+    return static_cast<uint32_t>(clamp(lround(term_weight * weight_scale), 1L, 65535L));
 }
 
+optional<vector<Document>> SearchServer::FindTopDocumentsByImpact(const Query& query, const DocumentFilter& filter) const {
+    if (impact_order_min_document_count_ == 0 || query.plus_words.empty() || !query.required_words.empty()
+        || filter.HasAttributeConditions() || !CanUseDenseScores(query.plus_words.size())) {
+        return nullopt;
+    }
+    const RankingStatistics statistics = GetRankingStatistics();
+    const TfIdfRanking ranking;
+    const double weight_scale = GetQuantizedWeightScale(statistics);
+
+    vector<pair<const WordPostings*, uint32_t>> rare_terms;
+    vector<pair<const WordPostings*, uint32_t>> frequent_terms;
+    for (string_view word : query.plus_words) {
+        const WordPostings* postings = FindPostings(word);
+        if (postings == nullptr || postings->DocumentCount() == 0) {
+            continue;
+        }
+        const uint32_t term_weight = QuantizeTermWeight(ComputeTermWeight(ranking, statistics, query, word, *postings), weight_scale);
+        (postings->impact_ordered ? frequent_terms : rare_terms).push_back({ postings, term_weight });
+    }
+    if (frequent_terms.empty()) {
+        return nullopt;
+    }
+
+    // сегмент частого слова и вклад, который он добавляет каждому своему документу
+    struct SegmentScore {
+        uint32_t score;
+        size_t term;
+        size_t status;
+        const ImpactOrderedPostings::Segment* segment;
+    };
+    vector<SegmentScore> segments;
+    for (size_t term = 0; term < frequent_terms.size(); ++term) {
+        const auto& [postings, term_weight] = frequent_terms[term];
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            if (!filter.statuses.test(status)) {
+                continue;
+            }
+            for (const ImpactOrderedPostings::Segment& segment : (*postings->impact_ordered)[status].GetSegments()) {
+                segments.push_back({ segment.impact * term_weight, term, status, &segment });
+            }
+        }
+    }
+    stable_sort(segments.begin(), segments.end(), [](const SegmentScore& lhs, const SegmentScore& rhs) {
+        return lhs.score > rhs.score;
+    });
+
+    // наибольший вклад, который еще может добавить документу каждое частое слово,
+    // и вклад следующего сегмента того же слова после каждого сегмента
+    vector<uint32_t> remaining_scores(frequent_terms.size());
+    vector<uint32_t> next_scores(segments.size());
+    for (size_t i = segments.size(); i-- > 0;) {
+        next_scores[i] = remaining_scores[segments[i].term];
+        remaining_scores[segments[i].term] = segments[i].score;
+    }
+    uint64_t remaining_score = 0;
+    for (const uint32_t score : remaining_scores) {
+        remaining_score += score;
+    }
+
+    const DocumentIdBitmap minus_documents = CollectMinusDocuments(query, filter);
+
+    thread_local ScoreAccumulator accumulator;
+    accumulator.Reset(document_ids_.empty() ? 0 : *document_ids_.rbegin());
+
+    // K + 1 документов без минус слов с наибольшими счетами: K-й должен оторваться от (K+1)-го
+    const size_t leader_count = MAX_RESULT_DOCUMENT_COUNT + 1;
+    vector<pair<uint32_t, int>> leaders;
+    uint32_t min_leader_score = 0;
+    const auto accumulate = [&](int document_id, uint32_t score) {
+        const uint32_t total_score = accumulator.Add(document_id, score);
+        if (leaders.size() == leader_count && total_score <= min_leader_score) {
+            return;
+        }
+        const auto leader = find_if(leaders.begin(), leaders.end(), [document_id](const auto& entry) {
+            return entry.second == document_id;
+        });
+        if (leader != leaders.end()) {
+            leader->first = total_score;
+        }
+        else if (minus_documents.Contains(document_id)) {
+            return;
+        }
+        else if (leaders.size() < leader_count) {
+            leaders.push_back({ total_score, document_id });
+        }
+        else {
+            *min_element(leaders.begin(), leaders.end()) = { total_score, document_id };
+        }
+        if (leaders.size() == leader_count) {
+            min_leader_score = min_element(leaders.begin(), leaders.end())->first;
+        }
+    };
+    const auto sort_leaders = [&leaders]() {
+        sort(leaders.begin(), leaders.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first > rhs.first;
+        });
+    };
+
+    const double relevance_scale = weight_scale > 0.0 ? 1.0 / (255.0 * weight_scale) : 0.0;
+    // документы с релевантностью ближе 1e-6 упорядочиваются по рейтингу, такой разрыв не считается отрывом
+    const uint64_t score_margin = relevance_scale > 0.0 ? static_cast<uint64_t>(1e-6 / relevance_scale) + 1 : 0;
+    size_t postings_touched = 0;
+    // наименьшая частота, сегмент которой уже пройден, по частым словам и статусам
+    vector<array<int, DOCUMENT_STATUS_COUNT>> lowest_processed_impacts(frequent_terms.size());
+    for (auto& impacts : lowest_processed_impacts) {
+        impacts.fill(256);
+    }
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::POSTINGS);
+        for (const auto& [postings, term_weight] : rare_terms) {
+            for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                if (!filter.statuses.test(status)) {
+                    continue;
+                }
+                for (const auto [document_id, term_freq] : postings->by_status[status]) {
+                    accumulate(document_id, PostingList::QuantizeTermFreq(term_freq) * term_weight);
+                }
+                postings_touched += postings->by_status[status].size();
+            }
+        }
+
+        size_t frequent_postings_touched = 0;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const SegmentScore& segment = segments[i];
+            for (const int document_id : segment.segment->document_ids) {
+                accumulate(document_id, segment.score);
+            }
+            frequent_postings_touched += segment.segment->document_ids.size();
+            lowest_processed_impacts[segment.term][segment.status] = segment.segment->impact;
+            remaining_score -= remaining_scores[segment.term] - next_scores[i];
+            remaining_scores[segment.term] = next_scores[i];
+
+            if (leaders.size() >= MAX_RESULT_DOCUMENT_COUNT) {
+                sort_leaders();
+                const uint64_t outside_score = leaders.size() == leader_count ? leaders.back().first : 0;
+                if (leaders[MAX_RESULT_DOCUMENT_COUNT - 1].first > outside_score + remaining_score + score_margin) {
+                    break;
+                }
+            }
+            if (impact_postings_budget_ > 0 && frequent_postings_touched >= impact_postings_budget_) {
+                break;
+            }
+        }
+        postings_touched += frequent_postings_touched;
+    }
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_TOUCHED, postings_touched);
+
+    sort_leaders();
+    vector<Document> matched_documents;
+    if (remaining_score == 0) {
+        // все постинги пройдены и счета точные: берем и документы вровень с K-м, чтобы порядок
+        // между ними, как и при полном обходе, определил рейтинг
+        const uint64_t min_score = leaders.size() >= MAX_RESULT_DOCUMENT_COUNT ? leaders[MAX_RESULT_DOCUMENT_COUNT - 1].first : 0;
+        for (const auto& [document_id, score] : accumulator.Extract()) {
+            if (score + score_margin >= min_score && !minus_documents.Contains(document_id)) {
+                matched_documents.push_back({ document_id, score * relevance_scale, document_ratings_.Get(document_id) });
+            }
+        }
+        SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, matched_documents.size());
+        return matched_documents;
+    }
+
+    if (leaders.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        leaders.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    // досчитываем документы топа по еще не пройденным сегментам частых слов
+    for (auto [score, document_id] : leaders) {
+        const size_t status = StatusIndex(documents_data_.at(document_id).document_status);
+        for (size_t term = 0; term < frequent_terms.size(); ++term) {
+            const auto& [postings, term_weight] = frequent_terms[term];
+            if (remaining_scores[term] == 0) {
+                continue;
+            }
+            if (const double* term_freq = postings->by_status[status].Find(document_id)) {
+                const uint8_t impact = PostingList::QuantizeTermFreq(*term_freq);
+                if (impact < lowest_processed_impacts[term][status]) {
+                    score += impact * term_weight;
+                }
+            }
+        }
+        matched_documents.push_back({ document_id, score * relevance_scale, document_ratings_.Get(document_id) });
+    }
+    accumulator.Clear();
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::CANDIDATES_SCORED, matched_documents.size());
+    return matched_documents;
+}
 
+template vector<Document> SearchServer::FindAllDocuments(const execution::sequenced_policy&, const Query&, const DocumentFilter&, const TfIdfRanking&,
+    SearchBudgetTracker*, SearchPageCollector*) const;
+template vector<Document> SearchServer::FindAllDocuments(const execution::parallel_policy&, const Query&, const DocumentFilter&, const TfIdfRanking&,
+    SearchBudgetTracker*, SearchPageCollector*) const;
+template vector<Document> SearchServer::FindAllDocuments(const execution::sequenced_policy&, const Query&, const DocumentFilter&, const Bm25Ranking&,
+    SearchBudgetTracker*, SearchPageCollector*) const;
+template vector<Document> SearchServer::FindAllDocuments(const execution::parallel_policy&, const Query&, const DocumentFilter&, const Bm25Ranking&,
+    SearchBudgetTracker*, SearchPageCollector*) const;
+template vector<Document> SearchServer::FindAllDocumentsByDocumentRanges(const Query&, const DocumentFilter&, const TfIdfRanking&) const;
+template vector<Document> SearchServer::FindAllDocumentsByDocumentRanges(const Query&, const DocumentFilter&, const Bm25Ranking&) const;
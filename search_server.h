@@ -1,29 +1,67 @@
 ﻿#pragma once
 
 #include <algorithm>		
+#include <array>
+#include <deque>
 #include <map>
+#include <memory>
 #include <numeric>
+#include <optional>
 #include <utility>
 #include <execution>
 #include <string_view>
 
+#include "adaptive_execution.h"
+#include "compressed_id_bitmap.h"
 #include "document.h"
+#include "document_filter.h"
+#include "impact_ordered_postings.h"
+#include "memory_usage.h"
+#include "node_pool.h"
+#include "paged_column.h"
+#include "posting_list.h"
+#include "positional_index.h"
+#include "query_expansion.h"
+#include "ranking.h"
+#include "term_dictionary.h"
+#include "search_budget.h"
+#include "search_metrics.h"
+#include "search_page.h"
 #include "string_processing.h"
 #include "paginator.h"
 #include "concurrent_map.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+// каждая правка уменьшает вклад похожего слова в релевантность во столько раз
+const double FUZZY_EDIT_WEIGHT = 0.5;
+// слово хотя бы из 1/DENSE_TERM_RATIO документов (и не меньше DENSE_TERM_MIN_DOCUMENT_COUNT)
+// хранит еще и сжатую битовую карту своих документов
+const int DENSE_TERM_RATIO = 64;
+const int DENSE_TERM_MIN_DOCUMENT_COUNT = 128;
+// FindTopDocumentsBatch накапливает релевантность сразу стольких запросов в плотных массивах
+const size_t BATCH_QUERY_CHUNK_SIZE = 16;
+// и тратит на плотные массивы (8 байт на id до наибольшего) не больше стольких байт за вызов;
+// если не помещается массив даже одного запроса, релевантность копится в хеш-таблицах по найденным документам
+const size_t BATCH_DENSE_SCORES_MAX_BYTES = size_t{ 32 } << 20;
+// параллельный обход по диапазонам документов делит id на столько диапазонов на поток, чтобы потоки загружались ровнее
+const size_t DOCUMENT_RANGES_PER_THREAD = 4;
+
+// порядок выдачи: по убыванию релевантности, при равной (с точностью 1e-6) - по убыванию рейтинга
+inline bool IsRankedHigher(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
+        return lhs.rating > rhs.rating;
+    }
+    else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
 
-enum class DocumentStatus {
-    ACTUAL,
-    IRRELEVANT,
-    BANNED,
-    REMOVED
-};
-
-class SearchServer {
+// словарь раскрытия запросов - собственные слова индекса (см. ExpandQuery)
+class SearchServer : private ExpansionDictionary {
 public:
+    // частоты слов документа; узлы выделяются так же, как остальные узлы индекса (см. SetNodeAllocation)
+    using WordFrequencies = CountedMap<std::string_view, double>;
 
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
@@ -46,7 +84,7 @@ public:
     template<typename DocumentSort>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentSort document_sort) const;
     
-    //общая функция которая принимает поточную/многопоточную версию
+    //общая функция которая принимает поточную/многопоточную версию и adaptive_execution
     template<typename ExecutionPolicy, typename DocumentSort>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentSort document_sort) const;
 
@@ -63,6 +101,96 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const;
 
+    /*
+    *
+    * Перегрузка функции поиска со структурированным фильтром: статусы, диапазон рейтинга,
+    * разрешенные и запрещенные id. Фильтр проверяется во время обхода постингов,
+    * а не после ранжирования, как предикат.
+    *
+    */
+
+    //однопоточная
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const;
+
+    //многопоточная/однопоточная
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter) const;
+
+    /*
+    *
+    * Перегрузка функции поиска с выбором функции ранжирования (TfIdfRanking, Bm25Ranking).
+    * Остальные перегрузки ранжируют по TF-IDF.
+    * Новые ранжирования нужно добавить в явные инстанцирования в search_server.cpp.
+    *
+    */
+
+    //однопоточная
+    template <typename Ranking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, const Ranking& ranking) const;
+
+    //многопоточная/однопоточная
+    template <typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+        const Ranking& ranking) const;
+
+    /*
+    *
+    * Перегрузка для шарда: "prefix*" и слова с опечатками раскрываются не по своему словарю,
+    * а по expansion, найденному заранее по словарю всего корпуса (см. QueryExpansion, ShardedSearchServer).
+    *
+    */
+
+    template <typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const QueryExpansion& expansion,
+        const DocumentFilter& filter, const Ranking& ranking) const;
+
+    /*
+    *
+    * Поиск с adaptive_execution: последовательно, параллельно по словам или параллельно по диапазонам id документов,
+    * в зависимости от суммы длин постингов плюс слов и числа выполняющихся вызовов (см. ChooseExecutionPath).
+    * Остальные перегрузки FindTopDocuments с политикой выполнения (кроме бюджета и страниц) приходят сюда.
+    *
+    */
+
+    template <typename Ranking>
+    std::vector<Document> FindTopDocuments(const AdaptiveExecutionPolicy&, std::string_view raw_query, const DocumentFilter& filter,
+        const Ranking& ranking) const;
+
+    /*
+    *
+    * Перегрузка функции поиска с бюджетом (TF-IDF): обход постингов блоками прерывается
+    * по крайнему сроку или после budget.max_postings постингов, тогда возвращается лучший топ
+    * по уже пройденным постингам с is_partial = true. Плюс слова обходятся от самых редких,
+    * чтобы прерванный поиск успел учесть самые весомые.
+    *
+    */
+
+    //однопоточная
+    SearchResult FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, const SearchBudget& budget) const;
+
+    //многопоточная/однопоточная
+    template <typename ExecutionPolicy>
+    SearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+        const SearchBudget& budget) const;
+
+    /*
+    *
+    * Постраничный поиск (TF-IDF): page_size документов, стоящих после cursor (без курсора - первая страница),
+    * в порядке IsBeforeOnPage. page_size 0 - исключение invalid_argument.
+    * Документы до курсора отбрасываются по мере ранжирования, страница набирается в куче
+    * из page_size + 1 документов (SearchPageCollector), так что глубокая страница стоит столько же, сколько первая.
+    *
+    */
+
+    //однопоточная
+    SearchPage FindTopDocumentsPage(std::string_view raw_query, const DocumentFilter& filter,
+        const std::optional<SearchCursor>& cursor, size_t page_size) const;
+
+    //многопоточная/однопоточная
+    template <typename ExecutionPolicy>
+    SearchPage FindTopDocumentsPage(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+        const std::optional<SearchCursor>& cursor, size_t page_size) const;
+
     //однопоточная
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
@@ -70,8 +198,36 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
 
+    /*
+    *
+    * Поиск по пакету запросов (TF-IDF), запрос i - с фильтром filters[i]. Постинги слова,
+    * общего для нескольких запросов, обходятся один раз, вклад разносится по накопителям запросов.
+    * Релевантность и рейтинги в результатах те же, что у FindTopDocuments(raw_queries[i], filters[i]),
+    * из документов с равными релевантностью и рейтингом может попасть другой. Запросы с обязательными
+    * словами или фильтрами по рейтингу и id, а также при квантованном ранжировании и упорядоченных
+    * по частоте постингах ищутся по отдельности. Плотные накопители занимают не больше
+    * BATCH_DENSE_SCORES_MAX_BYTES: при больших id запросов в части меньше, а если не помещается
+    * и один запрос, накопители - хеш-таблицы по найденным документам.
+    *
+    */
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+        const std::vector<DocumentFilter>& filters) const;
+
     int GetDocumentCount() const;
 
+    bool IsStopWord(std::string_view word) const override;
+
+    /*
+     *
+     * Наибольший вклад слова word в релевантность любого документа при ранжировании ranking
+     * (0, если слова нет). Граница не уменьшается при удалении документов, но остается верной.
+     *
+     */
+
+    template <typename Ranking>
+    double GetTermScoreUpperBound(std::string_view word, const Ranking& ranking) const;
+
     /*
      *
      * Функция, которая возвращает кортеж из вектора совпавших слов из raw_query в документе document_id.
@@ -88,6 +244,27 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&,
         std::string_view raw_query, int document_id) const;
 
+    // слова проверяются параллельно, если их в запросе не меньше parallel_match_min_words
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const AdaptiveExecutionPolicy&,
+        std::string_view raw_query, int document_id) const;
+
+    /*
+     *
+     * Матчинг запроса сразу с несколькими документами: запрос разбирается один раз,
+     * результаты возвращаются в порядке document_ids.
+     *
+     */
+
+    using MatchDocumentResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+
+    std::vector<MatchDocumentResult> MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::vector<MatchDocumentResult> MatchDocuments(const std::execution::sequenced_policy&,
+        std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::vector<MatchDocumentResult> MatchDocuments(const std::execution::parallel_policy&,
+        std::string_view raw_query, const std::vector<int>& document_ids) const;
+
 
     int GetDocumentId(int index) const;
 
@@ -95,38 +272,286 @@ public:
 
     std::set<int>::iterator end();
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
 
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
 
+    /*
+     *
+     * Замена текста, статуса и рейтингов документа без удаления и повторного добавления.
+     * Старые и новые слова сравниваются по прямому индексу, постинги меняются только у слов,
+     * которые исчезли, появились или изменили частоту. Если текст не изменился, он не разбирается заново.
+     * Если документа нет - исключение invalid_argument.
+     *
+     */
+
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // переносит постинги документа в часть нового статуса, частоты слов остаются прежними
+    void SetDocumentStatus(int document_id, DocumentStatus status);
+
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
+    // постинги слов удаляются параллельно, если их суммарная длина не меньше parallel_terms_min_postings
+    void RemoveDocument(const AdaptiveExecutionPolicy&, int document_id);
+
+    /*
+     *
+     * Отчет по метрикам поиска: время этапов запроса и счетчики постингов/кандидатов.
+     * Метрики собираются только при сборке с SEARCH_SERVER_METRICS, иначе отчет пустой.
+     *
+     */
+
+    SearchMetricsReport GetMetricsReport() const;
+
+    void ResetMetrics();
+
+    /*
+     *
+     * Включает позиционный индекс: позиции слов строятся для уже добавленных документов
+     * и для всех последующих. Без него фразы ("funny pet") и NEAR/k в запросах тоже работают,
+     * но позиции приходится искать разбором текста каждого документа-кандидата.
+     *
+     */
+
+    void EnablePositionalIndex();
+
+    // сколько байт занимают позиции слов всех документов
+    size_t GetPositionalIndexByteSize() const;
+
+    /*
+     *
+     * Нечеткий поиск: плюс слово запроса, которого нет в индексе, заменяется словами
+     * на расстоянии Левенштейна не больше max_distance (1 или 2, 0 - выключить).
+     * Расстояние считается в байтах, для коротких слов оно уменьшается: до 2 символов - точное совпадение,
+     * до 5 - одна правка. Вклад найденных слов уменьшается в FUZZY_EDIT_WEIGHT раз за каждую правку.
+     *
+     */
+
+    void SetFuzzyMatching(int max_distance);
+
+    /*
+     *
+     * Квантованное ранжирование для TF-IDF: частоты хранятся байтом на постинг, вес слова - 16 бит,
+     * счета копятся 32-битными целыми в массиве по id документа. Релевантность приближенная,
+     * точный расчет в double остается при выключенном режиме. Если id документов сильно разрежены
+     * или в запросе больше 256 плюс слов, поиск идет точным путем.
+     *
+     */
+
+    void SetQuantizedScoring(bool enabled);
+
+    /*
+     *
+     * Упорядоченные по частоте постинги для слов, встречающихся не меньше чем в min_document_count документах
+     * (0 - выключить). Запрос TF-IDF без обязательных слов и фильтров по рейтингу и id тогда обходит
+     * сегменты частых слов по убыванию вклада и останавливается, как только топ больше не может измениться.
+     * Релевантность квантована, как в SetQuantizedScoring. Если postings_budget больше 0, обход прерывается
+     * и после стольких постингов частых слов - топ тогда приближенный.
+     *
+     */
+
+    void SetImpactOrderedPostings(size_t min_document_count, size_t postings_budget = 0);
+
+    /*
+     *
+     * Веса слов считаются по статистике statistics, а не по своим документам (nullptr - снова по своим).
+     * Нужно шарду, которому принадлежит только часть корпуса. statistics должна жить,
+     * пока ее не заменят или пока жива поисковая система.
+     *
+     */
+
+    void SetCorpusStatistics(const CorpusStatistics* statistics);
+
+    // статистика только своих документов, без учета SetCorpusStatistics
+    RankingStatistics GetLocalRankingStatistics() const;
+
+    size_t GetLocalDocumentFreq(std::string_view word) const;
+
+    /*
+     *
+     * Память по структурам индекса (запрошенные байты и накладные расходы malloc), байты на документ
+     * и распределение размеров постингов. Внутренние контейнеры считают свои узлы через CountingAllocator,
+     * для контейнеров, тип которых виден снаружи (стоп слова, id документов, частоты слов документа),
+     * размер узла измеряется один раз.
+     *
+     */
+
+    IndexMemoryReport GetMemoryReport() const;
+
+    /*
+     *
+     * Откуда берутся узлы деревьев индекса (документы, частоты слов документов, рейтинги, новые слова):
+     * из malloc или из пула с плотными аренами, в том числе на огромных страницах.
+     * Уже добавленные узлы переносятся в новое место за O(N).
+     *
+     */
+
+    void SetNodeAllocation(NodeAllocation allocation);
+
+    NodePoolStatistics GetNodePoolStatistics() const;
+
+    /*
+     *
+     * Пороги выбора пути для вызовов с adaptive_execution. Пока они не заданы, используются
+     * GetDefaultAdaptiveExecution: пороги замера WarmUpAdaptiveExecution, если его вызвали при запуске программы.
+     *
+     */
+
+    void SetAdaptiveExecutionThresholds(const AdaptiveExecutionThresholds& thresholds);
+
+    const AdaptiveExecutionThresholds& GetAdaptiveExecutionThresholds() const;
+
+    // сколько вызовов с adaptive_execution выполнено каждым путем
+    AdaptiveExecutionStatistics GetAdaptiveExecutionStatistics() const;
+
 
 
 
 private:
     struct DocumentInformation {
-        int rating;
         DocumentStatus document_status;
         //Сохраняем тексты документов для создания
         std::string text;               
+        // номер строки текста в save_text, на которую ссылаются string_view индекса
+        size_t text_index = 0;
+        // отсортированные id слов документа (прямой индекс для MatchDocument)
+        std::vector<int> term_ids;
+        // позиции слов в порядке term_ids, заполняются при включенном позиционном индексе
+        DocumentPositions positions;
     };
 
     const TransparentStringSet stop_words_;
     //Сохраняем тексты документов для создания
-    std::vector<std::string> save_text;
-    std::map<std::string_view, double> empty_map;
-
-    std::map<int, DocumentInformation> documents_data_;
+    // deque: добавление не перемещает уже сохраненные строки, на которые ссылаются string_view индекса
+    // строка удаленного или измененного документа освобождается, но остается в deque пустой, чтобы номера не сдвигались
+    std::deque<std::string, CountingAllocator<std::string>> save_text;
+    // слова, впервые встреченные в освобожденных текстах документов
+    std::deque<std::string, CountingAllocator<std::string>> term_words_;
+    WordFrequencies empty_map;
+
+    CountedMap<int, DocumentInformation> documents_data_;
     std::set<int> document_ids_;
 
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> id_word_frequencies_;
+    // рейтинги хранятся колонкой по id и отдельно упорядоченными по рейтингу для фильтров по диапазону
+    PagedColumn<int> document_ratings_;
+    // число слов документа без стоп слов и их сумма по всем документам - для BM25
+    PagedColumn<int> document_lengths_;
+    size_t total_document_length_ = 0;
+    CountedSet<std::pair<int, int>> rating_to_document_ids_;
 
+    /*
+     *
+     * Постинги слова, разбитые по статусам документов.
+     * Поиск с фильтром по статусу обходит только свою часть и не тратит время
+     * на документы с другими статусами.
+     *
+     */
+    struct WordPostings {
+        std::array<PostingList, DOCUMENT_STATUS_COUNT> by_status;
+        // наибольшие доля и число вхождений слова среди добавленных документов
+        double max_term_freq = 0.0;
+        int max_term_count = 0;
+        // постинги по убыванию частоты, строятся только для частых слов
+        std::unique_ptr<std::array<ImpactOrderedPostings, DOCUMENT_STATUS_COUNT>> impact_ordered;
+        // документы всех статусов, только для частых слов: минус слова вычитаются из кандидатов картой
+        std::unique_ptr<CompressedIdBitmap> document_bitmap;
+
+        size_t DocumentCount() const;
+    };
 
-    bool IsStopWord(std::string_view word) const;
+    // постинги по id слова
+    std::vector<WordPostings> term_postings_;
+    // слово по его id, id не переиспользуются
+    std::vector<std::string_view> term_id_to_word_;
+
+    /*
+     *
+     * id слова ищется в сжатом отсортированном словаре и в map слов, появившихся после его построения.
+     * Когда новых слов набирается четверть словаря, словарь строится заново,
+     * так что большая часть слов не тратит память на узлы дерева.
+     *
+     */
+    TermDictionary term_dictionary_;
+    CountedMap<std::string_view, int> new_terms_;
+
+    bool positional_index_enabled_ = false;
+    int fuzzy_max_distance_ = 0;
+    bool quantized_scoring_enabled_ = false;
+    size_t impact_order_min_document_count_ = 0;
+    size_t impact_postings_budget_ = 0;
+    const CorpusStatistics* corpus_statistics_ = nullptr;
+    CountedMap<int, WordFrequencies> id_word_frequencies_;
+    // общий аллокатор частот слов всех документов
+    WordFrequencies::allocator_type word_frequencies_allocator_;
+    std::shared_ptr<NodePool> node_pool_;
+
+    std::optional<AdaptiveExecutionThresholds> adaptive_thresholds_;
+    // выполняющиеся вызовы и выбранные пути пишутся из константных методов поиска
+    mutable std::unique_ptr<AdaptiveExecutionCounters> adaptive_counters_ = std::make_unique<AdaptiveExecutionCounters>();
+
+#ifdef SEARCH_SERVER_METRICS
+    // метрики пишутся из константных методов поиска, запись в них потокобезопасна
+    mutable std::unique_ptr<SearchMetrics> metrics_ = std::make_unique<SearchMetrics>();
+#endif
+
+
+    std::optional<int> FindTermId(std::string_view word) const;
+
+    // постинги слова или nullptr, если слова нет ни в одном документе
+    const WordPostings* FindPostings(std::string_view word) const;
+
+    // id слова, новое слово получает следующий id
+    int AddTerm(std::string_view word);
+
+    void RebuildTermDictionary();
+
+    bool HasWord(std::string_view word) const override;
+
+    // слова индекса, начинающиеся с prefix: и из словаря, и добавленные после его построения
+    std::vector<ExpansionCandidate> FindByPrefix(std::string_view prefix) const override;
+
+    // слова индекса, которые принимает automaton, и расстояния до них
+    std::vector<ExpansionCandidate> FindWithinDistance(const LevenshteinAutomaton& automaton) const override;
+
+    static size_t StatusIndex(DocumentStatus status);
+
+    static void BuildImpactOrder(WordPostings& postings);
+
+    static void BuildDocumentBitmap(WordPostings& postings);
+
+    // удаляет документ из постингов слова, в том числе упорядоченных по частоте
+    static void ErasePosting(WordPostings& postings, size_t status, int document_id);
+
+    // добавляет документ из document_length слов в постинги слова, упорядоченные по частоте постинги и карту документов
+    void InsertPosting(WordPostings& postings, size_t status, int document_id, double term_freq, size_t document_length);
+
+    // учитывает документ из document_length слов в наибольших доле и числе вхождений слова
+    static void UpdateTermMaxima(WordPostings& postings, double term_freq, size_t document_length);
+
+    void SetDocumentRating(int document_id, int rating);
+
+    /*
+     *
+     * Освобождает строку текста документа в save_text. Слова индекса, ссылающиеся на нее,
+     * сначала копируются в term_words_. Частоты слов документа после этого использовать нельзя.
+     *
+     */
+
+    void ReleaseDocumentText(const DocumentInformation& document);
+
+    // документ для изменения, если его нет - исключение invalid_argument
+    DocumentInformation& GetDocumentForUpdate(int document_id);
+
+    /*
+     *
+     * Есть ли слово word в документе document_id со статусом status
+     *
+     */
+
+    bool IsWordInDocument(std::string_view word, int document_id, DocumentStatus status) const;
 
     /*
      *
@@ -155,6 +580,9 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_required;
+        // "word*" - все слова, начинающиеся с word
+        bool is_prefix;
     };
 
     /*
@@ -166,39 +594,296 @@ private:
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    /*
+     *
+     * Обязательные слова (с префиксом "+") входят и в plus_words:
+     * документ должен содержать их все, остальные плюс слова только добавляют релевантность.
+     *
+     */
+
+    /*
+     *
+     * Ограничение на позиции слов: фраза в кавычках - слова стоят подряд (пропущенные стоп слова
+     * тоже занимают позицию), NEAR/k - два слова не дальше k позиций друг от друга.
+     * Слова ограничений считаются обязательными.
+     *
+     */
+
+    struct PositionalConstraint {
+        // слово и его смещение от начала фразы (для NEAR/k - 0)
+        std::vector<std::pair<std::string_view, int>> words;
+        bool is_phrase = true;
+        int max_distance = 0;
+    };
+
     struct Query {
         std::set<std::string_view> plus_words;
         std::set<std::string_view> minus_words;
+        std::set<std::string_view> required_words;
+        std::vector<PositionalConstraint> positional_constraints;
+        // вес плюс слов, найденных нечетким поиском, у остальных слов вес 1
+        std::map<std::string_view, double> word_weights;
+
+        double GetWeight(std::string_view word) const;
     };
 
     /*
      *
      * Разбивает строку-запрос на плюс и минус слова, исключая стоп слова.
      * Возвращает структуру с двумя множествами этих слов.
+     * "word*" заменяется на найденные в индексе слова с этим префиксом.
+     * "word*" и слова с опечатками раскрываются по expansion, без него - ExpandQuery по своему словарю.
+     *
+     */
+
+    Query ParseQuery(std::string_view text, const QueryExpansion* expansion = nullptr) const;
+
+    /*
+     *
+     * Разбор фразы в кавычках, начинающейся со слова words[first].
+     * Возвращает индекс последнего слова фразы.
      *
      */
 
-    Query ParseQuery(std::string_view text) const;
+    size_t ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const;
+
+    // k для оператора "NEAR/k"
+    static std::optional<int> ParseNearDistance(std::string_view word);
 
     /*
      *
-     * Вычисление IDF слова
+     * Запрос, в котором слова заменены на их id. Слова, которых нет ни в одном документе, отброшены.
+     * Плюс слова идут в том же порядке, что и в Query.
      *
      */
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    struct CompiledConstraint {
+        // id слова (-1, если его нет в документах) и смещение во фразе
+        std::vector<std::pair<int, int>> terms;
+        bool is_phrase = true;
+        int max_distance = 0;
+    };
+
+    struct CompiledQuery {
+        std::vector<std::pair<int, std::string_view>> plus_terms;
+        std::vector<int> minus_term_ids;
+        // -1 для обязательного слова, которого нет ни в одном документе
+        std::vector<int> required_term_ids;
+        std::vector<CompiledConstraint> constraints;
+    };
+
+    CompiledQuery CompileQuery(const Query& query) const;
+
+    std::vector<CompiledConstraint> CompileConstraints(const Query& query) const;
+
+    DocumentPositions BuildDocumentPositions(std::string_view text, const std::vector<int>& term_ids) const;
+
+    /*
+     *
+     * Позиции слова в документе: из позиционного индекса, если он включен, иначе разбором текста
+     *
+     */
+
+    std::vector<int> GetTermPositions(const DocumentInformation& document, int term_id) const;
+
+    bool MatchesConstraints(const std::vector<CompiledConstraint>& constraints, int document_id) const;
+
+    // оставляет только кандидатов, удовлетворяющих позиционным ограничениям
+    template <typename ExecutionPolicy>
+    std::vector<int> FilterByConstraints(const ExecutionPolicy& policy, const std::vector<CompiledConstraint>& constraints,
+        std::vector<int> candidates) const;
+
+    /*
+     *
+     * Матчинг скомпилированного запроса по прямому индексу документа:
+     * бинарный поиск id слов в отсортированном массиве id слов документа
+     *
+     */
+
+    template <typename ExecutionPolicy>
+    MatchDocumentResult MatchCompiledQuery(const ExecutionPolicy& policy, const CompiledQuery& query, int document_id) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<MatchDocumentResult> MatchDocumentsImpl(const ExecutionPolicy& policy,
+        std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    RankingStatistics GetRankingStatistics() const;
+
+    // в скольких документах корпуса встречается слово с постингами postings
+    size_t GetDocumentFreq(std::string_view word, const WordPostings& postings) const;
+
+    /*
+     *
+     * Вес слова для ranking с учетом веса слова в запросе (у слов нечеткого поиска он меньше 1)
+     *
+     */
+
+    template <typename Ranking>
+    double ComputeTermWeight(const Ranking& ranking, const RankingStatistics& statistics, const Query& query,
+        std::string_view word, const WordPostings& postings) const;
+
+    // вклад слова в релевантность документа; длина документа читается, только если она нужна ranking
+    template <typename Ranking>
+    double ScorePosting(const Ranking& ranking, const RankingStatistics& statistics, double term_weight,
+        int document_id, double term_freq) const;
 
     /*
      *
      * Нахождение документов по запросу(в каких документах находтся слова при учитовании минус слов) + вычисление IDF
+     * Обходятся только постинги документов со статусами фильтра, остальные условия фильтра
+     * проверяются на каждом постинге. Если фильтр узкий, вместо обхода постингов
+     * проверяются только подходящие под фильтр документы.
+     * С page найденные документы сразу отдаются в страницу (документы до ее курсора
+     * не попадают даже во временный список), а результат пуст.
+     *
+     */
+
+    // топ по разобранному запросу: обход по убыванию вклада, если он применим, иначе FindAllDocuments
+    template <typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocumentsForQuery(const ExecutionPolicy& policy, const Query& query, const DocumentFilter& filter,
+        const Ranking& ranking) const;
+
+    template <typename Ranking>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, const DocumentFilter& filter,
+        const Ranking& ranking, SearchBudgetTracker* budget = nullptr, SearchPageCollector* page = nullptr) const;
+
+    template <typename Ranking>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, const DocumentFilter& filter,
+        const Ranking& ranking, SearchBudgetTracker* budget = nullptr, SearchPageCollector* page = nullptr) const;
+
+    // найденный документ - в страницу page, если она собирается, иначе в documents
+    static void AddMatchedDocument(std::vector<Document>& documents, SearchPageCollector* page, const Document& document);
+
+    /*
+     *
+     * Путь поиска запроса с adaptive_execution, учтенный в счетчиках. Обход по диапазонам документов
+     * выбирается только для запросов без обязательных слов, с плотными id документов и без квантованного ранжирования.
+     *
+     */
+
+    ExecutionPath ChooseSearchPath(const Query& query, const DocumentFilter& filter) const;
+
+    /*
+     *
+     * Параллельный обход по диапазонам id документов: каждый диапазон проходит постинги всех плюс слов
+     * от своего первого id и копит счета в своем плотном массиве, без блокировок. Релевантность та же,
+     * что у последовательной версии: вклады слов складываются в том же порядке.
+     *
+     */
+
+    template <typename Ranking>
+    std::vector<Document> FindAllDocumentsByDocumentRanges(const Query& query, const DocumentFilter& filter,
+        const Ranking& ranking) const;
+
+    /*
+     *
+     * Постинги найденных в индексе плюс слов. С rarest_first - по возрастанию числа документов,
+     * иначе в порядке слов запроса.
+     *
+     */
+
+    std::vector<std::pair<std::string_view, const WordPostings*>> GetPlusPostings(const Query& query, bool rarest_first) const;
+
+    /*
+     *
+     * Вызывает function(document_id, term_freq) для постингов postings. С бюджетом - блоками,
+     * списывая каждый блок до его обхода. false, если обход прерван бюджетом.
+     *
+     */
+
+    template <typename Function>
+    static bool ForEachPosting(const PostingList& postings, SearchBudgetTracker* budget, Function function);
+
+    /*
+     *
+     * Обход постингов с квантованным TF-IDF. std::nullopt, если для запроса нужен точный путь.
+     * Накопление идет в общий массив счетов, поэтому выполняется в одном потоке и для par версии.
+     *
+     */
+
+    std::optional<std::vector<Document>> FindAllDocumentsQuantized(const Query& query, const DocumentFilter& filter,
+        SearchBudgetTracker* budget, SearchPageCollector* page) const;
+
+    // помещаются ли счета документов в массив по id и их сумма - в 32 бита
+    bool CanUseDenseScores(size_t plus_word_count) const;
+
+    // множитель, переводящий вес слова в 16 бит
+    double GetQuantizedWeightScale(const RankingStatistics& statistics) const;
+
+    static uint32_t QuantizeTermWeight(double term_weight, double weight_scale);
+
+    /*
+     *
+     * Поиск по упорядоченным по частоте постингам (score-at-a-time): редкие слова обходятся целиком,
+     * сегменты частых - по убыванию вклада, пока K-й документ топа не опередит (K+1)-й
+     * на оставшийся наибольший вклад. Возвращает только документы топа с досчитанной релевантностью
+     * или std::nullopt, если запрос нужно искать обычным обходом.
+     *
+     */
+
+    std::optional<std::vector<Document>> FindTopDocumentsByImpact(const Query& query, const DocumentFilter& filter) const;
+
+    /*
+     *
+     * Сколько постингов плюс слов придется обойти для статусов statuses
+     *
+     */
+
+    size_t CountPostings(const Query& query, const DocumentStatusSet& statuses) const;
+
+    /*
+     *
+     * Документы со статусами фильтра, содержащие хоть одно минус слово, плотной битовой картой.
+     * Карты частых слов объединяются пословно, id остальных вставляются по одному.
+     *
+     */
+
+    DocumentIdBitmap CollectMinusDocuments(const Query& query, const DocumentFilter& filter) const;
+
+    // можно ли искать запрос вместе с другими в FindTopDocumentsBatch
+    bool CanEvaluateInBatch(const Query& query, const DocumentFilter& filter) const;
+
+    /*
+     *
+     * Список документов, проходящих фильтр, если его можно получить не дороже limit проверок
+     * (по разрешенным id или по диапазону рейтинга). Иначе std::nullopt.
      *
      */
 
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query) const;
+    std::optional<std::vector<int>> CollectFilterCandidates(const DocumentFilter& filter, size_t limit) const;
 
-    std::vector<Document> FindAllDocuments(const Query& query) const;
+    /*
+     *
+     * Документы, содержащие все обязательные слова запроса и проходящие фильтр.
+     * Постинги пересекаются отдельно в каждой части по статусу, начиная с самого короткого списка.
+     *
+     */
 
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query) const;
+    std::vector<int> FindConjunctiveCandidates(const Query& query, const DocumentFilter& filter) const;
+
+    /*
+     *
+     * Вычисление релевантности только для документов candidates
+     *
+     */
+
+    template <typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> ScoreCandidates(const ExecutionPolicy& policy, const Query& query, const std::vector<int>& candidates,
+        const Ranking& ranking, SearchBudgetTracker* budget, SearchPageCollector* page = nullptr) const;
+
+    /*
+     *
+     * Сортировка найденных документов по релевантности (при равенстве - по рейтингу)
+     * и отсечение лишних до MAX_RESULT_DOCUMENT_COUNT
+     *
+     */
+
+    template <typename ExecutionPolicy>
+    void SortTopDocuments(const ExecutionPolicy& policy, std::vector<Document>& documents) const;
+
+    // отбрасывает документы, не прошедшие предикат, и сортирует оставшиеся
+    template <typename ExecutionPolicy, typename DocumentSort>
+    std::vector<Document> FilterTopDocuments(const ExecutionPolicy& policy, std::vector<Document> documents, DocumentSort document_sort) const;
 
 };
 
@@ -217,9 +902,117 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 
 template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus input_status, int rating) {
-        return input_status == status;
-    });
+    // фильтр по статусу не нужно проверять предикатом: обходим только постинги нужного статуса
+    return FindTopDocuments(policy, raw_query, DocumentFilter::ByStatus(status));
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter) const {
+    return FindTopDocuments(policy, raw_query, filter, TfIdfRanking());
+}
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, const Ranking& ranking) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter, ranking);
+}
+
+template <typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+    const Ranking& ranking) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOTAL);
+    return FindTopDocumentsForQuery(policy, ParseQuery(raw_query), filter, ranking);
+}
+
+template <typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const QueryExpansion& expansion,
+    const DocumentFilter& filter, const Ranking& ranking) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOTAL);
+    return FindTopDocumentsForQuery(policy, ParseQuery(raw_query, &expansion), filter, ranking);
+}
+
+template <typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(const ExecutionPolicy& policy, const Query& query, const DocumentFilter& filter,
+    const Ranking& ranking) const {
+    if constexpr (std::is_same_v<Ranking, TfIdfRanking>) {
+        if (auto documents = FindTopDocumentsByImpact(query, filter)) {
+            SortTopDocuments(policy, *documents);
+            return std::move(*documents);
+        }
+    }
+    auto matched_documents = FindAllDocuments(policy, query, filter, ranking);
+
+    SortTopDocuments(policy, matched_documents);
+    return matched_documents;
+}
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(const AdaptiveExecutionPolicy&, std::string_view raw_query, const DocumentFilter& filter,
+    const Ranking& ranking) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOTAL);
+    const auto active_call = adaptive_counters_->StartCall();
+    const Query query = ParseQuery(raw_query);
+    if constexpr (std::is_same_v<Ranking, TfIdfRanking>) {
+        // обход по убыванию вклада останавливается рано и выполняется в одном потоке
+        if (auto documents = FindTopDocumentsByImpact(query, filter)) {
+            adaptive_counters_->Record(ExecutionPath::SEQUENTIAL);
+            SortTopDocuments(std::execution::seq, *documents);
+            return std::move(*documents);
+        }
+    }
+
+    std::vector<Document> matched_documents;
+    switch (ChooseSearchPath(query, filter)) {
+    case ExecutionPath::SEQUENTIAL:
+        matched_documents = FindAllDocuments(std::execution::seq, query, filter, ranking);
+        SortTopDocuments(std::execution::seq, matched_documents);
+        break;
+    case ExecutionPath::PARALLEL_TERMS:
+        matched_documents = FindAllDocuments(std::execution::par, query, filter, ranking);
+        SortTopDocuments(std::execution::par, matched_documents);
+        break;
+    case ExecutionPath::PARALLEL_DOCUMENT_RANGES:
+        matched_documents = FindAllDocumentsByDocumentRanges(query, filter, ranking);
+        SortTopDocuments(std::execution::par, matched_documents);
+        break;
+    }
+    return matched_documents;
+}
+
+template <typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+    const SearchBudget& budget) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOTAL);
+    const Query query = ParseQuery(raw_query);
+    SearchBudgetTracker tracker(budget);
+    SearchResult result;
+    result.documents = FindAllDocuments(policy, query, filter, TfIdfRanking(), &tracker);
+    result.is_partial = tracker.IsExhausted();
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::DEADLINE_EXCEEDED, tracker.IsDeadlineExceeded() ? 1 : 0);
+    SEARCH_METRICS_ADD(*metrics_, SearchCounter::POSTINGS_BUDGET_EXCEEDED, tracker.IsPostingsBudgetExceeded() ? 1 : 0);
+
+    SortTopDocuments(policy, result.documents);
+    return result;
+}
+
+template <typename ExecutionPolicy>
+SearchPage SearchServer::FindTopDocumentsPage(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+    const std::optional<SearchCursor>& cursor, size_t page_size) const {
+    SearchPageCollector page(cursor, page_size);
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOTAL);
+    FindAllDocuments(policy, ParseQuery(raw_query), filter, TfIdfRanking(), nullptr, &page);
+
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOP_K);
+    return page.Finish();
+}
+
+template <typename Ranking>
+double SearchServer::GetTermScoreUpperBound(std::string_view word, const Ranking& ranking) const {
+    const WordPostings* postings = FindPostings(word);
+    if (postings == nullptr || postings->DocumentCount() == 0) {
+        return 0.0;
+    }
+    const double term_weight = ranking.ComputeTermWeight(GetDocumentFreq(word, *postings), GetRankingStatistics());
+    return ranking.ComputeUpperBound(term_weight, postings->max_term_freq, postings->max_term_count);
 }
 
 template <typename ExecutionPolicy>
@@ -230,34 +1023,59 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
 
 template<typename ExecutionPolicy, typename DocumentSort>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentSort document_sort) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOTAL);
 
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query);
-
-/// для параллельного случая сортировка так же долна быть параллельной
-/// не проверял, но возможно будет достаточно передать policy в параллельную версию sort
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
-        });
-
-    std::vector<Document> matched_documents_reborn;
-    for (const auto& document : matched_documents) {
-        if (document_sort(document.id, documents_data_.at(document.id).document_status, document.rating)) {
-            matched_documents_reborn.push_back(document);
-        }
-        else {   /// лишний оператор
-            continue;
+    if constexpr (std::is_same_v<ExecutionPolicy, AdaptiveExecutionPolicy>) {
+        // путь выбирается по постингам запроса, предикат проверяется уже после поиска
+        const auto active_call = adaptive_counters_->StartCall();
+        std::vector<Document> matched_documents;
+        switch (ChooseSearchPath(query, DocumentFilter())) {
+        case ExecutionPath::SEQUENTIAL:
+            matched_documents = FilterTopDocuments(std::execution::seq,
+                FindAllDocuments(std::execution::seq, query, DocumentFilter(), TfIdfRanking()), document_sort);
+            break;
+        case ExecutionPath::PARALLEL_TERMS:
+            matched_documents = FilterTopDocuments(std::execution::par,
+                FindAllDocuments(std::execution::par, query, DocumentFilter(), TfIdfRanking()), document_sort);
+            break;
+        case ExecutionPath::PARALLEL_DOCUMENT_RANGES:
+            matched_documents = FilterTopDocuments(std::execution::par,
+                FindAllDocumentsByDocumentRanges(query, DocumentFilter(), TfIdfRanking()), document_sort);
+            break;
         }
+        return matched_documents;
+    }
+    else {
+        return FilterTopDocuments(policy, FindAllDocuments(policy, query, DocumentFilter(), TfIdfRanking()), document_sort);
     }
+}
 
-    if (matched_documents_reborn.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents_reborn.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename ExecutionPolicy, typename DocumentSort>
+std::vector<Document> SearchServer::FilterTopDocuments(const ExecutionPolicy& policy, std::vector<Document> documents,
+    DocumentSort document_sort) const {
+    // произвольный предикат проверяем до сортировки, чтобы не сортировать отброшенные документы
+    {
+        SEARCH_METRICS_STAGE(*metrics_, SearchStage::PREDICATE);
+        documents.erase(std::remove_if(documents.begin(), documents.end(),
+            [this, &document_sort](const Document& document) {
+                return !document_sort(document.id, documents_data_.at(document.id).document_status, document.rating);
+            }),
+            documents.end());
     }
 
-    return matched_documents_reborn;
+    SortTopDocuments(policy, documents);
+    return documents;
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::SortTopDocuments(const ExecutionPolicy& policy, std::vector<Document>& documents) const {
+    SEARCH_METRICS_STAGE(*metrics_, SearchStage::TOP_K);
+    std::sort(policy, documents.begin(), documents.end(), IsRankedHigher);
+
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        // не держим у вызывающего память под все найденные документы
+        documents.shrink_to_fit();
+    }
 }
@@ -0,0 +1,138 @@
+#include <functional>
+
+#include "sharded_search_server.h"
+
+using namespace std;
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    SearchServer& shard = *shards_[GetShardIndex(document_id)];
+    shard.AddDocument(document_id, document, status, ratings);
+    AddDocumentFreqs(shard.GetWordFrequencies(document_id));
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, DocumentFilter::ByStatus(status));
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const {
+    return FindTopDocuments(raw_query, filter, TfIdfRanking());
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)]->MatchDocument(raw_query, document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    SearchServer& shard = *shards_[GetShardIndex(document_id)];
+    RemoveDocumentFreqs(shard.GetWordFrequencies(document_id));
+    shard.RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    SearchServer& shard = *shards_[GetShardIndex(document_id)];
+    RemoveDocumentFreqs(shard.GetWordFrequencies(document_id));
+    try {
+        shard.UpdateDocument(document_id, document, status, ratings);
+    }
+    catch (...) {
+        // отвергнутое обновление не меняет документ
+        AddDocumentFreqs(shard.GetWordFrequencies(document_id));
+        throw;
+    }
+    AddDocumentFreqs(shard.GetWordFrequencies(document_id));
+}
+
+void ShardedSearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    shards_[GetShardIndex(document_id)]->SetDocumentStatus(document_id, status);
+}
+
+void ShardedSearchServer::SetFuzzyMatching(int max_distance) {
+    // шардам - для MatchDocument, поиск раскрывает слова сам
+    for (const auto& shard : shards_) {
+        shard->SetFuzzyMatching(max_distance);
+    }
+    fuzzy_max_distance_ = max_distance;
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return hash<int>{}(document_id) % shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return *shards_.at(index);
+}
+
+RankingStatistics ShardedSearchServer::GetRankingStatistics() const {
+    RankingStatistics statistics;
+    double total_document_length = 0.0;
+    for (const auto& shard : shards_) {
+        const RankingStatistics shard_statistics = shard->GetLocalRankingStatistics();
+        statistics.document_count += shard_statistics.document_count;
+        total_document_length += shard_statistics.average_document_length * shard_statistics.document_count;
+    }
+    if (statistics.document_count > 0) {
+        statistics.average_document_length = total_document_length / statistics.document_count;
+    }
+    return statistics;
+}
+
+size_t ShardedSearchServer::GetDocumentFreq(string_view word) const {
+    const auto it = document_freqs_.find(word);
+    return it != document_freqs_.end() ? it->second : 0;
+}
+
+void ShardedSearchServer::AddDocumentFreqs(const SearchServer::WordFrequencies& word_frequencies) {
+    for (const auto& [word, term_freq] : word_frequencies) {
+        auto it = document_freqs_.find(word);
+        if (it == document_freqs_.end()) {
+            it = document_freqs_.emplace(string(word), 0).first;
+        }
+        ++it->second;
+    }
+}
+
+void ShardedSearchServer::RemoveDocumentFreqs(const SearchServer::WordFrequencies& word_frequencies) {
+    for (const auto& [word, term_freq] : word_frequencies) {
+        --document_freqs_.find(word)->second;
+    }
+}
+
+bool ShardedSearchServer::IsStopWord(string_view word) const {
+    return shards_.front()->IsStopWord(word);
+}
+
+bool ShardedSearchServer::HasWord(string_view word) const {
+    return document_freqs_.count(word) > 0;
+}
+
+vector<ExpansionCandidate> ShardedSearchServer::FindByPrefix(string_view prefix) const {
+    vector<ExpansionCandidate> candidates;
+    for (auto it = document_freqs_.lower_bound(prefix); it != document_freqs_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        candidates.push_back({ it->first, it->second, 0 });
+    }
+    return candidates;
+}
+
+vector<ExpansionCandidate> ShardedSearchServer::FindWithinDistance(const LevenshteinAutomaton& automaton) const {
+    vector<ExpansionCandidate> candidates;
+    ForEachTermWithinDistance(automaton, document_freqs_, [&candidates](auto it, int distance) {
+        candidates.push_back({ it->first, it->second, distance });
+    });
+    return candidates;
+}
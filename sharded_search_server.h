@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "search_server.h"
+
+/*
+ *
+ * Поисковая система, документы которой разложены по нескольким SearchServer (шардам)
+ * по остатку хеша id. Поиск идет во всех шардах параллельно, топы шардов сливаются в общий.
+ * Шарды считают веса слов по статистике всего корпуса (числа документов и частоты слов
+ * всех шардов), поэтому релевантность та же, что в одном индексе со всеми документами.
+ * Частоты слов корпуса хранятся здесь же и обновляются при добавлении, изменении и удалении документов,
+ * так что вес слова не требует обхода шардов. Эти же слова - словарь корпуса: "prefix*" и слова
+ * с опечатками раскрываются по нему один раз до поиска в шардах (см. QueryExpansion).
+ * Добавление, удаление и MatchDocument обращаются только к шарду документа;
+ * MatchDocument раскрывает слова по словарю шарда, в котором есть все слова документа.
+ *
+ */
+
+class ShardedSearchServer : public CorpusStatistics, private ExpansionDictionary {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+
+    // шарды ссылаются на статистику корпуса, то есть на этот объект
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const;
+
+    template <typename Ranking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, const Ranking& ranking) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    void RemoveDocument(int document_id);
+
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void SetDocumentStatus(int document_id, DocumentStatus status);
+
+    // нечеткий поиск, как SearchServer::SetFuzzyMatching
+    void SetFuzzyMatching(int max_distance);
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+    // шард, которому принадлежит документ
+    size_t GetShardIndex(int document_id) const;
+
+    const SearchServer& GetShard(size_t index) const;
+
+    RankingStatistics GetRankingStatistics() const override;
+
+    size_t GetDocumentFreq(std::string_view word) const override;
+
+private:
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+    // слово корпуса -> в скольких документах оно есть; слова без документов остаются, как в словаре SearchServer
+    std::map<std::string, size_t, std::less<>> document_freqs_;
+    int fuzzy_max_distance_ = 0;
+
+    void AddDocumentFreqs(const SearchServer::WordFrequencies& word_frequencies);
+
+    void RemoveDocumentFreqs(const SearchServer::WordFrequencies& word_frequencies);
+
+    // словарь корпуса для ExpandQuery; стоп-слова у всех шардов общие
+    bool IsStopWord(std::string_view word) const override;
+
+    bool HasWord(std::string_view word) const override;
+
+    std::vector<ExpansionCandidate> FindByPrefix(std::string_view prefix) const override;
+
+    std::vector<ExpansionCandidate> FindWithinDistance(const LevenshteinAutomaton& automaton) const override;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Sharded search server needs at least one shard");
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<SearchServer>(stop_words));
+        shards_.back()->SetCorpusStatistics(this);
+    }
+}
+
+template <typename Ranking>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+    const Ranking& ranking) const {
+    const QueryExpansion expansion = ExpandQuery(raw_query, fuzzy_max_distance_, *this);
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_documents.begin(),
+        [raw_query, &expansion, &filter, &ranking](const std::unique_ptr<SearchServer>& shard) {
+            return shard->FindTopDocuments(std::execution::seq, raw_query, expansion, filter, ranking);
+        });
+
+    // в общий топ попадают только документы из топов шардов
+    std::vector<Document> documents;
+    for (const std::vector<Document>& local_documents : shard_documents) {
+        documents.insert(documents.end(), local_documents.begin(), local_documents.end());
+    }
+    std::sort(documents.begin(), documents.end(), IsRankedHigher);
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return documents;
+}
@@ -0,0 +1,231 @@
+﻿#include <algorithm>
+
+#include "term_dictionary.h"
+
+using namespace std;
+
+namespace {
+
+void WriteVarint(string& data, uint32_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<char>(value));
+}
+
+uint32_t ReadVarint(const string& data, size_t& offset) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = static_cast<uint8_t>(data[offset++]);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+/*
+ *
+ * Последовательный разбор слов блоков, начиная с блока block
+ *
+ */
+
+class BlockReader {
+public:
+    BlockReader(const string& data, size_t offset, size_t term_index)
+        : data_(&data)
+        , offset_(offset)
+        , term_index_(term_index) {
+    }
+
+    // следующее слово; block_size - размер блока, по нему определяется начало нового блока
+    const string& Next(size_t block_size) {
+        const size_t shared = term_index_ % block_size == 0 ? 0 : ReadVarint(*data_, offset_);
+        const size_t suffix_size = ReadVarint(*data_, offset_);
+        word_.resize(shared);
+        word_.append(*data_, offset_, suffix_size);
+        offset_ += suffix_size;
+        ++term_index_;
+        return word_;
+    }
+
+    size_t GetTermIndex() const {
+        return term_index_;
+    }
+
+private:
+    const string* data_;
+    size_t offset_;
+    size_t term_index_;
+    string word_;
+};
+
+} // namespace
+
+TermDictionary::TermDictionary(const vector<pair<string_view, int>>& terms) {
+    term_ids_.reserve(terms.size());
+    block_offsets_.reserve(terms.size() / BLOCK_SIZE + 1);
+    string_view previous;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        const string_view word = terms[i].first;
+        if (i % BLOCK_SIZE == 0) {
+            // первое слово блока хранится целиком, чтобы блок можно было разбирать независимо
+            block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+            WriteVarint(data_, static_cast<uint32_t>(word.size()));
+            data_.append(word);
+        }
+        else {
+            const size_t shared = static_cast<size_t>(mismatch(previous.begin(), previous.end(), word.begin(), word.end()).second - word.begin());
+            WriteVarint(data_, static_cast<uint32_t>(shared));
+            WriteVarint(data_, static_cast<uint32_t>(word.size() - shared));
+            data_.append(word.substr(shared));
+        }
+        term_ids_.push_back(terms[i].second);
+        previous = word;
+    }
+    data_.shrink_to_fit();
+}
+
+optional<int> TermDictionary::Find(string_view word) const {
+    if (term_ids_.empty()) {
+        return nullopt;
+    }
+    const size_t block = FindBlock(word);
+    const size_t first = block * BLOCK_SIZE;
+    const size_t last = min(first + BLOCK_SIZE, term_ids_.size());
+    BlockReader reader(data_, block_offsets_[block], first);
+    for (size_t i = first; i < last; ++i) {
+        const string& term = reader.Next(BLOCK_SIZE);
+        if (term == word) {
+            return term_ids_[i];
+        }
+        if (string_view(term) > word) {
+            break;
+        }
+    }
+    return nullopt;
+}
+
+vector<int> TermDictionary::FindByPrefix(string_view prefix) const {
+    vector<int> term_ids;
+    if (term_ids_.empty()) {
+        return term_ids;
+    }
+    const size_t block = FindBlock(prefix);
+    BlockReader reader(data_, block_offsets_[block], block * BLOCK_SIZE);
+    while (reader.GetTermIndex() < term_ids_.size()) {
+        const size_t term_index = reader.GetTermIndex();
+        const string_view term = reader.Next(BLOCK_SIZE);
+        if (term.substr(0, prefix.size()) == prefix) {
+            term_ids.push_back(term_ids_[term_index]);
+        }
+        else if (term > prefix) {
+            break;
+        }
+    }
+    return term_ids;
+}
+
+vector<pair<int, int>> TermDictionary::FindWithinDistance(const LevenshteinAutomaton& automaton) const {
+    vector<pair<int, int>> matches;
+    if (term_ids_.empty()) {
+        return matches;
+    }
+    // states[k] - состояние автомата после первых k символов слова previous, state_ends[k] - их длина в байтах,
+    // посчитаны первые state_count. Состояния не удаляются, чтобы переиспользовать их память
+    vector<LevenshteinAutomaton::State> states = { automaton.Start() };
+    vector<size_t> state_ends = { 0 };
+    size_t state_count = 1;
+    string previous;
+    BlockReader reader(data_, block_offsets_[0], 0);
+    while (reader.GetTermIndex() < term_ids_.size()) {
+        const size_t term_index = reader.GetTermIndex();
+        const string& term = reader.Next(BLOCK_SIZE);
+
+        // состояния символов, целиком лежащих в общем с предыдущим словом префиксе, уже посчитаны.
+        // Некорректные байты в конце префикса в этом слове могут начинать корректный символ - их пересчитываем
+        const size_t common_size = static_cast<size_t>(mismatch(previous.begin(), previous.end(), term.begin(), term.end()).first - previous.begin());
+        const auto ends_with_invalid_byte = [&](size_t count) {
+            return state_ends[count - 1] - state_ends[count - 2] == 1 && static_cast<unsigned char>(previous[state_ends[count - 2]]) >= 0x80;
+        };
+        while (state_count > 1 && (state_ends[state_count - 1] > common_size || ends_with_invalid_byte(state_count))) {
+            --state_count;
+        }
+        size_t depth = state_ends[state_count - 1];
+        previous = term;
+
+        bool can_match = true;
+        while (depth < term.size() && can_match) {
+            if (state_count == states.size()) {
+                states.emplace_back();
+                state_ends.emplace_back();
+            }
+            depth = automaton.Step(states[state_count - 1], term, depth, states[state_count]);
+            state_ends[state_count] = depth;
+            can_match = automaton.CanMatch(states[state_count++]);
+        }
+        if (can_match) {
+            if (automaton.IsMatch(states[state_count - 1])) {
+                matches.push_back({ term_ids_[term_index], automaton.GetDistance(states[state_count - 1]) });
+            }
+            continue;
+        }
+
+        // ни одно слово с префиксом term[0, depth) не подойдет: переходим к первому слову за ними
+        --state_count;
+        const optional<string> successor = GetPrefixSuccessor(string_view(term).substr(0, depth));
+        if (!successor) {
+            continue;
+        }
+        // слова до successor, оставшиеся в текущем блоке, отсекаются первым же шагом автомата
+        const size_t block = FindBlock(*successor, (reader.GetTermIndex() - 1) / BLOCK_SIZE);
+        if (block * BLOCK_SIZE > reader.GetTermIndex()) {
+            reader = BlockReader(data_, block_offsets_[block], block * BLOCK_SIZE);
+        }
+    }
+    return matches;
+}
+
+size_t TermDictionary::size() const {
+    return term_ids_.size();
+}
+
+size_t TermDictionary::GetByteSize() const {
+    return data_.capacity() + block_offsets_.capacity() * sizeof(uint32_t) + term_ids_.capacity() * sizeof(int);
+}
+
+MemoryUsage TermDictionary::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.AddString(data_);
+    usage.AddVector(block_offsets_);
+    usage.AddVector(term_ids_);
+    return usage;
+}
+
+size_t TermDictionary::FindBlock(string_view word, size_t first) const {
+    // последний блок, первое слово которого не больше word
+    size_t left = first;
+    size_t step = 1;
+    while (left + step < block_offsets_.size() && GetFirstWord(left + step) <= word) {
+        left += step;
+        step *= 2;
+    }
+    size_t right = min(left + step, block_offsets_.size());
+    while (right - left > 1) {
+        const size_t middle = left + (right - left) / 2;
+        if (GetFirstWord(middle) <= word) {
+            left = middle;
+        }
+        else {
+            right = middle;
+        }
+    }
+    return left;
+}
+
+string_view TermDictionary::GetFirstWord(size_t block) const {
+    size_t offset = block_offsets_[block];
+    const size_t word_size = ReadVarint(data_, offset);
+    return string_view(data_).substr(offset, word_size);
+}
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "levenshtein_automaton.h"
+#include "memory_usage.h"
+
+/*
+ *
+ * Неизменяемый словарь слов индекса, отсортированный по слову.
+ * Слова хранятся блоками по BLOCK_SIZE с фронтальным сжатием: первое слово блока целиком,
+ * у следующих - только длина общего с предыдущим словом префикса и остаток.
+ * Поиск слова - бинарный поиск по первым словам блоков и разбор одного блока,
+ * слова с общим префиксом лежат подряд, поэтому их перечисление - один проход по диапазону блоков.
+ *
+ */
+
+class TermDictionary {
+public:
+    TermDictionary() = default;
+
+    // terms - пары (слово, id слова), отсортированные по слову без повторов
+    explicit TermDictionary(const std::vector<std::pair<std::string_view, int>>& terms);
+
+    std::optional<int> Find(std::string_view word) const;
+
+    // id всех слов, начинающихся с prefix, в порядке слов
+    std::vector<int> FindByPrefix(std::string_view prefix) const;
+
+    /*
+     *
+     * Пары (id слова, расстояние) для всех слов, принимаемых автоматом, в порядке слов.
+     * Ветки словаря, префикс которых автомат уже не примет, пропускаются переходом к следующему блоку.
+     *
+     */
+
+    std::vector<std::pair<int, int>> FindWithinDistance(const LevenshteinAutomaton& automaton) const;
+
+    size_t size() const;
+
+    // сколько байт занимает словарь
+    size_t GetByteSize() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    static const size_t BLOCK_SIZE = 16;
+
+    // начало i-го блока в data_
+    std::vector<uint32_t> block_offsets_;
+    std::string data_;
+    // id слов в порядке слов
+    std::vector<int> term_ids_;
+
+    // первый блок, в котором могут быть слова не меньше word; поиск галопом, начиная с блока first
+    size_t FindBlock(std::string_view word, size_t first = 0) const;
+
+    std::string_view GetFirstWord(size_t block) const;
+};